@@ -0,0 +1,175 @@
+/*
+ * analysis.c
+ *
+ * The shared analysis of a password: everything the cheap rules look at, computed in one pass over
+ * the password and then read by every stage of the check, so that enabling another rule doesn't mean
+ * another scan, another lowercased copy or another normalization of the plaintext.
+ *
+ *   - its length in bytes, and whether it is all ASCII
+ *   - how many characters of each class it has
+ *   - a case-folded copy (reject_username, reject_rolenames, the common-password and dictionary rules)
+ *   - the runs of digits (date_patterns)
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#include <ctype.h>
+
+#include "passwordguard.h"
+#include "port/pg_bitutils.h"
+
+/*
+ * Adds the digit runs that start or end among the nbits positions from base on, given the bits of
+ * the positions holding digits. *run_start is the start of the run still open at base, or -1.
+ */
+static inline int
+add_digit_runs(uint64 bits, int base, int nbits, PggRun *runs, int nruns, int *run_start)
+{
+    uint64      in_run = (*run_start >= 0);
+    uint64      changes = bits ^ ((bits << 1) | in_run);
+
+    if (nbits < 64)
+        changes &= ((uint64) 1 << nbits) - 1;
+
+    while (changes != 0)
+    {
+        int         pos = pg_rightmost_one_pos64(changes);
+
+        if (bits & ((uint64) 1 << pos))
+            *run_start = base + pos;
+        else
+        {
+            runs[nruns].start = *run_start;
+            runs[nruns].len = base + pos - *run_start;
+            nruns++;
+            *run_start = -1;
+        }
+        changes &= changes - 1;
+    }
+
+    return nruns;
+}
+
+/*
+ * pgg_analyze
+ *
+ * Fills in analysis for password (len bytes). The folded copy and digit runs of a password up to
+ * PGG_ANALYSIS_INLINE bytes long fit in the struct itself; for a longer one they are allocated in one
+ * chunk. Either way, pgg_analysis_free() wipes them.
+ */
+void
+pgg_analyze(const char *password, int len, PggAnalysis *analysis)
+{
+    int         max_digit_runs = (len + 1) / 2;
+    char       *folded;
+    PggRun     *digit_runs;
+    int         nupper = 0;
+    int         nlower = 0;
+    int         ndigit = 0;
+    int         nnonascii = 0;
+    uint64      digit_bits = 0;
+    int         ndigit_runs = 0;
+    int         digit_run_start = -1;
+    int         i;
+
+    if (len <= PGG_ANALYSIS_INLINE)
+    {
+        analysis->allocated = NULL;
+        folded = analysis->inline_text;
+        digit_runs = analysis->inline_runs;
+    }
+    else
+    {
+        Size        text_size = MAXALIGN(len + 1);
+
+        analysis->allocated = palloc(text_size + max_digit_runs * sizeof(PggRun));
+        folded = analysis->allocated;
+        digit_runs = (PggRun *) ((char *) analysis->allocated + text_size);
+    }
+
+    /*
+     * Everything is kept in locals until the end: the stores into the folded copy are char stores,
+     * which the compiler would otherwise have to assume change the struct.
+     */
+    for (i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char) password[i];
+        int         digit = (unsigned char) (c - '0') < 10;
+        unsigned char f;
+
+        /* ASCII is classified and folded (as pgg_fold_char() does) without a locale lookup. */
+        if (c < 0x80)
+        {
+            int         upper = (unsigned char) (c - 'A') < 26;
+
+            nupper += upper;
+            nlower += (unsigned char) (c - 'a') < 26;
+            ndigit += digit;
+            f = c + upper * ('a' - 'A');
+        }
+        else
+        {
+            nupper += isupper(c) != 0;
+            nlower += islower(c) != 0;
+            ndigit += isdigit(c) != 0;
+            f = (unsigned char) tolower(c);
+            nnonascii++;
+        }
+
+        folded[i] = (char) f;
+
+        /*
+         * Digits come and go with no pattern a branch predictor could learn, so they are only
+         * collected as bits here and turned into runs 64 positions at a time.
+         */
+        digit_bits |= (uint64) digit << (i & 63);
+        if ((i & 63) == 63)
+        {
+            ndigit_runs = add_digit_runs(digit_bits, i - 63, 64, digit_runs, ndigit_runs,
+                                         &digit_run_start);
+            digit_bits = 0;
+        }
+    }
+
+    /* Close the runs still open at the end. */
+    if ((len & 63) != 0)
+        ndigit_runs = add_digit_runs(digit_bits, len & ~63, len & 63, digit_runs, ndigit_runs,
+                                     &digit_run_start);
+    if (digit_run_start >= 0)
+    {
+        digit_runs[ndigit_runs].start = digit_run_start;
+        digit_runs[ndigit_runs].len = len - digit_run_start;
+        ndigit_runs++;
+    }
+
+    folded[len] = '\0';
+
+    analysis->nbytes = len;
+    analysis->ascii = (nnonascii == 0);
+    analysis->nupper = nupper;
+    analysis->nlower = nlower;
+    analysis->ndigit = ndigit;
+    analysis->nspecial = len - nupper - nlower - ndigit;
+    analysis->folded = folded;
+    analysis->digit_runs = digit_runs;
+    analysis->ndigit_runs = ndigit_runs;
+}
+
+/* Wipes the copies of the password and releases what pgg_analyze() allocated, if anything. */
+void
+pgg_analysis_free(PggAnalysis *analysis)
+{
+    if (analysis->folded == NULL)
+        return;
+    explicit_bzero(analysis->folded, analysis->nbytes + 1);
+    if (analysis->allocated != NULL)
+        pfree(analysis->allocated);
+    analysis->folded = NULL;
+    analysis->allocated = NULL;
+}
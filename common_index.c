@@ -0,0 +1,278 @@
+/*
+ * common_index.c
+ *
+ * Finds the longest common password contained in a password, for pg_passwordguard.max_common_fraction.
+ *
+ * The built-in list (common_passwords.c) only catches a password that is a common password; this
+ * rule catches one that is mostly made of one, such as "xXpassword123Xx" or "2024Qwerty!!". The
+ * common passwords (a list of up to millions, lowercased) are kept as an FM-index, built offline by
+ * tools/build_common_index.pl and memory-mapped:
+ *
+ *   - the list is the cyclic text "p1$p2$...pn$", with every $ a separator smaller than any byte,
+ *     stored as the NUL byte;
+ *   - its Burrows-Wheeler transform (BWT) is stored as a wavelet matrix, one bit vector per bit of
+ *     the byte, most significant first, each with a rank directory.
+ *
+ * Counting the occurrences of a byte before a position of the BWT then takes 8 rank operations, one
+ * per level, whatever the size of the list. Backward search extends a match one byte to the left
+ * with one such count at each end of its range of rows, so the text "$" + s + "$", i.e. the
+ * common password s, is found or ruled out in O(|s| log σ) without looking at the list itself. The
+ * check tries every end position of the folded password, extending leftwards while some common
+ * password still contains the match, and keeps the longest match that is a whole common password.
+ *
+ * The rank directories, zero counts and C array are checked against the bit vectors when the file is
+ * loaded: with them consistent, every position the search computes stays within the BWT.
+ *
+ * File layout (native byte order, see PggCommonIndexHeader):
+ *   header                     magic "PGGFMIX1", byte order mark, sizes, C array, zeros per level
+ *   bits[8][nwords]            uint64 words of the bit vector of each level, bit i of word w
+ *                              holding position 64 * w + i
+ *   ranks[8][nwords / 4]       uint32 number of ones before each block of 4 words
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#ifndef FRONTEND
+#include "utils/memutils.h"
+#endif
+
+#include "passwordguard.h"
+#include "port/pg_bitutils.h"
+
+#define COMMON_INDEX_MAGIC      "PGGFMIX1"
+#define COMMON_INDEX_LEVELS     8       /* bits per symbol */
+#define COMMON_INDEX_BLOCK      4       /* words per rank directory entry */
+
+typedef struct PggCommonIndexHeader
+{
+    char        magic[PGG_MAGIC_LEN];
+    uint32      byte_order;
+    uint32      nentries;           /* common passwords, i.e. separators */
+    uint32      nsymbols;           /* length of the BWT */
+    uint32      max_entry_len;
+    uint32      nwords;             /* words per level, a multiple of COMMON_INDEX_BLOCK */
+    uint32      reserved;
+    uint32      counts[256];        /* symbols of the BWT smaller than each byte */
+    uint32      zeros[COMMON_INDEX_LEVELS];     /* zero bits in each level */
+} PggCommonIndexHeader;
+
+static PggMappedFile index_file = {NULL, 0};
+static char *index_loaded_path = NULL;
+static const PggCommonIndexHeader *index_header = NULL;
+static const uint64 *index_bits = NULL;
+static const uint32 *index_ranks = NULL;
+
+/* Where the symbols equal to each byte start in the order of the last level. */
+static uint32 index_start[256];
+
+/* Number of one bits before pos in the bit vector of level. */
+static inline uint32
+index_rank1(int level, uint32 pos)
+{
+    const uint64 *bits = index_bits + (Size) level * index_header->nwords;
+    uint32      word = pos >> 6;
+    uint32      rank;
+    uint32      w;
+
+    rank = index_ranks[(Size) level * (index_header->nwords / COMMON_INDEX_BLOCK) +
+                       word / COMMON_INDEX_BLOCK];
+    for (w = word & ~(COMMON_INDEX_BLOCK - 1); w < word; w++)
+        rank += pg_popcount64(bits[w]);
+    if (pos & 63)
+        rank += pg_popcount64(bits[word] & ((UINT64_C(1) << (pos & 63)) - 1));
+
+    return rank;
+}
+
+/* Follows position pos of level 0 down the levels along the bits of c. */
+static inline uint32
+index_descend(unsigned char c, uint32 pos)
+{
+    int         level;
+
+    for (level = 0; level < COMMON_INDEX_LEVELS; level++)
+    {
+        if (c & (0x80 >> level))
+            pos = index_header->zeros[level] + index_rank1(level, pos);
+        else
+            pos -= index_rank1(level, pos);
+    }
+    return pos;
+}
+
+/*
+ * One step of backward search: narrows the rows [*sp, *ep) to those of the texts they start
+ * preceded by c. Returns false if there are none.
+ */
+static inline bool
+index_extend(unsigned char c, uint32 *sp, uint32 *ep)
+{
+    uint32      s = *sp;
+    uint32      e = *ep;
+    int         level;
+
+    for (level = 0; level < COMMON_INDEX_LEVELS; level++)
+    {
+        if (c & (0x80 >> level))
+        {
+            s = index_header->zeros[level] + index_rank1(level, s);
+            e = index_header->zeros[level] + index_rank1(level, e);
+        }
+        else
+        {
+            s -= index_rank1(level, s);
+            e -= index_rank1(level, e);
+        }
+        if (s == e)
+            return false;
+    }
+
+    *sp = index_header->counts[c] + (s - index_start[c]);
+    *ep = index_header->counts[c] + (e - index_start[c]);
+    return true;
+}
+
+/*
+ * Checks the rank directory and zero count of every level against its bit vector, and the C array
+ * against the number of each byte in the BWT; fills in index_start. With these right, backward
+ * search from rows within [0, nsymbols] stays within it, so a corrupt index can't send it past the
+ * bit vectors.
+ */
+static bool
+index_valid(void)
+{
+    Size        nwords = index_header->nwords;
+    int         level;
+    int         c;
+
+    for (level = 0; level < COMMON_INDEX_LEVELS; level++)
+    {
+        const uint64 *bits = index_bits + (Size) level * nwords;
+        const uint32 *ranks = index_ranks + (Size) level * (nwords / COMMON_INDEX_BLOCK);
+        uint64      ones = 0;
+        Size        w;
+
+        for (w = 0; w < nwords; w++)
+        {
+            if (w % COMMON_INDEX_BLOCK == 0 && ranks[w / COMMON_INDEX_BLOCK] != ones)
+                return false;
+            ones += pg_popcount64(bits[w]);
+        }
+        if (index_header->zeros[level] !=
+            index_header->nsymbols - index_rank1(level, index_header->nsymbols))
+            return false;
+    }
+
+    for (c = 0; c < 256; c++)
+    {
+        uint32      next = (c < 255) ? index_header->counts[c + 1] : index_header->nsymbols;
+
+        index_start[c] = index_descend((unsigned char) c, 0);
+        if (index_descend((unsigned char) c, index_header->nsymbols) - index_start[c] !=
+            next - index_header->counts[c])
+            return false;
+    }
+
+    return true;
+}
+
+static void
+index_load(const char *path)
+{
+    const PggCommonIndexHeader *hdr;
+    Size        nwords;
+    bool        valid;
+    int         c;
+
+    pgg_unmap_file(&index_file);
+    index_header = NULL;
+    if (index_loaded_path)
+    {
+        pfree(index_loaded_path);
+        index_loaded_path = NULL;
+    }
+
+    pgg_map_file(path, "common-password index", &index_file);
+    pgg_check_file_header(&index_file, path, "common-password index", COMMON_INDEX_MAGIC,
+                          sizeof(PggCommonIndexHeader));
+
+    hdr = (const PggCommonIndexHeader *) index_file.data;
+    nwords = hdr->nwords;
+    valid = hdr->nentries > 0 && hdr->max_entry_len > 0 &&
+        nwords > 0 && nwords % COMMON_INDEX_BLOCK == 0 &&
+        nwords * 64 > hdr->nsymbols &&
+        index_file.size == sizeof(PggCommonIndexHeader) +
+        COMMON_INDEX_LEVELS * (nwords * sizeof(uint64) +
+                               nwords / COMMON_INDEX_BLOCK * sizeof(uint32)) &&
+        hdr->counts[0] == 0 && hdr->counts[1] == hdr->nentries;
+    for (c = 1; valid && c < 256; c++)
+        valid = hdr->counts[c] >= hdr->counts[c - 1] && hdr->counts[c] <= hdr->nsymbols;
+    for (c = 0; valid && c < COMMON_INDEX_LEVELS; c++)
+        valid = hdr->zeros[c] <= hdr->nsymbols;
+    if (valid)
+    {
+        index_header = hdr;
+        index_bits = (const uint64 *) (index_file.data + sizeof(PggCommonIndexHeader));
+        index_ranks = (const uint32 *) (index_bits + COMMON_INDEX_LEVELS * nwords);
+        valid = index_valid();
+    }
+    if (!valid)
+    {
+        index_header = NULL;
+        pgg_unmap_file(&index_file);
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: invalid common-password index file \"%s\"", path)));
+    }
+
+    index_loaded_path = MemoryContextStrdup(TopMemoryContext, path);
+}
+
+/*
+ * pgg_longest_common_password
+ *
+ * Returns the length of the longest common password in the index at index_path that the password,
+ * given as its folded view, contains; 0 if it contains none.
+ */
+int
+pgg_longest_common_password(const char *index_path, const char *folded, int len)
+{
+    const unsigned char *p = (const unsigned char *) folded;
+    int         longest = 0;
+    int         end;
+
+    if (index_loaded_path == NULL || strcmp(index_loaded_path, index_path) != 0)
+        index_load(index_path);
+
+    /* A match ending at or before end can't be longer than end. */
+    for (end = len; end > longest; end--)
+    {
+        /* The rows starting with a separator: a match must follow a whole common password. */
+        uint32      sp = 0;
+        uint32      ep = index_header->nentries;
+        int         start = end;
+
+        while (start > 0 && end - start < (int) index_header->max_entry_len)
+        {
+            uint32      entry_sp;
+            uint32      entry_ep;
+
+            if (!index_extend(p[--start], &sp, &ep))
+                break;
+
+            /* Is the match, preceded by a separator, a whole common password? */
+            entry_sp = sp;
+            entry_ep = ep;
+            if (end - start > longest && index_extend(0, &entry_sp, &entry_ep))
+                longest = end - start;
+        }
+    }
+
+    return longest;
+}
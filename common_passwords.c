@@ -0,0 +1,54 @@
+/*
+ * common_passwords.c
+ *
+ * Built-in common-password list for pg_passwordguard.reject_common.
+ *
+ * The list itself lives in common_passwords.txt and is turned into a static perfect-hash table
+ * (common_passwords_table.h) by gen_common_passwords.pl at build time. Everything is read-only
+ * data inside the shared library, so there is nothing to configure, parse or put in shared memory:
+ * a lookup is three hashes of the lowercased password (from the check's analysis) and a single slot
+ * compare.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#include <string.h>
+
+#include "passwordguard.h"
+#include "common_passwords_table.h"
+
+/*
+ * pgg_is_common_password
+ *
+ * Returns true if the password, given lowercased (PggAnalysis.folded), is on the built-in list.
+ */
+bool
+pgg_is_common_password(const char *folded, size_t len)
+{
+    uint32      bucket;
+    uint32      disp;
+    uint32      f1;
+    uint32      f2;
+    uint32      slot;
+
+    /* Nothing on the list is longer than PGG_COMMON_MAXLEN. */
+    if (len == 0 || len > PGG_COMMON_MAXLEN)
+        return false;
+
+    bucket = pgg_hash32(folded, len, PGG_COMMON_SEED) % PGG_COMMON_NBUCKETS;
+    disp = pgg_common_disp[bucket];
+    f1 = pgg_hash32(folded, len, PGG_COMMON_SEED + 1) % PGG_COMMON_NSLOTS;
+    f2 = pgg_hash32(folded, len, PGG_COMMON_SEED + 2) % (PGG_COMMON_NSLOTS - 1) + 1;
+
+    slot = (uint32) ((f1 + (uint64) (disp / PGG_COMMON_NSLOTS) * f2 + disp % PGG_COMMON_NSLOTS)
+                     % PGG_COMMON_NSLOTS);
+
+    return pgg_common_length[slot] == len &&
+        memcmp(pgg_common_pool + pgg_common_offset[slot], folded, len) == 0;
+}
@@ -0,0 +1,584 @@
+/*
+ * cracklib.c
+ *
+ * Native reader of cracklib dictionaries, for pg_passwordguard.reject_cracklib: is the password based
+ * on a word of an existing cracklib word list, in the sense of cracklib's FascistCheck()?
+ * contrib/passwordcheck built with cracklib opens the dictionary files and reads them through stdio
+ * on every call; here they are memory-mapped once per backend and shared through the page cache, and
+ * a check is a few dozen binary searches that never leave the mapping.
+ *
+ * cracklib's packed format (packlib.c), in the byte order of the machine that packed it:
+ *   pw_dict.pwi    header {magic 0x70775631, number of words, block length 16, padding}, then the
+ *                  offset in pw_dict.pwd of each block of 16 words; the header fields and offsets are
+ *                  32 bits wide, or 64 bits in the files of some older 64-bit builds of cracklib
+ *   pw_dict.pwd    the words in byte order, front-coded in blocks of 16: the first word of a block in
+ *                  full, each following one as a byte giving the length of the prefix it shares with
+ *                  the word before it, then the rest of it; every word NUL-terminated
+ *   pw_dict.hwm    for each first byte, the number of the last word that starts with it
+ *
+ * At load, the offsets are validated and decoded into an array in memory, and the table of
+ * pw_dict.hwm is rebuilt from the first words of the blocks, so that file is not read. A lookup
+ * binary-searches the first words of the blocks that can hold the word, straight from the mapping,
+ * and decodes the one block that may hold it into a stack buffer.
+ *
+ * The words looked up are those of cracklib's FascistLook(): the lowercased password put through
+ * cracklib's "destructor" rules (trimming up to three characters off either end, purging
+ * punctuation or symbols, undoing l33t substitutions), then the reversed password through its
+ * "constructor" rules (reversing, duplicating, reflecting). The rules are written in cracklib's
+ * rule language and applied in place to a buffer on the stack, without allocating. cracklib lists a
+ * selection of chains of l33t substitutions; every combination of them whose characters occur in
+ * the password is tried instead, so more variants are caught.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#ifndef FRONTEND
+#include "utils/memutils.h"
+#endif
+
+#include "passwordguard.h"
+
+#define CRACKLIB_MAGIC          0x70775631      /* "pwV1" */
+#define CRACKLIB_BLOCK_WORDS    16              /* cracklib's NUMWORDS */
+
+/* Longest password checked; the constructor rules double it in the candidate buffer. */
+#define CRACKLIB_MAX_PASSWORD   128
+#define CRACKLIB_CANDIDATE_SIZE (2 * CRACKLIB_MAX_PASSWORD + 1)
+
+/* Longest word decoded; cracklib itself stores at most 31 bytes (MAXWORDLEN). */
+#define CRACKLIB_MAX_WORD       255
+
+static PggMappedFile cracklib_index_file = {NULL, 0};
+static PggMappedFile cracklib_words_file = {NULL, 0};
+static char *cracklib_loaded_path = NULL;
+static uint32 cracklib_nwords = 0;
+
+/* Offset in pw_dict.pwd of each block, followed by the size of the file. */
+static uint32 *cracklib_blocks = NULL;
+
+/* Number of blocks whose first word starts with a byte smaller than each byte (pw_dict.hwm). */
+static uint32 cracklib_below[257];
+
+/* FascistLook()'s rules for the lowercased password, except its chains of l33t substitutions. */
+static const char *const cracklib_destructors[] = {
+    ":",
+    "[", "]", "[[", "]]", "[[[", "]]]",
+    "/?p@?p", "/?s@?s", "/?X@?X"
+};
+
+/* cracklib's l33t substitutions: a character and what it may stand for. */
+static const struct
+{
+    char        from;
+    const char *to;
+}           cracklib_substitutions[] = {
+    {'$', "s"}, {'0', "o"}, {'1', "il"}, {'2', "a"}, {'3', "e"}, {'4', "ah"}, {'5', "s"}
+};
+
+#define CRACKLIB_NUM_SUBSTITUTIONS  lengthof(cracklib_substitutions)
+
+/* FascistLook()'s rules for the reversed password. */
+static const char *const cracklib_constructors[] = {
+    ":", "r", "d", "f", "dr", "fr", "rf"
+};
+
+static void
+cracklib_invalid(const char *path)
+{
+    ereport(ERROR,
+            (errcode(ERRCODE_DATA_CORRUPTED),
+             errmsg("pg_passwordguard: invalid cracklib dictionary \"%s\"", path)));
+}
+
+/* Reads entry i of the index, whose header and entries are 32 or 64 bits wide. */
+static uint64
+cracklib_index_entry(Size offset, Size width, Size i)
+{
+    const char *p = cracklib_index_file.data + offset + i * width;
+
+    if (width == sizeof(uint32))
+    {
+        uint32      v;
+
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    else
+    {
+        uint64      v;
+
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+}
+
+static void
+cracklib_load(const char *path)
+{
+    const char *words;
+    char       *index_path;
+    char       *words_path;
+    Size        width;
+    Size        header_size;
+    uint64      nwords;
+    uint16      block_words;
+    uint32      nblocks;
+    uint32      block;
+    uint32      first_bytes[256];
+    bool        valid;
+    int         c;
+
+    pgg_unmap_file(&cracklib_index_file);
+    pgg_unmap_file(&cracklib_words_file);
+    if (cracklib_blocks)
+    {
+        pfree(cracklib_blocks);
+        cracklib_blocks = NULL;
+    }
+    if (cracklib_loaded_path)
+    {
+        pfree(cracklib_loaded_path);
+        cracklib_loaded_path = NULL;
+    }
+
+    index_path = psprintf("%s.pwi", path);
+    words_path = psprintf("%s.pwd", path);
+    pgg_map_file(index_path, "cracklib index", &cracklib_index_file);
+    pgg_map_file(words_path, "cracklib dictionary", &cracklib_words_file);
+    pfree(index_path);
+    pfree(words_path);
+
+    /*
+     * The 32-bit header is {magic, nwords, block length, pad}. The 64-bit one starts with a 64-bit
+     * magic, which read as two 32-bit fields is the magic and a word count of 0 on little-endian
+     * machines, and no magic on big-endian ones.
+     */
+    valid = false;
+    width = sizeof(uint32);
+    header_size = 3 * sizeof(uint32);
+    if (cracklib_index_file.size >= header_size &&
+        cracklib_index_entry(0, width, 0) == CRACKLIB_MAGIC &&
+        cracklib_index_entry(0, width, 1) != 0)
+        valid = true;
+    else
+    {
+        width = sizeof(uint64);
+        header_size = 3 * sizeof(uint64);
+        valid = cracklib_index_file.size >= header_size &&
+            cracklib_index_entry(0, width, 0) == CRACKLIB_MAGIC;
+    }
+    if (!valid)
+    {
+        pgg_unmap_file(&cracklib_index_file);
+        pgg_unmap_file(&cracklib_words_file);
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: \"%s.pwi\" is not a cracklib index for this byte order", path)));
+    }
+
+    nwords = cracklib_index_entry(0, width, 1);
+    memcpy(&block_words, cracklib_index_file.data + 2 * width, sizeof(block_words));
+    nblocks = (uint32) ((nwords + CRACKLIB_BLOCK_WORDS - 1) / CRACKLIB_BLOCK_WORDS);
+    if (nwords == 0 || nwords > PG_UINT32_MAX || block_words != CRACKLIB_BLOCK_WORDS ||
+        cracklib_words_file.size >= PG_UINT32_MAX ||
+        cracklib_index_file.size < header_size + (Size) nblocks * width)
+    {
+        pgg_unmap_file(&cracklib_index_file);
+        pgg_unmap_file(&cracklib_words_file);
+        cracklib_invalid(path);
+    }
+
+    /* Decode the offsets: increasing, each block starting with a whole first word. */
+    cracklib_blocks = MemoryContextAlloc(TopMemoryContext, ((Size) nblocks + 1) * sizeof(uint32));
+    words = cracklib_words_file.data;
+    for (block = 0; valid && block < nblocks; block++)
+    {
+        uint64      offset = cracklib_index_entry(header_size, width, block);
+
+        valid = offset < cracklib_words_file.size &&
+            (block == 0 || offset > cracklib_blocks[block - 1]);
+        cracklib_blocks[block] = (uint32) offset;
+    }
+    cracklib_blocks[nblocks] = (uint32) cracklib_words_file.size;
+
+    memset(first_bytes, 0, sizeof(first_bytes));
+    for (block = 0; valid && block < nblocks; block++)
+    {
+        const char *first = words + cracklib_blocks[block];
+
+        c = (unsigned char) first[0];
+        valid = memchr(first, '\0', cracklib_blocks[block + 1] - cracklib_blocks[block]) != NULL &&
+            (block == 0 || c >= (unsigned char) words[cracklib_blocks[block - 1]]);
+        first_bytes[c]++;
+    }
+
+    if (!valid)
+    {
+        pfree(cracklib_blocks);
+        cracklib_blocks = NULL;
+        pgg_unmap_file(&cracklib_index_file);
+        pgg_unmap_file(&cracklib_words_file);
+        cracklib_invalid(path);
+    }
+
+    cracklib_below[0] = 0;
+    for (c = 0; c < 256; c++)
+        cracklib_below[c + 1] = cracklib_below[c] + first_bytes[c];
+
+    cracklib_nwords = (uint32) nwords;
+    cracklib_loaded_path = MemoryContextStrdup(TopMemoryContext, path);
+}
+
+/* Is word (NUL-terminated, len bytes) in the dictionary? */
+static bool
+cracklib_find(const char *word, int len)
+{
+    const char *words = cracklib_words_file.data;
+    unsigned char c = (unsigned char) word[0];
+    uint32      lo;
+    uint32      hi;
+    const char *p;
+    const char *end;
+    char        decoded[CRACKLIB_MAX_WORD + 1];
+    int         decoded_len = 0;
+    int         nwords;
+    int         i;
+
+    if (len == 0 || len > CRACKLIB_MAX_WORD)
+        return false;
+
+    /*
+     * The word can only be in the last block whose first word is not greater: one of the blocks
+     * starting with c, or the last block before them.
+     */
+    lo = cracklib_below[c];
+    hi = cracklib_below[c + 1];
+    if (lo > 0)
+        lo--;
+    if (lo >= hi)
+        return false;
+    while (hi - lo > 1)
+    {
+        uint32      mid = lo + (hi - lo) / 2;
+
+        if (strcmp(words + cracklib_blocks[mid], word) <= 0)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    /* Decode the block until the word, or a greater one, comes up. */
+    p = words + cracklib_blocks[lo];
+    end = words + cracklib_blocks[lo + 1];
+    nwords = Min(CRACKLIB_BLOCK_WORDS, cracklib_nwords - lo * CRACKLIB_BLOCK_WORDS);
+    for (i = 0; i < nwords; i++)
+    {
+        int         cmp;
+
+        if (i > 0)
+        {
+            int         prefix;
+
+            if (p >= end || (prefix = (unsigned char) *p++) > decoded_len)
+                cracklib_invalid(cracklib_loaded_path);
+            decoded_len = prefix;
+        }
+        while (p < end && *p != '\0')
+        {
+            if (decoded_len == CRACKLIB_MAX_WORD)
+                cracklib_invalid(cracklib_loaded_path);
+            decoded[decoded_len++] = *p++;
+        }
+        if (p >= end)
+            cracklib_invalid(cracklib_loaded_path);
+        p++;
+        decoded[decoded_len] = '\0';
+
+        cmp = strcmp(decoded, word);
+        if (cmp >= 0)
+            return cmp == 0;
+    }
+    return false;
+}
+
+/* cracklib's character classes (?v, ?c, ...); the uppercase class is the complement. */
+static bool
+cracklib_in_class(char class, unsigned char c)
+{
+    bool        in;
+    bool        alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    bool        digit = c >= '0' && c <= '9';
+
+    switch (class | 0x20)
+    {
+        case 'v':
+            in = c != '\0' && strchr("aeiouAEIOU", c) != NULL;
+            break;
+        case 'c':
+            in = alpha && strchr("aeiouAEIOU", c) == NULL;
+            break;
+        case 'w':
+            in = c == ' ' || c == '\t';
+            break;
+        case 'p':
+            in = c != '\0' && strchr(".`,:;'!?\"", c) != NULL;
+            break;
+        case 's':
+            in = c != '\0' && strchr("$%^&*()-_+=|\\[]{}#@/~", c) != NULL;
+            break;
+        case 'l':
+            in = c >= 'a' && c <= 'z';
+            break;
+        case 'u':
+            in = c >= 'A' && c <= 'Z';
+            break;
+        case 'd':
+            in = digit;
+            break;
+        case 'a':
+            in = alpha;
+            break;
+        case 'x':
+            in = alpha || digit;
+            break;
+        default:
+            in = false;
+            break;
+    }
+    return (class >= 'A' && class <= 'Z') ? !in : in;
+}
+
+/* End of the rule argument at arg: a character, or ? and a class. */
+static const char *
+cracklib_arg_end(const char *arg)
+{
+    if (arg[0] == '\0')
+        return arg;
+    return (arg[0] == '?' && arg[1] != '\0') ? arg + 2 : arg + 1;
+}
+
+static bool
+cracklib_arg_matches(const char *arg, unsigned char c)
+{
+    if (arg[0] == '?' && arg[1] != '\0')
+        return cracklib_in_class(arg[1], c);
+    return c == (unsigned char) arg[0];
+}
+
+/*
+ * Applies a cracklib rule to word (len bytes in a buffer of CRACKLIB_CANDIDATE_SIZE) in place and
+ * NUL-terminates it. Returns the new length, or -1 if the rule rejects the word. Only the commands
+ * the rules above use are known:
+ *   :  nothing     [  drop the first character     ]  drop the last character
+ *   r  reverse     d  duplicate                     f  reflect (append the reverse)
+ *   /X reject unless X occurs      @X purge X      sXY replace X by Y
+ * where X is a character or ?class.
+ */
+static int
+cracklib_mangle(const char *rule, char *word, int len)
+{
+    const char *r = rule;
+
+    while (*r != '\0')
+    {
+        const char *arg;
+        bool        found;
+        int         i;
+        int         j;
+
+        switch (*r++)
+        {
+            case ':':
+                break;
+            case '[':
+                if (len == 0)
+                    return -1;
+                memmove(word, word + 1, --len);
+                break;
+            case ']':
+                if (len == 0)
+                    return -1;
+                len--;
+                break;
+            case 'r':
+                for (i = 0, j = len - 1; i < j; i++, j--)
+                {
+                    char        tmp = word[i];
+
+                    word[i] = word[j];
+                    word[j] = tmp;
+                }
+                break;
+            case 'd':
+                if (2 * len >= CRACKLIB_CANDIDATE_SIZE)
+                    return -1;
+                memcpy(word + len, word, len);
+                len *= 2;
+                break;
+            case 'f':
+                if (2 * len >= CRACKLIB_CANDIDATE_SIZE)
+                    return -1;
+                for (i = 0; i < len; i++)
+                    word[2 * len - 1 - i] = word[i];
+                len *= 2;
+                break;
+            case '/':
+                arg = r;
+                r = cracklib_arg_end(arg);
+                found = false;
+                for (i = 0; i < len && !found; i++)
+                    found = cracklib_arg_matches(arg, (unsigned char) word[i]);
+                if (!found)
+                    return -1;
+                break;
+            case '@':
+                arg = r;
+                r = cracklib_arg_end(arg);
+                for (i = 0, j = 0; i < len; i++)
+                {
+                    if (!cracklib_arg_matches(arg, (unsigned char) word[i]))
+                        word[j++] = word[i];
+                }
+                len = j;
+                break;
+            case 's':
+                arg = r;
+                r = cracklib_arg_end(arg);
+                if (*r == '\0')
+                    return -1;
+                for (i = 0; i < len; i++)
+                {
+                    if (cracklib_arg_matches(arg, (unsigned char) word[i]))
+                        word[i] = *r;
+                }
+                r++;
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    word[len] = '\0';
+    return len;
+}
+
+/* Is the password, put through rule, a dictionary word? */
+static bool
+cracklib_try(const char *rule, const char *password, int len)
+{
+    char        candidate[CRACKLIB_CANDIDATE_SIZE];
+    bool        found;
+
+    memcpy(candidate, password, len);
+    len = cracklib_mangle(rule, candidate, len);
+    found = len > 0 && cracklib_find(candidate, len);
+
+    explicit_bzero(candidate, sizeof(candidate));
+    return found;
+}
+
+/*
+ * Tries every combination of the l33t substitutions whose characters occur in the password, as the
+ * rule "/XsXY/..." cracklib would write for it.
+ */
+static bool
+cracklib_try_substitutions(const char *password, int len)
+{
+    int         present[CRACKLIB_NUM_SUBSTITUTIONS];
+    int         choice[CRACKLIB_NUM_SUBSTITUTIONS];
+    int         npresent = 0;
+    int         i;
+
+    for (i = 0; i < (int) CRACKLIB_NUM_SUBSTITUTIONS; i++)
+    {
+        if (memchr(password, cracklib_substitutions[i].from, len) != NULL)
+        {
+            present[npresent] = i;
+            choice[npresent++] = 0;
+        }
+    }
+
+    for (;;)
+    {
+        char        rule[5 * CRACKLIB_NUM_SUBSTITUTIONS + 1];
+        int         rule_len = 0;
+
+        /* Next combination: choice 0 leaves the character, k substitutes its k-th meaning. */
+        for (i = 0; i < npresent; i++)
+        {
+            if (++choice[i] <= (int) strlen(cracklib_substitutions[present[i]].to))
+                break;
+            choice[i] = 0;
+        }
+        if (i == npresent)
+            return false;
+
+        for (i = 0; i < npresent; i++)
+        {
+            char        from = cracklib_substitutions[present[i]].from;
+
+            if (choice[i] == 0)
+                continue;
+            rule[rule_len++] = '/';
+            rule[rule_len++] = from;
+            rule[rule_len++] = 's';
+            rule[rule_len++] = from;
+            rule[rule_len++] = cracklib_substitutions[present[i]].to[choice[i] - 1];
+        }
+        rule[rule_len] = '\0';
+
+        if (cracklib_try(rule, password, len))
+            return true;
+    }
+}
+
+/*
+ * pgg_cracklib_match
+ *
+ * Checks the password, given as its folded (lowercased) view, against the cracklib dictionary whose
+ * files are dictionary_path.pwd and dictionary_path.pwi, with the rules of cracklib's
+ * FascistLook(). Returns PGG_CRACKLIB_WORD if it is based on a dictionary word, PGG_CRACKLIB_REVERSED
+ * if on a reversed one, else PGG_CRACKLIB_NONE. Passwords longer than CRACKLIB_MAX_PASSWORD bytes are
+ * not checked.
+ */
+int
+pgg_cracklib_match(const char *dictionary_path, const char *folded, int len)
+{
+    char        reversed[CRACKLIB_MAX_PASSWORD];
+    int         result = PGG_CRACKLIB_NONE;
+    int         i;
+
+    if (cracklib_loaded_path == NULL || strcmp(cracklib_loaded_path, dictionary_path) != 0)
+        cracklib_load(dictionary_path);
+
+    if (len == 0 || len > CRACKLIB_MAX_PASSWORD)
+        return PGG_CRACKLIB_NONE;
+
+    for (i = 0; i < lengthof(cracklib_destructors); i++)
+    {
+        if (cracklib_try(cracklib_destructors[i], folded, len))
+            return PGG_CRACKLIB_WORD;
+    }
+    if (cracklib_try_substitutions(folded, len))
+        return PGG_CRACKLIB_WORD;
+
+    for (i = 0; i < len; i++)
+        reversed[i] = folded[len - 1 - i];
+    for (i = 0; i < lengthof(cracklib_constructors); i++)
+    {
+        if (cracklib_try(cracklib_constructors[i], reversed, len))
+        {
+            result = PGG_CRACKLIB_REVERSED;
+            break;
+        }
+    }
+
+    explicit_bzero(reversed, len);
+    return result;
+}
@@ -0,0 +1,293 @@
+/*
+ * date_patterns.c
+ *
+ * Finds dates and years embedded in a password (pg_passwordguard.date_patterns):
+ *   - years 1900-2099                      ("Secret1987!")
+ *   - packed numeric dates                 MMDDYY, DDMMYY, YYMMDD, MMDDYYYY, DDMMYYYY, YYYYMMDD
+ *   - separated dates                      DD.MM.YYYY, MM/DD/YY, YYYY-MM-DD, MM/YYYY
+ *   - a season followed by a year          ("Summer2024!", "winter_24")
+ *
+ * The scanner only looks at the digit runs the check's analysis found: a run (and up to two more runs
+ * joined by the same '.', '/' or '-') is classified from its lengths and values, and a season word is
+ * looked for by comparing a few bytes backwards from the start of the run. There is
+ * no sscanf, regex or allocation, so it is cheap enough for bulk audits.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#include "passwordguard.h"
+
+/* Character classes used by the scanner. */
+#define DC_OTHER    0
+#define DC_DIGIT    1
+#define DC_SEP      2           /* separators allowed inside a date */
+
+static const uint8 date_char_class[256] = {
+    ['0'] = DC_DIGIT,['1'] = DC_DIGIT,['2'] = DC_DIGIT,['3'] = DC_DIGIT,['4'] = DC_DIGIT,
+    ['5'] = DC_DIGIT,['6'] = DC_DIGIT,['7'] = DC_DIGIT,['8'] = DC_DIGIT,['9'] = DC_DIGIT,
+    ['.'] = DC_SEP,['/'] = DC_SEP,['-'] = DC_SEP,
+};
+
+/* A digit run inside a (possibly separated) date group. */
+typedef struct DigitRun
+{
+    int         start;
+    int         len;
+    int         value;          /* only meaningful for runs of up to 4 digits */
+} DigitRun;
+
+#define MAX_GROUP_RUNS 3
+
+static inline bool
+is_day(int v)
+{
+    return (unsigned) (v - 1) < 31;
+}
+
+static inline bool
+is_month(int v)
+{
+    return (unsigned) (v - 1) < 12;
+}
+
+static inline bool
+is_year4(int v)
+{
+    return (unsigned) (v - 1900) < 200;
+}
+
+/* Value of len digits starting at s (len <= 9). */
+static inline int
+digits_value(const char *s, int len)
+{
+    int         v = 0;
+    int         i;
+
+    for (i = 0; i < len; i++)
+        v = v * 10 + (s[i] - '0');
+    return v;
+}
+
+/* Day/month in either order: DDMM or MMDD. */
+static inline bool
+is_day_month(int a, int b)
+{
+    return (is_day(a) && is_month(b)) || (is_month(a) && is_day(b));
+}
+
+/*
+ * Length of a season word ("spring", "summer", "autumn", "fall", "winter") ending right before
+ * position end, optionally followed by a single non-alphanumeric separator; 0 if there is none.
+ */
+static int
+season_before(const char *password, int end)
+{
+    static const struct
+    {
+        const char *word;
+        int         len;
+    }           seasons[] = {
+        {"spring", 6}, {"summer", 6}, {"autumn", 6}, {"fall", 4}, {"winter", 6}
+    };
+    int         sep = 0;
+    int         i;
+
+    if (end > 0)
+    {
+        unsigned char c = (unsigned char) password[end - 1];
+
+        if (!((c | 0x20) >= 'a' && (c | 0x20) <= 'z') && !(c >= '0' && c <= '9'))
+            sep = 1;
+    }
+
+    for (i = 0; i < lengthof(seasons); i++)
+    {
+        int         wlen = seasons[i].len;
+        int         start = end - sep - wlen;
+        int         j;
+
+        if (start < 0)
+            continue;
+        for (j = 0; j < wlen; j++)
+        {
+            if ((password[start + j] | 0x20) != seasons[i].word[j])
+                break;
+        }
+        if (j == wlen)
+            return wlen + sep;
+    }
+    return 0;
+}
+
+/* Classify a single digit run that is not part of a separated date. */
+static void
+classify_run(const char *password, const DigitRun *run, PggDateScan *result)
+{
+    const char *s = password + run->start;
+    int         season;
+
+    switch (run->len)
+    {
+        case 2:
+        case 4:
+            if (run->len == 4 && !is_year4(run->value))
+                break;
+            season = season_before(password, run->start);
+            if (season > 0)
+            {
+                result->kinds |= PGG_DATE_SEASON_YEAR;
+                result->covered += season + run->len;
+            }
+            else if (run->len == 4)
+            {
+                result->kinds |= PGG_DATE_YEAR;
+                result->covered += 4;
+            }
+            return;
+
+        case 6:
+            /* MMDDYY, DDMMYY or YYMMDD */
+            if (is_day_month(digits_value(s, 2), digits_value(s + 2, 2)) ||
+                is_day_month(digits_value(s + 2, 2), digits_value(s + 4, 2)))
+            {
+                result->kinds |= PGG_DATE_NUMERIC;
+                result->covered += 6;
+                return;
+            }
+            break;
+
+        case 8:
+            /* MMDDYYYY, DDMMYYYY or YYYYMMDD */
+            if ((is_day_month(digits_value(s, 2), digits_value(s + 2, 2)) &&
+                 is_year4(digits_value(s + 4, 4))) ||
+                (is_year4(digits_value(s, 4)) && is_month(digits_value(s + 4, 2)) &&
+                 is_day(digits_value(s + 6, 2))))
+            {
+                result->kinds |= PGG_DATE_NUMERIC;
+                result->covered += 8;
+                return;
+            }
+            break;
+    }
+
+    /* Longer (or non-date) runs: a year at either end still counts, e.g. "199912" or "12024". */
+    if (run->len > 4)
+    {
+        if (is_year4(digits_value(s + run->len - 4, 4)) || is_year4(digits_value(s, 4)))
+        {
+            result->kinds |= PGG_DATE_YEAR;
+            result->covered += 4;
+        }
+    }
+}
+
+/* Classify a group of digit runs joined by one separator character. */
+static void
+classify_group(const char *password, const DigitRun *runs, int nruns, PggDateScan *result)
+{
+    int         i;
+
+    if (nruns == 3)
+    {
+        const DigitRun *a = &runs[0];
+        const DigitRun *b = &runs[1];
+        const DigitRun *c = &runs[2];
+        bool        date;
+
+        /* DD.MM.YY(YY) / MM/DD/YY(YY) or YYYY-MM-DD */
+        date = (a->len <= 2 && b->len <= 2 && (c->len == 2 || (c->len == 4 && is_year4(c->value))) &&
+                is_day_month(a->value, b->value)) ||
+            (a->len == 4 && b->len <= 2 && c->len <= 2 &&
+             is_year4(a->value) && is_month(b->value) && is_day(c->value));
+        if (date)
+        {
+            result->kinds |= PGG_DATE_SEPARATED;
+            result->covered += c->start + c->len - a->start;
+            return;
+        }
+    }
+    else if (nruns == 2)
+    {
+        const DigitRun *a = &runs[0];
+        const DigitRun *b = &runs[1];
+
+        /* MM/YYYY */
+        if (a->len <= 2 && b->len == 4 && is_month(a->value) && is_year4(b->value))
+        {
+            result->kinds |= PGG_DATE_SEPARATED;
+            result->covered += b->start + b->len - a->start;
+            return;
+        }
+    }
+
+    for (i = 0; i < nruns; i++)
+        classify_run(password, &runs[i], result);
+}
+
+/*
+ * pgg_scan_dates
+ *
+ * Goes once over the digit runs of the password and reports which kinds of date patterns it contains
+ * and how many bytes they cover.
+ */
+void
+pgg_scan_dates(const char *password, const PggAnalysis *analysis, PggDateScan *result)
+{
+    DigitRun    runs[MAX_GROUP_RUNS];
+    DigitRun    run;
+    int         nruns = 0;
+    bool        overflow = false;
+    char        group_sep = 0;
+    int         n = analysis->nbytes;
+    int         k;
+
+    result->kinds = 0;
+    result->covered = 0;
+
+    for (k = 0; k < analysis->ndigit_runs; k++)
+    {
+        int         i;
+
+        run.start = analysis->digit_runs[k].start;
+        run.len = analysis->digit_runs[k].len;
+        run.value = run.len <= 4 ? digits_value(password + run.start, run.len) : -1;
+
+        /* Groups of more than three runs (IP addresses, versions) are judged one run at a time. */
+        if (overflow)
+            classify_run(password, &run, result);
+        else if (nruns == MAX_GROUP_RUNS)
+        {
+            int         j;
+
+            for (j = 0; j < nruns; j++)
+                classify_run(password, &runs[j], result);
+            classify_run(password, &run, result);
+            overflow = true;
+        }
+        else
+            runs[nruns++] = run;
+
+        /* Does the group continue with the same separator and another digit (the next run)? */
+        i = run.start + run.len;
+        if (i + 1 < n &&
+            date_char_class[(unsigned char) password[i]] == DC_SEP &&
+            date_char_class[(unsigned char) password[i + 1]] == DC_DIGIT &&
+            (group_sep == 0 || group_sep == password[i]))
+        {
+            group_sep = password[i];
+            continue;
+        }
+
+        if (!overflow)
+            classify_group(password, runs, nruns, result);
+        nruns = 0;
+        overflow = false;
+        group_sep = 0;
+    }
+}
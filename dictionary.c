@@ -0,0 +1,235 @@
+/*
+ * dictionary.c
+ *
+ * Fuzzy dictionary lookup for pg_passwordguard.reject_dictionary: is the password, without the
+ * digits and symbols at its ends, within a few edits (Levenshtein distance) of a dictionary word?
+ * "Dragon$2024" has the core "dragon", "!Passw0rd" the core "passw0rd", one edit from "password".
+ *
+ * The dictionary is a minimal acyclic automaton (a DAWG: an FST without outputs) of the lowercased
+ * words, built offline by tools/build_dictionary.pl and memory-mapped; shared prefixes and suffixes
+ * are stored once. The core is searched for by intersecting the automaton with the Levenshtein
+ * automaton of the core: a depth-first walk of the DAWG that carries the state of the Levenshtein
+ * automaton, simulated bit-parallel after Wu and Manber (one 64-bit mask of core positions per
+ * number of edits), and abandons every branch in which no position is left within the edit limit.
+ * Only the states near the core are visited, instead of computing an edit distance against each
+ * word.
+ *
+ * The search always looks for words up to PGG_DICTIONARY_MAX_EDITS edits away and records the
+ * smallest distance found, so policies with different dictionary_edits share it.
+ *
+ * File layout (native byte order, see PggDictionaryHeader):
+ *   header                     magic "PGGDAWG1", byte order mark, counts
+ *   states[nstates]            PggDictionaryState; state 0 is the start state
+ *   arcs[narcs]                PggDictionaryArc, the arcs of each state together, sorted by label
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#ifndef FRONTEND
+#include "utils/memutils.h"
+#endif
+
+#include "passwordguard.h"
+
+#define DICTIONARY_MAGIC        "PGGDAWG1"
+
+/* Cores shorter than this are not looked up; within two edits they would match too many words. */
+#define DICTIONARY_MIN_CORE     4
+
+/* Longest core looked up: the Levenshtein automaton keeps one bit per position, plus the start. */
+#define DICTIONARY_MAX_CORE     63
+
+typedef struct PggDictionaryHeader
+{
+    char        magic[PGG_MAGIC_LEN];
+    uint32      byte_order;
+    uint32      nstates;
+    uint32      narcs;
+    uint32      nwords;
+    uint32      max_word_len;
+    uint32      reserved;
+} PggDictionaryHeader;
+
+typedef struct PggDictionaryState
+{
+    uint32      first_arc;
+    uint16      narcs;
+    uint8       final;          /* a word ends here */
+    uint8       reserved;
+} PggDictionaryState;
+
+typedef struct PggDictionaryArc
+{
+    uint32      target;
+    uint8       label;
+    uint8       reserved[3];
+} PggDictionaryArc;
+
+static PggMappedFile dictionary_file = {NULL, 0};
+static char *dictionary_loaded_path = NULL;
+static const PggDictionaryHeader *dictionary_header = NULL;
+static const PggDictionaryState *dictionary_states = NULL;
+static const PggDictionaryArc *dictionary_arcs = NULL;
+
+/* One search: the core, as match masks, and the best distance found so far. */
+typedef struct DictionarySearch
+{
+    uint64      match[256];     /* bit i + 1 set where core[i] is the byte */
+    uint64      accept;         /* bit of the end of the core */
+    uint64      positions;      /* bits 0 .. core length */
+    int         limit;          /* edits still worth looking for */
+    int         best;           /* smallest distance found, or -1 */
+} DictionarySearch;
+
+static void
+dictionary_load(const char *path)
+{
+    const PggDictionaryHeader *hdr;
+
+    pgg_unmap_file(&dictionary_file);
+    dictionary_header = NULL;
+    if (dictionary_loaded_path)
+    {
+        pfree(dictionary_loaded_path);
+        dictionary_loaded_path = NULL;
+    }
+
+    pgg_map_file(path, "dictionary", &dictionary_file);
+    pgg_check_file_header(&dictionary_file, path, "dictionary", DICTIONARY_MAGIC,
+                          sizeof(PggDictionaryHeader));
+
+    hdr = (const PggDictionaryHeader *) dictionary_file.data;
+    if (hdr->nstates == 0 ||
+        dictionary_file.size != sizeof(PggDictionaryHeader) +
+        (Size) hdr->nstates * sizeof(PggDictionaryState) +
+        (Size) hdr->narcs * sizeof(PggDictionaryArc))
+    {
+        pgg_unmap_file(&dictionary_file);
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: invalid dictionary file \"%s\"", path)));
+    }
+
+    dictionary_header = hdr;
+    dictionary_states = (const PggDictionaryState *) (dictionary_file.data + sizeof(PggDictionaryHeader));
+    dictionary_arcs = (const PggDictionaryArc *) (dictionary_states + hdr->nstates);
+    dictionary_loaded_path = MemoryContextStrdup(TopMemoryContext, path);
+}
+
+static void
+dictionary_corrupted(void)
+{
+    ereport(ERROR,
+            (errcode(ERRCODE_DATA_CORRUPTED),
+             errmsg("pg_passwordguard: invalid dictionary file \"%s\"", dictionary_loaded_path)));
+}
+
+/*
+ * Visits the DAWG state with the Levenshtein automaton in state r: r[e] has bit i set if the word
+ * read so far is within e edits of the first i bytes of the core.
+ */
+static void
+dictionary_walk(DictionarySearch *search, uint32 state, const uint64 *r)
+{
+    const PggDictionaryState *s = &dictionary_states[state];
+    uint32      arc;
+    int         e;
+
+    if (s->final)
+    {
+        for (e = 0; e < search->limit + 1; e++)
+        {
+            if (r[e] & search->accept)
+            {
+                search->best = e;
+                search->limit = e - 1;
+                break;
+            }
+        }
+    }
+
+    if ((Size) s->first_arc + s->narcs > dictionary_header->narcs)
+        dictionary_corrupted();
+
+    for (arc = s->first_arc; arc < s->first_arc + s->narcs && search->limit >= 0; arc++)
+    {
+        const PggDictionaryArc *a = &dictionary_arcs[arc];
+        uint64      match = search->match[a->label];
+        uint64      next[PGG_DICTIONARY_MAX_EDITS + 1];
+        uint64      live;
+
+        if (a->target >= dictionary_header->nstates)
+            dictionary_corrupted();
+
+        /* Match, or with one more edit: insert the byte, substitute it, or delete core bytes. */
+        next[0] = (r[0] << 1) & match;
+        live = next[0];
+        for (e = 1; e <= search->limit; e++)
+        {
+            next[e] = (((r[e] << 1) & match) | r[e - 1] | (r[e - 1] << 1) | (next[e - 1] << 1)) &
+                search->positions;
+            live |= next[e];
+        }
+
+        if (live != 0)
+            dictionary_walk(search, a->target, next);
+    }
+}
+
+/*
+ * pgg_dictionary_distance
+ *
+ * Returns the smallest number of edits, up to PGG_DICTIONARY_MAX_EDITS, that turn the password
+ * (given as its folded view) without its leading and trailing digits and symbols into a word of the
+ * dictionary at dictionary_path; -1 if there is no such word, or the core is too short to tell.
+ */
+int
+pgg_dictionary_distance(const char *dictionary_path, const char *folded, int len)
+{
+    const unsigned char *p = (const unsigned char *) folded;
+    DictionarySearch search;
+    uint64      start[PGG_DICTIONARY_MAX_EDITS + 1];
+    int         core_start = 0;
+    int         core_end = len;
+    int         core_len;
+    int         i;
+
+    if (dictionary_loaded_path == NULL || strcmp(dictionary_loaded_path, dictionary_path) != 0)
+        dictionary_load(dictionary_path);
+
+    /* Strip the affixes: everything before the first and after the last letter. */
+    while (core_start < core_end && p[core_start] < 0x80 &&
+           (unsigned char) (p[core_start] - 'a') >= 26)
+        core_start++;
+    while (core_end > core_start && p[core_end - 1] < 0x80 &&
+           (unsigned char) (p[core_end - 1] - 'a') >= 26)
+        core_end--;
+    core_len = core_end - core_start;
+
+    if (core_len < DICTIONARY_MIN_CORE || core_len > DICTIONARY_MAX_CORE ||
+        core_len > (int) dictionary_header->max_word_len + PGG_DICTIONARY_MAX_EDITS)
+        return -1;
+
+    memset(search.match, 0, sizeof(search.match));
+    for (i = 0; i < core_len; i++)
+        search.match[p[core_start + i]] |= UINT64_C(1) << (i + 1);
+    search.accept = UINT64_C(1) << core_len;
+    search.positions = (search.accept << 1) - 1;
+    search.limit = PGG_DICTIONARY_MAX_EDITS;
+    search.best = -1;
+
+    /* Before reading a byte, the first e bytes of the core can be deleted with e edits. */
+    for (i = 0; i <= PGG_DICTIONARY_MAX_EDITS; i++)
+        start[i] = ((UINT64_C(1) << (i + 1)) - 1) & search.positions;
+
+    dictionary_walk(&search, 0, start);
+
+    explicit_bzero(search.match, sizeof(search.match));
+    return search.best;
+}
@@ -0,0 +1,432 @@
+/*
+ * eventlog.c
+ *
+ * Structured policy-violation events, written as JSON lines to a dedicated file
+ * (pg_passwordguard.event_log) by a background worker.
+ *
+ * The hook must not pay for log formatting or file I/O, so it only copies a small fixed-size record
+ * (time, role, database, policy, policy version, violated and skipped rules; never the password) into
+ * a ring in shared memory and sets the worker's latch. The ring is a bounded lock-free queue: each
+ * slot carries a sequence number, producers claim a slot with one compare-and-swap on the head, and
+ * the worker is the only consumer. When the ring is full the event is dropped and counted instead of
+ * waiting; the worker writes the number of dropped events to the file with the next batch.
+ *
+ * The worker formats events in batches, appends them to the file, and starts a new file once it
+ * reaches pg_passwordguard.event_log_rotation_size (the previous one is kept with a ".1" suffix).
+ *
+ * The same worker also logs the periodic summary of rate-limited log-only warnings (warnings.c).
+ *
+ * Like the statistics, this needs shared memory and a background worker, so the library must be
+ * loaded through shared_preload_libraries; otherwise events are not collected.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/file_perm.h"
+#include "fmgr.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/json.h"
+#include "utils/timestamp.h"
+
+#include "passwordguard.h"
+
+/* Events formatted and written per batch. */
+#define EVENT_BATCH_SIZE        64
+
+typedef struct PggEvent
+{
+    TimestampTz time;
+    NameData    role;
+    Oid         database;
+    uint32      policy_version;
+    uint32      violated;       /* PGG_RULE_BIT() masks */
+    uint32      skipped;
+    int         kind;           /* PggPolicyKind */
+    bool        rejected;
+} PggEvent;
+
+typedef struct PggEventSlot
+{
+    pg_atomic_uint64 seq;       /* == position: free for that write; == position + 1: filled */
+    PggEvent    event;
+} PggEventSlot;
+
+typedef struct PggEventRing
+{
+    pg_atomic_uint64 head;      /* next position to write */
+    uint64      tail;           /* next position to read; only the worker touches it */
+    pg_atomic_uint64 dropped;   /* events lost because the ring was full */
+    Latch      *worker_latch;
+    int         size;
+    PggEventSlot slots[FLEXIBLE_ARRAY_MEMBER];
+} PggEventRing;
+
+static const char *const policy_kind_names[PGG_NUM_POLICY_KINDS] = {"enforced", "shadow"};
+
+static PggEventRing *pgg_events = NULL;
+
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+PGDLLEXPORT void pgg_eventlog_worker_main(Datum main_arg);
+
+static Size
+eventlog_shmem_size(void)
+{
+    return add_size(offsetof(PggEventRing, slots),
+                    mul_size(pgg_event_queue_size, sizeof(PggEventSlot)));
+}
+
+static void
+eventlog_shmem_request(void)
+{
+    if (prev_shmem_request_hook)
+        prev_shmem_request_hook();
+
+    RequestAddinShmemSpace(MAXALIGN(eventlog_shmem_size()));
+}
+
+static void
+eventlog_shmem_startup(void)
+{
+    bool        found;
+    int         i;
+
+    if (prev_shmem_startup_hook)
+        prev_shmem_startup_hook();
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+    pgg_events = ShmemInitStruct("pg_passwordguard events", eventlog_shmem_size(), &found);
+    if (!found)
+    {
+        pg_atomic_init_u64(&pgg_events->head, 0);
+        pgg_events->tail = 0;
+        pg_atomic_init_u64(&pgg_events->dropped, 0);
+        pgg_events->worker_latch = NULL;
+        pgg_events->size = pgg_event_queue_size;
+        for (i = 0; i < pgg_events->size; i++)
+            pg_atomic_init_u64(&pgg_events->slots[i].seq, i);
+    }
+
+    LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * pgg_eventlog_init
+ *
+ * Called from _PG_init. Reserves the ring and registers the worker when loaded at server start.
+ */
+void
+pgg_eventlog_init(void)
+{
+    BackgroundWorker worker;
+
+    if (!process_shared_preload_libraries_in_progress)
+        return;
+
+    prev_shmem_request_hook = shmem_request_hook;
+    shmem_request_hook = eventlog_shmem_request;
+    prev_shmem_startup_hook = shmem_startup_hook;
+    shmem_startup_hook = eventlog_shmem_startup;
+
+    memset(&worker, 0, sizeof(worker));
+    worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+    worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+    worker.bgw_restart_time = 10;
+    snprintf(worker.bgw_library_name, sizeof(worker.bgw_library_name), "pg_passwordguard");
+    snprintf(worker.bgw_function_name, sizeof(worker.bgw_function_name), "pgg_eventlog_worker_main");
+    snprintf(worker.bgw_name, sizeof(worker.bgw_name), "pg_passwordguard event logger");
+    snprintf(worker.bgw_type, sizeof(worker.bgw_type), "pg_passwordguard event logger");
+    RegisterBackgroundWorker(&worker);
+}
+
+/* Are events being collected? */
+bool
+pgg_eventlog_enabled(void)
+{
+    return pgg_events != NULL && pgg_event_log != NULL && pgg_event_log[0] != '\0';
+}
+
+/*
+ * pgg_eventlog_add
+ *
+ * Queues an event for a check under a policy. Never waits: if the ring is full the event is dropped.
+ */
+void
+pgg_eventlog_add(PggPolicyKind kind, const char *role, const PggPolicy *policy,
+                 const PggVerdict *verdict, bool rejected)
+{
+    PggEventSlot *slot;
+    uint64      pos;
+    Latch      *latch;
+
+    if (!pgg_eventlog_enabled())
+        return;
+
+    pos = pg_atomic_read_u64(&pgg_events->head);
+    for (;;)
+    {
+        int64       diff;
+
+        slot = &pgg_events->slots[pos % pgg_events->size];
+        diff = (int64) (pg_atomic_read_u64(&slot->seq) - pos);
+
+        if (diff == 0)
+        {
+            /* The slot is free for pos; claim it (on failure pos is updated to the current head). */
+            if (pg_atomic_compare_exchange_u64(&pgg_events->head, &pos, pos + 1))
+                break;
+        }
+        else if (diff < 0)
+        {
+            /* The worker hasn't read the event written a lap ago: the ring is full. */
+            pg_atomic_fetch_add_u64(&pgg_events->dropped, 1);
+            return;
+        }
+        else
+            pos = pg_atomic_read_u64(&pgg_events->head);
+    }
+
+    slot->event.time = GetCurrentTimestamp();
+    namestrcpy(&slot->event.role, role);
+    slot->event.database = MyDatabaseId;
+    slot->event.policy_version = pgg_policy_version(policy);
+    slot->event.violated = verdict->violated;
+    slot->event.skipped = verdict->skipped;
+    slot->event.kind = kind;
+    slot->event.rejected = rejected;
+
+    /* Publish: the worker reads the slot once it sees seq == pos + 1. */
+    pg_write_barrier();
+    pg_atomic_write_u64(&slot->seq, pos + 1);
+
+    latch = pgg_events->worker_latch;
+    if (latch)
+        SetLatch(latch);
+}
+
+/* Takes up to max events off the ring; worker only. */
+static int
+eventlog_take(PggEvent *batch, int max)
+{
+    int         n = 0;
+
+    while (n < max)
+    {
+        uint64      pos = pgg_events->tail;
+        PggEventSlot *slot = &pgg_events->slots[pos % pgg_events->size];
+
+        if (pg_atomic_read_u64(&slot->seq) != pos + 1)
+            break;
+
+        pg_read_barrier();
+        batch[n++] = slot->event;
+
+        /* Free the slot for the write one lap later. */
+        pg_memory_barrier();
+        pg_atomic_write_u64(&slot->seq, pos + pgg_events->size);
+        pgg_events->tail = pos + 1;
+    }
+
+    return n;
+}
+
+static void
+append_rule_list(StringInfo buf, uint32 rules)
+{
+    bool        first = true;
+    int         i;
+
+    appendStringInfoChar(buf, '[');
+    for (i = 0; i < PGG_NUM_RULES; i++)
+    {
+        if (rules & PGG_RULE_BIT(i))
+        {
+            if (!first)
+                appendStringInfoChar(buf, ',');
+            appendStringInfo(buf, "\"%s\"", pgg_rule_names[i]);
+            first = false;
+        }
+    }
+    appendStringInfoChar(buf, ']');
+}
+
+static void
+append_event(StringInfo buf, const PggEvent *event)
+{
+    appendStringInfoString(buf, "{\"time\":");
+    escape_json(buf, timestamptz_to_str(event->time));
+    appendStringInfoString(buf, ",\"role\":");
+    escape_json(buf, NameStr(event->role));
+    appendStringInfo(buf, ",\"database\":%u,\"policy\":\"%s\",\"policy_version\":\"%08x\",",
+                     event->database, policy_kind_names[event->kind], event->policy_version);
+    appendStringInfo(buf, "\"rule_mask\":%u,\"rules\":", event->violated);
+    append_rule_list(buf, event->violated);
+    appendStringInfoString(buf, ",\"skipped\":");
+    append_rule_list(buf, event->skipped);
+    appendStringInfo(buf, ",\"rejected\":%s}\n", event->rejected ? "true" : "false");
+}
+
+/* The open event file, and the path it was opened with. */
+static int  event_fd = -1;
+static char *event_path = NULL;
+
+static void
+eventlog_close(void)
+{
+    if (event_fd >= 0)
+        close(event_fd);
+    event_fd = -1;
+    if (event_path)
+        pfree(event_path);
+    event_path = NULL;
+}
+
+/* Opens pg_passwordguard.event_log if it isn't open yet (or changed); returns false on failure. */
+static bool
+eventlog_open(void)
+{
+    if (event_fd >= 0 && strcmp(event_path, pgg_event_log) == 0)
+        return true;
+
+    eventlog_close();
+    event_fd = open(pgg_event_log, O_WRONLY | O_APPEND | O_CREAT | PG_BINARY, pg_file_create_mode);
+    if (event_fd < 0)
+    {
+        ereport(LOG,
+                (errcode_for_file_access(),
+                 errmsg("pg_passwordguard: could not open event log \"%s\": %m", pgg_event_log)));
+        return false;
+    }
+    event_path = MemoryContextStrdup(TopMemoryContext, pgg_event_log);
+    return true;
+}
+
+/* Starts a new file once the current one has reached the rotation size. */
+static void
+eventlog_rotate(void)
+{
+    struct stat st;
+    char       *old_path;
+
+    if (pgg_event_log_rotation_size <= 0 || fstat(event_fd, &st) < 0 ||
+        st.st_size < (off_t) pgg_event_log_rotation_size * 1024)
+        return;
+
+    old_path = psprintf("%s.1", event_path);
+    if (rename(event_path, old_path) < 0)
+        ereport(LOG,
+                (errcode_for_file_access(),
+                 errmsg("pg_passwordguard: could not rename event log \"%s\" to \"%s\": %m",
+                        event_path, old_path)));
+    pfree(old_path);
+
+    /* Reopened (as a new file) by the next write. */
+    eventlog_close();
+}
+
+static void
+eventlog_write(StringInfo buf)
+{
+    if (buf->len == 0 || !eventlog_open())
+        return;
+
+    if (write(event_fd, buf->data, buf->len) != buf->len)
+        ereport(LOG,
+                (errcode_for_file_access(),
+                 errmsg("pg_passwordguard: could not write event log \"%s\": %m", event_path)));
+
+    eventlog_rotate();
+}
+
+/* Writes out everything that is queued. */
+static void
+eventlog_drain(StringInfo buf)
+{
+    PggEvent    batch[EVENT_BATCH_SIZE];
+    uint64      dropped;
+    int         n;
+    int         i;
+
+    do
+    {
+        n = eventlog_take(batch, EVENT_BATCH_SIZE);
+
+        resetStringInfo(buf);
+        dropped = pg_atomic_exchange_u64(&pgg_events->dropped, 0);
+        if (dropped > 0)
+        {
+            appendStringInfoString(buf, "{\"time\":");
+            escape_json(buf, timestamptz_to_str(GetCurrentTimestamp()));
+            appendStringInfo(buf, ",\"dropped\":" UINT64_FORMAT "}\n", dropped);
+        }
+        for (i = 0; i < n; i++)
+            append_event(buf, &batch[i]);
+
+        /* With the event log turned off, queued events are discarded. */
+        if (pgg_event_log[0] != '\0')
+            eventlog_write(buf);
+        else
+            eventlog_close();
+    } while (n == EVENT_BATCH_SIZE);
+}
+
+/*
+ * pgg_eventlog_worker_main
+ *
+ * Main loop of the event logger: sleeps until an event is queued (or for a second), then writes out
+ * the ring and, when due, the warning summary.
+ */
+void
+pgg_eventlog_worker_main(Datum main_arg)
+{
+    StringInfoData buf;
+
+    pqsignal(SIGHUP, SignalHandlerForConfigReload);
+    pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
+    BackgroundWorkerUnblockSignals();
+
+    initStringInfo(&buf);
+    pgg_events->worker_latch = MyLatch;
+
+    while (!ShutdownRequestPending)
+    {
+        (void) WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+                         1000L, PG_WAIT_EXTENSION);
+        ResetLatch(MyLatch);
+
+        if (ConfigReloadPending)
+        {
+            ConfigReloadPending = false;
+            ProcessConfigFile(PGC_SIGHUP);
+        }
+
+        eventlog_drain(&buf);
+        pgg_warnings_summarize();
+    }
+
+    /* Whatever was queued before shutdown. */
+    pgg_events->worker_latch = NULL;
+    eventlog_drain(&buf);
+    eventlog_close();
+
+    proc_exit(0);
+}
@@ -0,0 +1,744 @@
+/*
+ * expiry.c
+ *
+ * Password expiry notifications: a background worker that announces, at each lead time of
+ * pg_passwordguard.expiry_notice_days before a role's VALID UNTIL, that its password is about to
+ * expire, with a NOTIFY on the channel pg_passwordguard_expiry and a LOG line.
+ *
+ * The worker doesn't poll. It reads pg_authid once, puts the next notification time of every role
+ * into a min-heap in shared memory, and sleeps until the earliest one. When it comes, the worker pops
+ * every notification that is due, sends them together in one transaction (and one LOG line), pushes
+ * each role's next lead time, and sleeps again. Backends that create, alter or drop a role set the
+ * worker's latch when they commit, and the worker then reads pg_authid again; so does a reload.
+ *
+ * Every lead time is announced once per role and VALID UNTIL. A role already within a lead time when
+ * the worker first sees it (at startup, or when VALID UNTIL is set close) is announced right away.
+ *
+ * Needs shared memory and a background worker, so the library must be loaded through
+ * shared_preload_libraries, and pg_passwordguard.expiry_database must name the database the worker
+ * connects to (where the NOTIFYs can be listened for).
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres.h"
+
+#include <limits.h>
+
+#include "access/xact.h"
+#include "catalog/objectaccess.h"
+#include "catalog/pg_authid.h"
+#include "commands/async.h"
+#include "executor/spi.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/json.h"
+#include "utils/snapmgr.h"
+#include "utils/timestamp.h"
+#include "utils/varlena.h"
+
+#include "passwordguard.h"
+
+#define EXPIRY_CHANNEL          "pg_passwordguard_expiry"
+
+/* Lead times in expiry_notice_days, and the longest one. */
+#define EXPIRY_MAX_LEADS        16
+#define EXPIRY_MAX_LEAD_DAYS    3650
+
+/* Roles listed in the LOG line of one batch; the rest are only counted. */
+#define EXPIRY_LOG_DETAIL       20
+
+/* The next notification of a role: its password expires at valid_until, in days days from notify_at. */
+typedef struct ExpiryEntry
+{
+    TimestampTz notify_at;
+    TimestampTz valid_until;
+    Oid         roleid;
+    int         days;
+} ExpiryEntry;
+
+typedef struct PggExpiryShared
+{
+    LWLock     *lock;           /* protects count and heap */
+    Latch      *worker_latch;
+    pg_atomic_uint32 rescan;    /* roles changed since the worker last read pg_authid */
+    int         size;
+    int         count;
+    ExpiryEntry heap[FLEXIBLE_ARRAY_MEMBER];    /* min-heap on notify_at */
+} PggExpiryShared;
+
+/* Worker-local: the shortest lead time already announced for a role and VALID UNTIL. */
+typedef struct ExpiryNotified
+{
+    Oid         roleid;
+    TimestampTz valid_until;
+    int         days;
+    bool        seen;           /* still in pg_authid at the last scan */
+} ExpiryNotified;
+
+/* expiry_notice_days, parsed by the GUC hooks: longest lead first. */
+typedef struct ExpiryLeads
+{
+    int         n;
+    int         days[EXPIRY_MAX_LEADS];
+} ExpiryLeads;
+
+static ExpiryLeads *expiry_leads = NULL;
+
+static PggExpiryShared *pgg_expiry = NULL;
+static HTAB *expiry_notified = NULL;
+
+/* A role was created, altered or dropped in the current transaction. */
+static bool roles_changed = false;
+
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+static object_access_hook_type prev_object_access_hook = NULL;
+
+PG_FUNCTION_INFO_V1(pg_passwordguard_expiry_queue);
+
+PGDLLEXPORT void pgg_expiry_worker_main(Datum main_arg);
+
+static Size
+expiry_shmem_size(void)
+{
+    return add_size(offsetof(PggExpiryShared, heap),
+                    mul_size(pgg_expiry_max_roles, sizeof(ExpiryEntry)));
+}
+
+static void
+expiry_shmem_request(void)
+{
+    if (prev_shmem_request_hook)
+        prev_shmem_request_hook();
+
+    RequestAddinShmemSpace(MAXALIGN(expiry_shmem_size()));
+    RequestNamedLWLockTranche("pg_passwordguard expiry", 1);
+}
+
+static void
+expiry_shmem_startup(void)
+{
+    bool        found;
+
+    if (prev_shmem_startup_hook)
+        prev_shmem_startup_hook();
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+    pgg_expiry = ShmemInitStruct("pg_passwordguard expiry", expiry_shmem_size(), &found);
+    if (!found)
+    {
+        pgg_expiry->lock = &(GetNamedLWLockTranche("pg_passwordguard expiry"))->lock;
+        pgg_expiry->worker_latch = NULL;
+        pg_atomic_init_u32(&pgg_expiry->rescan, 1);
+        pgg_expiry->size = pgg_expiry_max_roles;
+        pgg_expiry->count = 0;
+    }
+
+    LWLockRelease(AddinShmemInitLock);
+}
+
+static void
+expiry_object_access(ObjectAccessType access, Oid classId, Oid objectId, int subId, void *arg)
+{
+    if (prev_object_access_hook)
+        prev_object_access_hook(access, classId, objectId, subId, arg);
+
+    if (classId == AuthIdRelationId &&
+        (access == OAT_POST_CREATE || access == OAT_POST_ALTER || access == OAT_DROP))
+        roles_changed = true;
+}
+
+/* Wakes the worker once the role changes are committed. */
+static void
+expiry_xact_callback(XactEvent event, void *arg)
+{
+    Latch      *latch;
+
+    if (event == XACT_EVENT_COMMIT && roles_changed)
+    {
+        pg_atomic_write_u32(&pgg_expiry->rescan, 1);
+        latch = pgg_expiry->worker_latch;
+        if (latch)
+            SetLatch(latch);
+    }
+
+    if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT ||
+        event == XACT_EVENT_PARALLEL_COMMIT || event == XACT_EVENT_PARALLEL_ABORT ||
+        event == XACT_EVENT_PREPARE)
+        roles_changed = false;
+}
+
+/*
+ * pgg_expiry_init
+ *
+ * Called from _PG_init. Reserves the heap and registers the worker when loaded at server start with
+ * pg_passwordguard.expiry_database set.
+ */
+void
+pgg_expiry_init(void)
+{
+    BackgroundWorker worker;
+
+    if (!process_shared_preload_libraries_in_progress ||
+        pgg_expiry_database == NULL || pgg_expiry_database[0] == '\0')
+        return;
+
+    prev_shmem_request_hook = shmem_request_hook;
+    shmem_request_hook = expiry_shmem_request;
+    prev_shmem_startup_hook = shmem_startup_hook;
+    shmem_startup_hook = expiry_shmem_startup;
+    prev_object_access_hook = object_access_hook;
+    object_access_hook = expiry_object_access;
+    RegisterXactCallback(expiry_xact_callback, NULL);
+
+    memset(&worker, 0, sizeof(worker));
+    worker.bgw_flags = BGWORKER_SHMEM_ACCESS | BGWORKER_BACKEND_DATABASE_CONNECTION;
+    worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+    worker.bgw_restart_time = 10;
+    snprintf(worker.bgw_library_name, sizeof(worker.bgw_library_name), "pg_passwordguard");
+    snprintf(worker.bgw_function_name, sizeof(worker.bgw_function_name), "pgg_expiry_worker_main");
+    snprintf(worker.bgw_name, sizeof(worker.bgw_name), "pg_passwordguard expiry notifier");
+    snprintf(worker.bgw_type, sizeof(worker.bgw_type), "pg_passwordguard expiry notifier");
+    RegisterBackgroundWorker(&worker);
+}
+
+static int
+lead_cmp(const void *a, const void *b)
+{
+    int         da = *(const int *) a;
+    int         db = *(const int *) b;
+
+    return (da < db) - (da > db);
+}
+
+/*
+ * pgg_expiry_days_check
+ *
+ * GUC check hook of pg_passwordguard.expiry_notice_days: a comma-separated list of days.
+ */
+bool
+pgg_expiry_days_check(char **newval, void **extra, GucSource source)
+{
+    char       *raw = pstrdup(*newval);
+    List       *items;
+    ListCell   *lc;
+    ExpiryLeads leads;
+    ExpiryLeads *result;
+    int         i;
+    int         n = 0;
+
+    if (!SplitIdentifierString(raw, ',', &items))
+    {
+        GUC_check_errdetail("List syntax is invalid.");
+        pfree(raw);
+        return false;
+    }
+
+    leads.n = 0;
+    foreach(lc, items)
+    {
+        char       *item = (char *) lfirst(lc);
+        char       *end;
+        long        days;
+
+        errno = 0;
+        days = strtol(item, &end, 10);
+        if (*item == '\0' || *end != '\0' || errno != 0 || days < 1 || days > EXPIRY_MAX_LEAD_DAYS)
+        {
+            GUC_check_errdetail("\"%s\" is not a number of days between 1 and %d.",
+                                item, EXPIRY_MAX_LEAD_DAYS);
+            pfree(raw);
+            list_free(items);
+            return false;
+        }
+        if (leads.n == EXPIRY_MAX_LEADS)
+        {
+            GUC_check_errdetail("At most %d lead times can be given.", EXPIRY_MAX_LEADS);
+            pfree(raw);
+            list_free(items);
+            return false;
+        }
+        leads.days[leads.n++] = (int) days;
+    }
+    pfree(raw);
+    list_free(items);
+
+    /* Longest first, without duplicates. */
+    qsort(leads.days, leads.n, sizeof(int), lead_cmp);
+    for (i = 0; i < leads.n; i++)
+    {
+        if (n == 0 || leads.days[i] != leads.days[n - 1])
+            leads.days[n++] = leads.days[i];
+    }
+    leads.n = n;
+
+    result = guc_malloc(LOG, sizeof(ExpiryLeads));
+    if (result == NULL)
+        return false;
+    *result = leads;
+    *extra = result;
+    return true;
+}
+
+/*
+ * pgg_expiry_days_assign
+ *
+ * GUC assign hook of pg_passwordguard.expiry_notice_days.
+ */
+void
+pgg_expiry_days_assign(const char *newval, void *extra)
+{
+    expiry_leads = (ExpiryLeads *) extra;
+}
+
+/* The time the lead time of days before valid_until starts. */
+static inline TimestampTz
+lead_start(TimestampTz valid_until, int days)
+{
+    return valid_until - (TimestampTz) days * USECS_PER_DAY;
+}
+
+static inline bool
+heap_before(const ExpiryEntry *a, const ExpiryEntry *b)
+{
+    return a->notify_at < b->notify_at;
+}
+
+static void
+heap_sift_down(ExpiryEntry *heap, int count, int i)
+{
+    for (;;)
+    {
+        int         smallest = i;
+        int         l = 2 * i + 1;
+        int         r = l + 1;
+        ExpiryEntry tmp;
+
+        if (l < count && heap_before(&heap[l], &heap[smallest]))
+            smallest = l;
+        if (r < count && heap_before(&heap[r], &heap[smallest]))
+            smallest = r;
+        if (smallest == i)
+            break;
+
+        tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+static void
+heap_sift_up(ExpiryEntry *heap, int i)
+{
+    while (i > 0)
+    {
+        int         parent = (i - 1) / 2;
+        ExpiryEntry tmp;
+
+        if (!heap_before(&heap[i], &heap[parent]))
+            break;
+
+        tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+/* Caller holds the lock exclusively. False if the heap is full. */
+static bool
+heap_push(const ExpiryEntry *entry)
+{
+    if (pgg_expiry->count == pgg_expiry->size)
+        return false;
+
+    pgg_expiry->heap[pgg_expiry->count] = *entry;
+    heap_sift_up(pgg_expiry->heap, pgg_expiry->count++);
+    return true;
+}
+
+/* Caller holds the lock exclusively. */
+static ExpiryEntry
+heap_pop(void)
+{
+    ExpiryEntry top = pgg_expiry->heap[0];
+
+    pgg_expiry->heap[0] = pgg_expiry->heap[--pgg_expiry->count];
+    heap_sift_down(pgg_expiry->heap, pgg_expiry->count, 0);
+    return top;
+}
+
+/*
+ * The lead time a password expiring at valid_until is in at now (the shortest that has started), or
+ * 0 if none; and in *next, the next one to start, if any.
+ */
+static int
+current_lead(TimestampTz valid_until, TimestampTz now, ExpiryEntry *next)
+{
+    int         current = 0;
+    int         i;
+
+    next->days = 0;
+
+    /* Longest lead first, so they start in order. */
+    for (i = 0; i < expiry_leads->n; i++)
+    {
+        int         days = expiry_leads->days[i];
+
+        if (lead_start(valid_until, days) > now)
+        {
+            next->notify_at = lead_start(valid_until, days);
+            next->valid_until = valid_until;
+            next->days = days;
+            break;
+        }
+        current = days;
+    }
+
+    return current;
+}
+
+/* Appends a notification of role to the batch, if its lead time days wasn't announced yet. */
+static void
+expiry_due(List **batch, Oid roleid, TimestampTz valid_until, int days)
+{
+    ExpiryNotified *notified;
+    ExpiryEntry *entry;
+    bool        found;
+
+    notified = hash_search(expiry_notified, &roleid, HASH_ENTER, &found);
+    notified->seen = true;
+    if (found && notified->valid_until == valid_until && notified->days <= days)
+        return;
+
+    notified->valid_until = valid_until;
+    notified->days = days;
+
+    entry = palloc(sizeof(ExpiryEntry));
+    entry->notify_at = 0;
+    entry->valid_until = valid_until;
+    entry->roleid = roleid;
+    entry->days = days;
+    *batch = lappend(*batch, entry);
+}
+
+static int
+entry_cmp(const void *a, const void *b)
+{
+    const ExpiryEntry *ea = (const ExpiryEntry *) a;
+    const ExpiryEntry *eb = (const ExpiryEntry *) b;
+
+    return (ea->notify_at > eb->notify_at) - (ea->notify_at < eb->notify_at);
+}
+
+/*
+ * Reads the login roles with a VALID UNTIL from pg_authid and rebuilds the heap. Roles already within a
+ * lead time that wasn't announced go to batch. Returns false if the heap couldn't hold every role;
+ * the earliest ones are kept.
+ */
+static bool
+expiry_scan(TimestampTz now, List **batch)
+{
+    HASH_SEQ_STATUS status;
+    ExpiryNotified *notified;
+    ExpiryEntry *entries;
+    int         nentries = 0;
+    bool        complete = true;
+    uint64      i;
+    int         j;
+
+    hash_seq_init(&status, expiry_notified);
+    while ((notified = hash_seq_search(&status)) != NULL)
+        notified->seen = false;
+
+    SetCurrentStatementStartTimestamp();
+    StartTransactionCommand();
+    PushActiveSnapshot(GetTransactionSnapshot());
+    pgstat_report_activity(STATE_RUNNING, "reading role expiry times");
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+    if (SPI_execute("SELECT oid, rolvaliduntil FROM pg_catalog.pg_authid "
+                    "WHERE rolcanlogin AND rolvaliduntil IS NOT NULL", true, 0) != SPI_OK_SELECT)
+        elog(ERROR, "SPI_execute failed");
+
+    entries = MemoryContextAlloc(TopMemoryContext, Max(SPI_processed, 1) * sizeof(ExpiryEntry));
+
+    for (i = 0; i < SPI_processed; i++)
+    {
+        HeapTuple   tuple = SPI_tuptable->vals[i];
+        bool        isnull;
+        Oid         roleid;
+        TimestampTz valid_until;
+        ExpiryEntry next;
+        int         days;
+
+        roleid = DatumGetObjectId(SPI_getbinval(tuple, SPI_tuptable->tupdesc, 1, &isnull));
+        valid_until = DatumGetTimestampTz(SPI_getbinval(tuple, SPI_tuptable->tupdesc, 2, &isnull));
+
+        /* Expired already, or never (infinity). */
+        if (valid_until <= now || TIMESTAMP_NOT_FINITE(valid_until))
+            continue;
+
+        days = current_lead(valid_until, now, &next);
+        if (days > 0)
+        {
+            MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+            expiry_due(batch, roleid, valid_until, days);
+            MemoryContextSwitchTo(oldcontext);
+        }
+        else if ((notified = hash_search(expiry_notified, &roleid, HASH_FIND, NULL)) != NULL)
+            notified->seen = true;
+
+        if (next.days > 0)
+        {
+            next.roleid = roleid;
+            entries[nentries++] = next;
+        }
+    }
+
+    SPI_finish();
+    PopActiveSnapshot();
+    CommitTransactionCommand();
+    pgstat_report_activity(STATE_IDLE, NULL);
+
+    /* Forget the roles that are gone, or no longer expire. */
+    hash_seq_init(&status, expiry_notified);
+    while ((notified = hash_seq_search(&status)) != NULL)
+    {
+        if (!notified->seen)
+            hash_search(expiry_notified, &notified->roleid, HASH_REMOVE, NULL);
+    }
+
+    if (nentries > pgg_expiry->size)
+    {
+        qsort(entries, nentries, sizeof(ExpiryEntry), entry_cmp);
+        nentries = pgg_expiry->size;
+        complete = false;
+    }
+
+    LWLockAcquire(pgg_expiry->lock, LW_EXCLUSIVE);
+    memcpy(pgg_expiry->heap, entries, nentries * sizeof(ExpiryEntry));
+    pgg_expiry->count = nentries;
+    for (j = nentries / 2 - 1; j >= 0; j--)
+        heap_sift_down(pgg_expiry->heap, nentries, j);
+    LWLockRelease(pgg_expiry->lock);
+
+    pfree(entries);
+    return complete;
+}
+
+/* Pops the notifications due at now into batch, and pushes the next lead time of each role. */
+static void
+expiry_pop_due(TimestampTz now, List **batch)
+{
+    MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+    LWLockAcquire(pgg_expiry->lock, LW_EXCLUSIVE);
+    while (pgg_expiry->count > 0 && pgg_expiry->heap[0].notify_at <= now)
+    {
+        ExpiryEntry top = heap_pop();
+        ExpiryEntry next;
+        int         days;
+
+        days = current_lead(top.valid_until, now, &next);
+        if (days > 0)
+            expiry_due(batch, top.roleid, top.valid_until, days);
+        if (next.days > 0)
+        {
+            next.roleid = top.roleid;
+            (void) heap_push(&next);    /* there is room: top was just popped */
+        }
+    }
+    LWLockRelease(pgg_expiry->lock);
+
+    MemoryContextSwitchTo(oldcontext);
+}
+
+/* Sends the notifications of batch, in one transaction, and logs them in one line. */
+static void
+expiry_notify(List *batch)
+{
+    StringInfoData payload;
+    StringInfoData detail;
+    ListCell   *lc;
+    int         sent = 0;
+
+    if (batch == NIL)
+        return;
+
+    SetCurrentStatementStartTimestamp();
+    StartTransactionCommand();
+    pgstat_report_activity(STATE_RUNNING, "sending password expiry notifications");
+
+    initStringInfo(&payload);
+    initStringInfo(&detail);
+
+    foreach(lc, batch)
+    {
+        ExpiryEntry *entry = (ExpiryEntry *) lfirst(lc);
+        char       *role = GetUserNameFromId(entry->roleid, true);
+        const char *valid_until;
+
+        /* Dropped since it was read. */
+        if (role == NULL)
+            continue;
+
+        valid_until = timestamptz_to_str(entry->valid_until);
+
+        resetStringInfo(&payload);
+        appendStringInfoString(&payload, "{\"role\":");
+        escape_json(&payload, role);
+        appendStringInfoString(&payload, ",\"valid_until\":");
+        escape_json(&payload, valid_until);
+        appendStringInfo(&payload, ",\"days\":%d}", entry->days);
+        Async_Notify(EXPIRY_CHANNEL, payload.data);
+
+        if (sent < EXPIRY_LOG_DETAIL)
+            appendStringInfo(&detail, "%srole \"%s\" within %d days (%s)",
+                             sent > 0 ? "; " : "", role, entry->days, valid_until);
+        sent++;
+    }
+    if (sent > EXPIRY_LOG_DETAIL)
+        appendStringInfo(&detail, "; %d more", sent - EXPIRY_LOG_DETAIL);
+
+    if (sent > 0)
+        ereport(LOG,
+                (errmsg("pg_passwordguard: the passwords of %d roles expire soon", sent),
+                 errdetail("%s", detail.data)));
+
+    CommitTransactionCommand();
+    pgstat_report_activity(STATE_IDLE, NULL);
+
+    pfree(payload.data);
+    pfree(detail.data);
+    list_free_deep(batch);
+}
+
+/*
+ * pgg_expiry_worker_main
+ *
+ * Main loop of the expiry notifier: sleeps until the next notification is due, or roles change.
+ */
+void
+pgg_expiry_worker_main(Datum main_arg)
+{
+    HASHCTL     info;
+    bool        complete = true;
+
+    pqsignal(SIGHUP, SignalHandlerForConfigReload);
+    pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
+    BackgroundWorkerUnblockSignals();
+
+    BackgroundWorkerInitializeConnection(pgg_expiry_database, NULL, 0);
+
+    info.keysize = sizeof(Oid);
+    info.entrysize = sizeof(ExpiryNotified);
+    expiry_notified = hash_create("pg_passwordguard expiry notified", 1024, &info,
+                                  HASH_ELEM | HASH_BLOBS);
+
+    pgg_expiry->worker_latch = MyLatch;
+    pg_atomic_write_u32(&pgg_expiry->rescan, 1);
+
+    while (!ShutdownRequestPending)
+    {
+        TimestampTz now;
+        List       *batch = NIL;
+        long        timeout = -1;
+        int         events = WL_LATCH_SET | WL_EXIT_ON_PM_DEATH;
+
+        if (ConfigReloadPending)
+        {
+            ConfigReloadPending = false;
+            ProcessConfigFile(PGC_SIGHUP);
+            pg_atomic_write_u32(&pgg_expiry->rescan, 1);
+        }
+
+        now = GetCurrentTimestamp();
+
+        /* With a full heap, the roles left out are only found by reading pg_authid again. */
+        if (pg_atomic_exchange_u32(&pgg_expiry->rescan, 0) != 0 || !complete)
+            complete = expiry_scan(now, &batch);
+        expiry_pop_due(now, &batch);
+        expiry_notify(batch);
+
+        LWLockAcquire(pgg_expiry->lock, LW_SHARED);
+        if (pgg_expiry->count > 0)
+        {
+            TimestampTz next = pgg_expiry->heap[0].notify_at;
+
+            /* Round up, so the wait doesn't end just before the deadline. */
+            timeout = (long) Min((next - now + 999) / 1000, (TimestampTz) INT_MAX);
+            events |= WL_TIMEOUT;
+        }
+        LWLockRelease(pgg_expiry->lock);
+
+        (void) WaitLatch(MyLatch, events, Max(timeout, 0), PG_WAIT_EXTENSION);
+        ResetLatch(MyLatch);
+        CHECK_FOR_INTERRUPTS();
+    }
+
+    pgg_expiry->worker_latch = NULL;
+    proc_exit(0);
+}
+
+/*
+ * pg_passwordguard_expiry_queue
+ *
+ * The upcoming notifications, earliest first: role, valid_until, days, notify_at.
+ */
+Datum
+pg_passwordguard_expiry_queue(PG_FUNCTION_ARGS)
+{
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    ExpiryEntry *entries;
+    int         count;
+    int         i;
+
+    if (pgg_expiry == NULL)
+        ereport(ERROR,
+                (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                 errmsg("pg_passwordguard.expiry_database is not set, or pg_passwordguard is not loaded via shared_preload_libraries")));
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    LWLockAcquire(pgg_expiry->lock, LW_SHARED);
+    count = pgg_expiry->count;
+    entries = palloc(Max(count, 1) * sizeof(ExpiryEntry));
+    memcpy(entries, pgg_expiry->heap, count * sizeof(ExpiryEntry));
+    LWLockRelease(pgg_expiry->lock);
+
+    qsort(entries, count, sizeof(ExpiryEntry), entry_cmp);
+
+    for (i = 0; i < count; i++)
+    {
+        Datum       values[4];
+        bool        nulls[4] = {false, false, false, false};
+
+        values[0] = ObjectIdGetDatum(entries[i].roleid);
+        values[1] = TimestampTzGetDatum(entries[i].valid_until);
+        values[2] = Int32GetDatum(entries[i].days);
+        values[3] = TimestampTzGetDatum(entries[i].notify_at);
+        tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+    }
+
+    pfree(entries);
+    return (Datum) 0;
+}
@@ -0,0 +1,363 @@
+/*
+ * frontend.c
+ *
+ * The client library, libpg_passwordguard.a (API in pg_passwordguard.h): the policy core compiled
+ * with FRONTEND, plus the little it needs from the backend.
+ *
+ * The core reports errors with ereport(ERROR), which in the backend never returns. Here it ends the
+ * library call instead: every API function sets a jump target for the calling thread before running
+ * core code, and the ERROR jumps back to it with the message. Warnings (a model rule with no model
+ * file, for instance) are dropped; pgguard_policy_unchecked_rules() tells callers about such rules
+ * once instead.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres_fe.h"
+
+#include <fcntl.h>
+#include <setjmp.h>
+#include <unistd.h>
+
+#include "passwordguard.h"
+#include "pg_passwordguard.h"
+
+#ifdef _MSC_VER
+#define fe_thread_local __declspec(thread)
+#else
+#define fe_thread_local __thread
+#endif
+
+/* Index of each model setting in PgGuardPolicy.models. */
+typedef enum FeModel
+{
+    FE_MARKOV_MODEL,
+    FE_GUESS_TABLE,
+    FE_PCFG_MODEL,
+    FE_NEURAL_MODEL,
+    FE_COMMON_INDEX,
+    FE_DICTIONARY,
+    FE_CRACKLIB_DICTIONARY
+} FeModel;
+
+#define FE_NUM_MODELS   (FE_CRACKLIB_DICTIONARY + 1)
+
+static const char *const fe_model_names[FE_NUM_MODELS] = {
+    "markov_model", "guess_table", "pcfg_model", "neural_model", "common_index",
+    "dictionary", "cracklib_dictionary"
+};
+
+struct PgGuardPolicy
+{
+    PggPolicy   policy;
+    char       *models[FE_NUM_MODELS];
+};
+
+/* Error state of the library call running in this thread. */
+static fe_thread_local sigjmp_buf *fe_error_jump = NULL;
+static fe_thread_local int fe_error_level;
+static fe_thread_local int fe_error_errno;
+static fe_thread_local char fe_error_message[PGGUARD_MESSAGE_SIZE];
+
+void
+pgg_fe_report_start(int elevel)
+{
+    fe_error_level = elevel;
+    fe_error_errno = errno;
+    if (elevel >= ERROR)
+        fe_error_message[0] = '\0';
+}
+
+void
+pgg_fe_report_finish(int elevel)
+{
+    if (elevel < ERROR)
+        return;
+    if (fe_error_jump == NULL)
+    {
+        fprintf(stderr, "pg_passwordguard: %s\n", fe_error_message);
+        abort();
+    }
+    siglongjmp(*fe_error_jump, 1);
+}
+
+int
+errcode(int sqlerrcode)
+{
+    return 0;
+}
+
+int
+errcode_for_file_access(void)
+{
+    return 0;
+}
+
+int
+errmsg(const char *fmt,...)
+{
+    va_list     args;
+
+    if (fe_error_level < ERROR)
+        return 0;
+
+    errno = fe_error_errno;     /* for %m */
+    va_start(args, fmt);
+    vsnprintf(fe_error_message, sizeof(fe_error_message), fmt, args);
+    va_end(args);
+    return 0;
+}
+
+int
+errdetail(const char *fmt,...)
+{
+    va_list     args;
+    size_t      len = strlen(fe_error_message);
+
+    if (fe_error_level < ERROR || len + 2 >= sizeof(fe_error_message))
+        return 0;
+
+    strcpy(fe_error_message + len, ": ");
+    len += 2;
+    errno = fe_error_errno;
+    va_start(args, fmt);
+    vsnprintf(fe_error_message + len, sizeof(fe_error_message) - len, fmt, args);
+    va_end(args);
+    return 0;
+}
+
+/*
+ * Runs fn(arg) with core errors caught: returns false, with the message in errbuf, if it raised one.
+ */
+static bool
+fe_call(void (*fn) (void *), void *arg, char *errbuf, size_t errbuf_size)
+{
+    sigjmp_buf  jump;
+    sigjmp_buf *save_jump = fe_error_jump;
+
+    if (sigsetjmp(jump, 0) != 0)
+    {
+        fe_error_jump = save_jump;
+        if (errbuf_size > 0)
+            strlcpy(errbuf, fe_error_message, errbuf_size);
+        return false;
+    }
+
+    fe_error_jump = &jump;
+    fn(arg);
+    fe_error_jump = save_jump;
+    return true;
+}
+
+typedef struct FeImport
+{
+    const void *data;
+    size_t      size;
+    PggPolicy  *policy;
+} FeImport;
+
+static void
+fe_import(void *arg)
+{
+    FeImport   *import = (FeImport *) arg;
+
+    pgg_policy_import(import->data, import->size, import->policy);
+}
+
+PgGuardPolicy *
+pgguard_policy_load(const void *data, size_t size, char *errbuf, size_t errbuf_size)
+{
+    PgGuardPolicy *policy = calloc(1, sizeof(PgGuardPolicy));
+    FeImport    import;
+
+    if (policy == NULL)
+    {
+        if (errbuf_size > 0)
+            strlcpy(errbuf, "out of memory", errbuf_size);
+        return NULL;
+    }
+
+    import.data = data;
+    import.size = size;
+    import.policy = &policy->policy;
+    if (!fe_call(fe_import, &import, errbuf, errbuf_size))
+    {
+        free(policy);
+        return NULL;
+    }
+
+    return policy;
+}
+
+/* Prepares a check of password with the models of policy and no time limit. */
+static void
+fe_check_init(PggCheck *check, const PgGuardPolicy *policy, const char *password,
+              const char *username)
+{
+    memset(check, 0, sizeof(PggCheck));
+    check->password = password;
+    check->len = strlen(password);
+    check->username = username;
+    check->markov_model = policy->models[FE_MARKOV_MODEL];
+    check->guess_table = policy->models[FE_GUESS_TABLE];
+    check->pcfg_model = policy->models[FE_PCFG_MODEL];
+    check->neural_model = policy->models[FE_NEURAL_MODEL];
+    check->common_index = policy->models[FE_COMMON_INDEX];
+    check->dictionary = policy->models[FE_DICTIONARY];
+    check->cracklib_dictionary = policy->models[FE_CRACKLIB_DICTIONARY];
+    INSTR_TIME_SET_CURRENT(check->start);
+}
+
+/* Loads every model file set for the policy, by running the model rules on a dummy password. */
+static void
+fe_load_models(void *arg)
+{
+    const PgGuardPolicy *policy = (const PgGuardPolicy *) arg;
+    PggPolicy   models;
+    PggCheck    check;
+    PggVerdict  verdict;
+
+    pgg_policy_set_defaults(&models);
+    models.min_length = 0;
+    models.require_upper = models.require_lower = false;
+    models.require_digit = models.require_special = false;
+    models.reject_username = models.reject_common = false;
+    models.min_markov_bits = policy->models[FE_MARKOV_MODEL] ? 1 : 0;
+    models.min_guesses_log10 = policy->models[FE_GUESS_TABLE] ? 1 : 0;
+    models.min_pcfg_bits = policy->models[FE_PCFG_MODEL] ? 1 : 0;
+    models.max_neural_score = policy->models[FE_NEURAL_MODEL] ? 0 : 1;
+    models.max_common_fraction = policy->models[FE_COMMON_INDEX] ? 0 : 1;
+    models.reject_dictionary = policy->models[FE_DICTIONARY] != NULL;
+    models.reject_cracklib = policy->models[FE_CRACKLIB_DICTIONARY] != NULL;
+
+    fe_check_init(&check, policy, "x", NULL);
+    pgg_policy_evaluate(&models, &check, false, &verdict);
+    pgg_check_end(&check);
+}
+
+int
+pgguard_policy_set_model(PgGuardPolicy *policy, const char *setting, const char *path,
+                         char *errbuf, size_t errbuf_size)
+{
+    char       *copy;
+    int         i;
+
+    for (i = 0; i < FE_NUM_MODELS; i++)
+    {
+        if (strcmp(setting, fe_model_names[i]) == 0)
+            break;
+    }
+    if (i == FE_NUM_MODELS)
+    {
+        if (errbuf_size > 0)
+            snprintf(errbuf, errbuf_size, "unknown model setting \"%s\"", setting);
+        return -1;
+    }
+
+    copy = strdup(path);
+    if (copy == NULL)
+    {
+        if (errbuf_size > 0)
+            strlcpy(errbuf, "out of memory", errbuf_size);
+        return -1;
+    }
+    free(policy->models[i]);
+    policy->models[i] = copy;
+
+    return fe_call(fe_load_models, policy, errbuf, errbuf_size) ? 0 : -1;
+}
+
+unsigned int
+pgguard_policy_version(const PgGuardPolicy *policy)
+{
+    return pgg_policy_version(&policy->policy);
+}
+
+unsigned int
+pgguard_policy_unchecked_rules(const PgGuardPolicy *policy)
+{
+    const PggPolicy *p = &policy->policy;
+    char       *const *models = policy->models;
+    unsigned int rules = 0;
+
+    /* Only the server knows the roles and their passwords' fingerprints. */
+    if (p->reject_rolenames)
+        rules |= PGGUARD_REJECT_ROLENAMES;
+    if (p->reject_reuse)
+        rules |= PGGUARD_REJECT_REUSE;
+
+    if (p->min_markov_bits > 0 && models[FE_MARKOV_MODEL] == NULL)
+        rules |= PGGUARD_MIN_MARKOV_BITS;
+    if (p->min_guesses_log10 > 0 &&
+        (models[FE_MARKOV_MODEL] == NULL || models[FE_GUESS_TABLE] == NULL))
+        rules |= PGGUARD_MIN_GUESSES_LOG10;
+    if (p->min_pcfg_bits > 0 && models[FE_PCFG_MODEL] == NULL)
+        rules |= PGGUARD_MIN_PCFG_BITS;
+    if (p->max_neural_score < 1.0 && models[FE_NEURAL_MODEL] == NULL)
+        rules |= PGGUARD_MAX_NEURAL_SCORE;
+    if (p->max_common_fraction < 1.0 && models[FE_COMMON_INDEX] == NULL)
+        rules |= PGGUARD_MAX_COMMON_FRACTION;
+    if (p->reject_dictionary && models[FE_DICTIONARY] == NULL)
+        rules |= PGGUARD_REJECT_DICTIONARY;
+    if (p->reject_cracklib && models[FE_CRACKLIB_DICTIONARY] == NULL)
+        rules |= PGGUARD_REJECT_CRACKLIB;
+
+    return rules;
+}
+
+typedef struct FeCheck
+{
+    const PgGuardPolicy *policy;
+    PggCheck    check;
+    PggVerdict  verdict;
+} FeCheck;
+
+static void
+fe_check(void *arg)
+{
+    FeCheck    *c = (FeCheck *) arg;
+
+    pgg_policy_evaluate(&c->policy->policy, &c->check, false, &c->verdict);
+}
+
+int
+pgguard_check(const PgGuardPolicy *policy, const char *password, const char *username,
+              PgGuardResult *result)
+{
+    FeCheck     c;
+
+    memset(result, 0, sizeof(PgGuardResult));
+
+    c.policy = policy;
+    fe_check_init(&c.check, policy, password, username);
+    if (!fe_call(fe_check, &c, result->message, sizeof(result->message)))
+    {
+        pgg_check_end(&c.check);
+        return -1;
+    }
+    pgg_check_end(&c.check);
+
+    result->violated = c.verdict.violated;
+    result->skipped = c.verdict.skipped;
+    return result->violated != 0 ? 1 : 0;
+}
+
+const char *
+pgguard_rule_name(int rule)
+{
+    if (rule < 0 || rule >= PGG_NUM_RULES)
+        return NULL;
+    return pgg_rule_names[rule];
+}
+
+void
+pgguard_policy_free(PgGuardPolicy *policy)
+{
+    int         i;
+
+    if (policy == NULL)
+        return;
+    for (i = 0; i < FE_NUM_MODELS; i++)
+        free(policy->models[i]);
+    free(policy);
+}
@@ -0,0 +1,194 @@
+#!/usr/bin/perl
+#
+# gen_common_passwords.pl
+#
+# Build-time generator for the built-in common-password table.
+#
+# Reads common_passwords.txt and writes common_passwords_table.h, which holds a
+# minimal-overhead perfect hash (hash-and-displace, "CHD") over the lowercased
+# entries plus a single packed string pool. The lookup side lives in
+# common_passwords.c and must use the same hash as pgg_hash32() in
+# passwordguard.h.
+#
+# Usage: perl gen_common_passwords.pl common_passwords.txt > common_passwords_table.h
+#
+# Developed by: Kothari Nishchay
+#
+
+use strict;
+use warnings;
+
+my $MAX_ENTRY_LEN = 255;        # lengths are stored as uint8
+my $BUCKET_SIZE   = 4;          # average keys per displacement bucket
+my $LOAD_SLACK    = 1.05;       # slots per key
+
+my $input = shift @ARGV or die "usage: $0 common_passwords.txt\n";
+
+open(my $fh, '<', $input) or die "could not open $input: $!\n";
+
+my %seen;
+my @keys;
+while (my $line = <$fh>)
+{
+	$line =~ s/\r?\n\z//;
+	next if $line eq '' || $line =~ /^#/;
+	$line = lc $line;
+	next if length($line) > $MAX_ENTRY_LEN;
+	next if $seen{$line}++;
+	push @keys, $line;
+}
+close($fh);
+
+die "$input contains no passwords\n" unless @keys;
+
+my $nkeys    = scalar @keys;
+my $nslots   = int($nkeys * $LOAD_SLACK) + 1;
+my $nbuckets = int(($nkeys + $BUCKET_SIZE - 1) / $BUCKET_SIZE);
+
+# 32-bit multiply without leaving integer range.
+sub mul32
+{
+	my ($a, $b) = @_;
+	my $lo = ($a * ($b & 0xffff)) & 0xffffffff;
+	my $hi = (($a * ($b >> 16)) & 0xffff) << 16;
+	return ($lo + $hi) & 0xffffffff;
+}
+
+# Must match pgg_hash32() in passwordguard.h.
+sub pgg_hash32
+{
+	my ($s, $seed) = @_;
+	my $h = 0x811c9dc5 ^ mul32($seed, 0x9e3779b9);
+
+	foreach my $c (unpack('C*', $s))
+	{
+		$h ^= $c;
+		$h = mul32($h, 0x01000193);
+	}
+	$h ^= $h >> 16;
+	$h = mul32($h, 0x85ebca6b);
+	$h ^= $h >> 13;
+	$h = mul32($h, 0xc2b2ae35);
+	$h ^= $h >> 16;
+	return $h;
+}
+
+my ($seed, @disp, @slot_key);
+
+SEED:
+for ($seed = 1; $seed < 1000; $seed++)
+{
+	my (@bucket_keys, @f1, @f2);
+
+	for my $i (0 .. $#keys)
+	{
+		my $b = pgg_hash32($keys[$i], $seed) % $nbuckets;
+		push @{ $bucket_keys[$b] }, $i;
+		$f1[$i] = pgg_hash32($keys[$i], $seed + 1) % $nslots;
+		$f2[$i] = pgg_hash32($keys[$i], $seed + 2) % ($nslots - 1) + 1;
+	}
+
+	@disp = (0) x $nbuckets;
+	@slot_key = (-1) x $nslots;
+
+	my @order = sort {
+		scalar(@{ $bucket_keys[$b] || [] }) <=> scalar(@{ $bucket_keys[$a] || [] })
+		  || $a <=> $b
+	} (0 .. $nbuckets - 1);
+
+	foreach my $b (@order)
+	{
+		my $members = $bucket_keys[$b] or last;
+		my $max_d0 = int(0xffffffff / $nslots);
+		my $placed = 0;
+
+	  TRY:
+		for (my $d0 = 0; $d0 < $max_d0; $d0++)
+		{
+			for (my $d1 = 0; $d1 < $nslots; $d1++)
+			{
+				my (%taken, $clash);
+				foreach my $k (@$members)
+				{
+					my $s = ($f1[$k] + $d0 * $f2[$k] + $d1) % $nslots;
+					if ($slot_key[$s] >= 0 || $taken{$s}++)
+					{
+						$clash = 1;
+						last;
+					}
+				}
+				next if $clash;
+
+				foreach my $k (@$members)
+				{
+					$slot_key[ ($f1[$k] + $d0 * $f2[$k] + $d1) % $nslots ] = $k;
+				}
+				$disp[$b] = $d0 * $nslots + $d1;
+				$placed = 1;
+				last TRY;
+			}
+		}
+		next SEED unless $placed;
+	}
+	last SEED;
+}
+
+die "could not build a perfect hash for $nkeys passwords\n" if $seed >= 1000;
+
+# Emit the table.
+my $maxlen = 0;
+my $pool   = '';
+my (@offset, @length);
+for my $s (0 .. $nslots - 1)
+{
+	my $k = $slot_key[$s];
+	if ($k < 0)
+	{
+		push @offset, 0;
+		push @length, 0;
+		next;
+	}
+	push @offset, length($pool);
+	push @length, length($keys[$k]);
+	$maxlen = length($keys[$k]) if length($keys[$k]) > $maxlen;
+	$pool .= $keys[$k];
+}
+
+sub emit_array
+{
+	my ($type, $name, @vals) = @_;
+	my $out = "static const $type $name\[" . scalar(@vals) . "] = {\n";
+	for (my $i = 0; $i < @vals; $i += 12)
+	{
+		my $last = $i + 11 < $#vals ? $i + 11 : $#vals;
+		$out .= "\t" . join(', ', @vals[ $i .. $last ]) . ",\n";
+	}
+	return $out . "};\n\n";
+}
+
+sub c_string
+{
+	my ($s) = @_;
+	$s =~ s/([^ !#-\[\]-~]|\?)/sprintf('\\%03o', ord($1))/ge;
+	return "\"$s\"";
+}
+
+print "/*\n";
+print " * common_passwords_table.h\n";
+print " *\n";
+print " * Generated by gen_common_passwords.pl from $input. DO NOT EDIT.\n";
+print " */\n\n";
+print "#define PGG_COMMON_NKEYS     $nkeys\n";
+print "#define PGG_COMMON_NSLOTS    $nslots\n";
+print "#define PGG_COMMON_NBUCKETS  $nbuckets\n";
+print "#define PGG_COMMON_MAXLEN    $maxlen\n";
+print "#define PGG_COMMON_SEED      ${seed}U\n\n";
+print emit_array('uint32', 'pgg_common_disp', @disp);
+print emit_array('uint32', 'pgg_common_offset', @offset);
+print emit_array('uint8', 'pgg_common_length', @length);
+print "static const char pgg_common_pool[] =\n";
+for (my $i = 0; $i < length($pool); $i += 64)
+{
+	print "\t" . c_string(substr($pool, $i, 64)) . "\n";
+}
+print ";\n";
@@ -0,0 +1,283 @@
+/*
+ * generate.c
+ *
+ * pg_passwordguard_generate(count, length): returns count random passwords that satisfy the enforced
+ * policy, for provisioning scripts that would otherwise generate passwords client-side and find out
+ * about the policy from rejections.
+ *
+ * Length and character classes are satisfied by construction: one character of every required class
+ * is placed first, the rest are drawn from the full alphabet, and the result is shuffled. The rules
+ * that can't be constructed for (common passwords, role names, dates, the model scores) are then
+ * checked with the normal policy evaluation; a random password almost never fails them, and the rare
+ * one that does is replaced.
+ *
+ * Random bytes come from pg_strong_random() through a small pool, so a call producing thousands of
+ * passwords makes a few dozen reads from the random source instead of one per character. The pool
+ * is wiped at the end of each call.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+
+#include "passwordguard.h"
+
+/* Length used when none is given, unless min_length asks for more. */
+#define GENERATE_DEFAULT_LENGTH     16
+
+/* Passwords drawn for one result before giving up on the policy. */
+#define GENERATE_MAX_ATTEMPTS       100
+
+#define RANDOM_POOL_SIZE            4096
+
+/*
+ * Character classes. The specials leave out quotes, backslash and space, so generated passwords can
+ * be pasted into SQL, shell scripts and connection strings unquoted.
+ */
+#define UPPER_CHARS     "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+#define LOWER_CHARS     "abcdefghijklmnopqrstuvwxyz"
+#define DIGIT_CHARS     "0123456789"
+#define SPECIAL_CHARS   "!#$%&()*+,-./:;<=>?@[]^_{|}~"
+
+/* Every class is always allowed; only the required ones are guaranteed. */
+static const char all_chars[] = UPPER_CHARS LOWER_CHARS DIGIT_CHARS SPECIAL_CHARS;
+
+static uint8 random_pool[RANDOM_POOL_SIZE];
+static int  random_pool_pos = RANDOM_POOL_SIZE;
+
+PG_FUNCTION_INFO_V1(pg_passwordguard_generate);
+
+static uint8
+random_byte(void)
+{
+    if (random_pool_pos == RANDOM_POOL_SIZE)
+    {
+        if (!pg_strong_random(random_pool, RANDOM_POOL_SIZE))
+            ereport(ERROR,
+                    (errcode(ERRCODE_INTERNAL_ERROR),
+                     errmsg("could not generate random values")));
+        random_pool_pos = 0;
+    }
+    return random_pool[random_pool_pos++];
+}
+
+/* Uniform random integer in [0, n), n <= 256; bytes that would bias the result are discarded. */
+static int
+random_index(int n)
+{
+    int         limit = 256 - 256 % n;
+
+    for (;;)
+    {
+        int         b = random_byte();
+
+        if (b < limit)
+            return b % n;
+    }
+}
+
+static char
+random_char(const char *chars, int nchars)
+{
+    return chars[random_index(nchars)];
+}
+
+/*
+ * pgg_generator_init
+ *
+ * Checks that passwords of length len (0 for the default) can satisfy policy and prepares gen.
+ * Errors out if they can't, or if the policy needs a model file that is not configured; the checks
+ * run with no time limit, so failing once is better than a warning per password.
+ */
+void
+pgg_generator_init(PggGenerator *gen, const PggPolicy *policy, int len)
+{
+    PggCheck    settings;
+    const char *missing;
+
+    if (len == 0)
+        len = Max(GENERATE_DEFAULT_LENGTH, Min(policy->min_length, PGG_GENERATE_MAX_LENGTH));
+
+    gen->policy = policy;
+    gen->len = len;
+    gen->nrequired = 0;
+    if (policy->require_upper)
+        gen->required[gen->nrequired++] = UPPER_CHARS;
+    if (policy->require_lower)
+        gen->required[gen->nrequired++] = LOWER_CHARS;
+    if (policy->require_digit)
+        gen->required[gen->nrequired++] = DIGIT_CHARS;
+    if (policy->require_special)
+        gen->required[gen->nrequired++] = SPECIAL_CHARS;
+
+    if (len < 1 || len > PGG_GENERATE_MAX_LENGTH)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("length must be between 1 and %d", PGG_GENERATE_MAX_LENGTH)));
+    if (len < policy->min_length)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("length %d is less than pg_passwordguard.min_length (%d)",
+                        len, policy->min_length)));
+    if (len < gen->nrequired)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("length %d is too short for the %d required character classes",
+                        len, gen->nrequired)));
+
+    pgg_check_init(&settings, "", 0, NULL);
+    missing = pgg_policy_missing_model(policy, &settings);
+    if (missing)
+        ereport(ERROR,
+                (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                 errmsg("the password policy needs %s, which is not set", missing)));
+}
+
+/*
+ * Fills password[0..len-1] with one character of each required class, then characters from the
+ * whole alphabet, in random order.
+ */
+static void
+generate_one(const PggGenerator *gen, char *password)
+{
+    int         len = gen->len;
+    int         i;
+
+    for (i = 0; i < gen->nrequired; i++)
+        password[i] = random_char(gen->required[i], strlen(gen->required[i]));
+    for (; i < len; i++)
+        password[i] = random_char(all_chars, sizeof(all_chars) - 1);
+
+    /* Fisher-Yates, from the end; len is at most PGG_GENERATE_MAX_LENGTH, so indexes fit in 16 bits. */
+    for (i = len - 1; i > 0; i--)
+    {
+        int         j;
+        char        tmp;
+
+        if (i < 256)
+            j = random_index(i + 1);
+        else
+        {
+            int         limit = 65536 - 65536 % (i + 1);
+
+            do
+                j = (random_byte() << 8) | random_byte();
+            while (j >= limit);
+            j %= i + 1;
+        }
+
+        tmp = password[i];
+        password[i] = password[j];
+        password[j] = tmp;
+    }
+    password[len] = '\0';
+}
+
+/*
+ * pgg_generate_password
+ *
+ * Writes a random password that satisfies the policy to password (gen->len + 1 bytes).
+ */
+void
+pgg_generate_password(const PggGenerator *gen, char *password)
+{
+    int         attempt;
+
+    for (attempt = 0; attempt < GENERATE_MAX_ATTEMPTS; attempt++)
+    {
+        PggCheck    check;
+        PggVerdict  verdict;
+
+        generate_one(gen, password);
+
+        pgg_check_init(&check, password, gen->len, NULL);
+        check.max_check_time_ms = 0;
+        check.neural_time_budget = 0;
+        pgg_policy_evaluate(gen->policy, &check, true, &verdict);
+        pgg_check_end(&check);
+        if (verdict.violated == 0)
+            return;
+    }
+
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+             errmsg("could not generate a password that satisfies the policy"),
+             errhint("Use a longer length.")));
+}
+
+/*
+ * pgg_generator_end
+ *
+ * Wipes the unused random bytes; call once done generating, also on error.
+ */
+void
+pgg_generator_end(void)
+{
+    explicit_bzero(random_pool, RANDOM_POOL_SIZE);
+    random_pool_pos = RANDOM_POOL_SIZE;
+}
+
+/*
+ * pg_passwordguard_generate(count integer, length integer DEFAULT NULL)
+ *
+ * Without a length, passwords are GENERATE_DEFAULT_LENGTH characters or min_length, whichever is
+ * longer.
+ */
+Datum
+pg_passwordguard_generate(PG_FUNCTION_ARGS)
+{
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    PggGenerator gen;
+    char       *password;
+    Datum       value;
+    bool        isnull = false;
+    int         count;
+    int         n;
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    if (PG_ARGISNULL(0))
+        return (Datum) 0;
+    count = PG_GETARG_INT32(0);
+    if (count < 0)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("count must not be negative")));
+    if (!PG_ARGISNULL(1) && PG_GETARG_INT32(1) < 1)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("length must be between 1 and %d", PGG_GENERATE_MAX_LENGTH)));
+
+    pgg_generator_init(&gen, pgg_enforced_policy(), PG_ARGISNULL(1) ? 0 : PG_GETARG_INT32(1));
+
+    password = palloc(gen.len + 1);
+
+    PG_TRY();
+    {
+        for (n = 0; n < count; n++)
+        {
+            CHECK_FOR_INTERRUPTS();
+
+            pgg_generate_password(&gen, password);
+
+            value = CStringGetTextDatum(password);
+            tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, &value, &isnull);
+            pfree(DatumGetPointer(value));
+        }
+    }
+    PG_FINALLY();
+    {
+        explicit_bzero(password, gen.len + 1);
+        pgg_generator_end();
+    }
+    PG_END_TRY();
+
+    pfree(password);
+
+    return (Datum) 0;
+}
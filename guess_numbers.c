@@ -0,0 +1,120 @@
+/*
+ * guess_numbers.c
+ *
+ * Guess-number estimation for pg_passwordguard.min_guesses_log10.
+ *
+ * Uses the Monte-Carlo method of Dell'Amico and Filippone ("Monte Carlo Strength Evaluation", CCS
+ * 2015): sample n passwords from the Markov model, sort them by decreasing probability p_i, and
+ * estimate the number of guesses an attacker using the model needs for a password of probability
+ * p as the sum of 1/(n * p_i) over all samples more probable than p. tools/build_guess_table.pl
+ * does the sampling and the prefix sums offline; here a password's model score is mapped to a
+ * guess count with one binary search over the memory-mapped table.
+ *
+ * File layout (native byte order, see PggGuessTableHeader):
+ *   header                     magic "PGGGNT01", byte order mark, sample count, model file size
+ *   bits[nsamples]             sample scores (-log2 p_i), ascending
+ *   guesses[nsamples]          estimated guesses for a password scoring bits[j], i.e. the sum of
+ *                              1/(n * p_i) over i < j
+ *   total                      the sum over all samples (for passwords less probable than any sample)
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#include <math.h>
+
+#ifndef FRONTEND
+#include "utils/memutils.h"
+#endif
+
+#include "passwordguard.h"
+
+#define GUESS_TABLE_MAGIC   "PGGGNT01"
+
+typedef struct PggGuessTableHeader
+{
+    char        magic[PGG_MAGIC_LEN];
+    uint32      byte_order;
+    uint32      nsamples;
+    uint64      model_size;     /* size of the Markov model file the samples were drawn from */
+} PggGuessTableHeader;
+
+static PggMappedFile guess_file = {NULL, 0};
+static char *guess_loaded_path = NULL;
+static uint32 guess_nsamples = 0;
+static const double *guess_bits = NULL;
+static const double *guess_counts = NULL;
+
+static void
+guess_table_load(const char *path)
+{
+    const PggGuessTableHeader *hdr;
+
+    pgg_unmap_file(&guess_file);
+    if (guess_loaded_path)
+    {
+        pfree(guess_loaded_path);
+        guess_loaded_path = NULL;
+    }
+
+    pgg_map_file(path, "guess-number table", &guess_file);
+    pgg_check_file_header(&guess_file, path, "guess-number table", GUESS_TABLE_MAGIC,
+                          sizeof(PggGuessTableHeader));
+
+    hdr = (const PggGuessTableHeader *) guess_file.data;
+    if (hdr->nsamples == 0 ||
+        guess_file.size != sizeof(PggGuessTableHeader) + (2 * (Size) hdr->nsamples + 1) * sizeof(double))
+    {
+        pgg_unmap_file(&guess_file);
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: invalid guess-number table file \"%s\"", path)));
+    }
+
+    guess_nsamples = hdr->nsamples;
+    guess_bits = (const double *) (guess_file.data + sizeof(PggGuessTableHeader));
+    guess_counts = guess_bits + guess_nsamples;
+    guess_loaded_path = MemoryContextStrdup(TopMemoryContext, path);
+}
+
+/*
+ * pgg_guess_log10
+ *
+ * Returns log10 of the estimated number of guesses for a password whose Markov model score is
+ * bits (see pgg_markov_bits), or -infinity if it is at least as probable as every sample.
+ */
+double
+pgg_guess_log10(const char *table_path, Size model_size, double bits)
+{
+    uint32      lo = 0;
+    uint32      hi;
+
+    if (guess_loaded_path == NULL || strcmp(guess_loaded_path, table_path) != 0)
+        guess_table_load(table_path);
+
+    if (((const PggGuessTableHeader *) guess_file.data)->model_size != model_size)
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: guess-number table \"%s\" was not built from the configured Markov model",
+                        table_path)));
+
+    /* First sample that is not more probable than the password (lower bound on bits). */
+    hi = guess_nsamples;
+    while (lo < hi)
+    {
+        uint32      mid = lo + (hi - lo) / 2;
+
+        if (guess_bits[mid] < bits)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* guess_counts[nsamples] is the total over all samples */
+    return log10(guess_counts[lo]);
+}
@@ -0,0 +1,222 @@
+/*
+ * history.c
+ *
+ * Policy-version tracking: with pg_passwordguard.track_policy_versions on, every password change is
+ * recorded in the extension's pg_passwordguard_password_changes table with the role OID, the time,
+ * the version hash of the enforced policy that checked it (pgg_policy_version) and whether it passed.
+ * A pre-hashed password, which no policy can check, is recorded with both null. After a policy change, the roles whose password predates it are found with an index scan, and only
+ * those need to be rotated.
+ *
+ * The password check hook runs before CREATE ROLE has assigned the role its OID, so the hook only
+ * remembers the verdict; the row is inserted from the object access hook that fires when the role is
+ * created or altered by the same statement. The insert is part of the statement's transaction, so it
+ * is rolled back with it. Rows of dropped roles are deleted, since role OIDs get reused.
+ *
+ * Roles are shared by all databases, but the table lives in one: changes are recorded in the database
+ * they were made from, if the extension is installed there at version 1.1 or later.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres.h"
+
+#include "access/xact.h"
+#include "catalog/objectaccess.h"
+#include "catalog/pg_authid.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_type.h"
+#include "commands/extension.h"
+#include "executor/spi.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/syscache.h"
+
+#include "passwordguard.h"
+
+#define HISTORY_TABLE   "pg_passwordguard_password_changes"
+
+/* Verdict of the last password check, until the statement that set the password records it. */
+static bool pending = false;
+static char pending_version[9];     /* empty if the password wasn't checked */
+static bool pending_compliant;
+
+static object_access_hook_type prev_object_access_hook = NULL;
+
+PG_FUNCTION_INFO_V1(pg_passwordguard_policy_version);
+
+/* Formats the version hash of policy as 8 hex digits, as in the table and the event log. */
+static void
+format_policy_version(const PggPolicy *policy, char *buf)
+{
+    snprintf(buf, 9, "%08x", pgg_policy_version(policy));
+}
+
+/*
+ * Runs sql with the given arguments as the owner of the history table, which PUBLIC has no access
+ * to. Does nothing if the extension, or this version of it, isn't installed in the current database.
+ */
+static void
+history_execute(const char *sql, int nargs, Oid *argtypes, Datum *values, const char *nulls)
+{
+    Oid         extoid;
+    Oid         nspoid;
+    Oid         relid;
+    HeapTuple   tuple;
+    Oid         owner;
+    Oid         save_userid;
+    int         save_sec_context;
+    char       *query;
+
+    extoid = get_extension_oid("pg_passwordguard", true);
+    if (!OidIsValid(extoid))
+        return;
+    nspoid = get_extension_schema(extoid);
+    relid = get_relname_relid(HISTORY_TABLE, nspoid);
+    if (!OidIsValid(relid))
+        return;
+
+    tuple = SearchSysCache1(RELOID, ObjectIdGetDatum(relid));
+    if (!HeapTupleIsValid(tuple))
+        elog(ERROR, "cache lookup failed for relation %u", relid);
+    owner = ((Form_pg_class) GETSTRUCT(tuple))->relowner;
+    ReleaseSysCache(tuple);
+
+    query = psprintf(sql, quote_qualified_identifier(get_namespace_name(nspoid), HISTORY_TABLE));
+
+    /* An error aborts the transaction, which restores the user. */
+    GetUserIdAndSecContext(&save_userid, &save_sec_context);
+    SetUserIdAndSecContext(owner, save_sec_context | SECURITY_LOCAL_USERID_CHANGE |
+                           SECURITY_RESTRICTED_OPERATION);
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+    if (SPI_execute_with_args(query, nargs, argtypes, values, nulls, false, 0) < 0)
+        elog(ERROR, "SPI_execute_with_args failed: %s", query);
+    SPI_finish();
+
+    SetUserIdAndSecContext(save_userid, save_sec_context);
+    pfree(query);
+}
+
+static void
+history_record(Oid roleid)
+{
+    Oid         argtypes[3] = {OIDOID, TEXTOID, BOOLOID};
+    Datum       values[3];
+    char        nulls[3] = {' ', ' ', ' '};
+
+    values[0] = ObjectIdGetDatum(roleid);
+    if (pending_version[0] != '\0')
+    {
+        values[1] = CStringGetTextDatum(pending_version);
+        values[2] = BoolGetDatum(pending_compliant);
+    }
+    else
+    {
+        values[1] = values[2] = (Datum) 0;
+        nulls[1] = nulls[2] = 'n';
+    }
+    pending = false;
+
+    history_execute("INSERT INTO %s (roleid, policy_version, compliant) VALUES ($1, $2, $3)",
+                    3, argtypes, values, nulls);
+}
+
+static void
+history_forget(Oid roleid)
+{
+    Oid         argtypes[1] = {OIDOID};
+    Datum       values[1];
+
+    values[0] = ObjectIdGetDatum(roleid);
+    history_execute("DELETE FROM %s WHERE roleid OPERATOR(pg_catalog.=) $1", 1, argtypes, values, NULL);
+}
+
+static void
+history_object_access(ObjectAccessType access, Oid classId, Oid objectId, int subId, void *arg)
+{
+    if (prev_object_access_hook)
+        prev_object_access_hook(access, classId, objectId, subId, arg);
+
+    if (classId != AuthIdRelationId || !IsTransactionState())
+        return;
+
+    if (pending && (access == OAT_POST_CREATE || access == OAT_POST_ALTER))
+        history_record(objectId);
+    else if (access == OAT_DROP)
+        history_forget(objectId);
+}
+
+/* A statement that failed after the check must not leave its verdict to the next one. */
+static void
+history_xact_callback(XactEvent event, void *arg)
+{
+    if (event == XACT_EVENT_ABORT || event == XACT_EVENT_PARALLEL_ABORT)
+        pending = false;
+}
+
+static void
+history_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+                         SubTransactionId parentSubid, void *arg)
+{
+    if (event == SUBXACT_EVENT_ABORT_SUB)
+        pending = false;
+}
+
+/*
+ * pgg_history_init
+ *
+ * Called from _PG_init.
+ */
+void
+pgg_history_init(void)
+{
+    prev_object_access_hook = object_access_hook;
+    object_access_hook = history_object_access;
+
+    RegisterXactCallback(history_xact_callback, NULL);
+    RegisterSubXactCallback(history_subxact_callback, NULL);
+}
+
+/*
+ * pgg_history_remember
+ *
+ * Called once a password has been accepted under policy; the ALTER or CREATE ROLE that set it records
+ * the change. Also for the pre-hashed passwords of pg_passwordguard_rotate(), which the check hook
+ * can't see. policy is NULL for any other pre-hashed password: no policy checked it, and it is
+ * recorded as such rather than left to look approved by the role's previous row.
+ */
+void
+pgg_history_remember(const PggPolicy *policy, bool compliant)
+{
+    if (!pgg_track_policy_versions)
+        return;
+
+    if (policy == NULL)
+    {
+        /* The hook sees the passwords of pg_passwordguard_rotate() pre-hashed after it remembered them. */
+        if (pending)
+            return;
+        pending_version[0] = '\0';
+    }
+    else
+        format_policy_version(policy, pending_version);
+    pending_compliant = compliant;
+    pending = true;
+}
+
+/*
+ * pg_passwordguard_policy_version()
+ *
+ * The version hash of the enforced policy, to compare with policy_version in the table.
+ */
+Datum
+pg_passwordguard_policy_version(PG_FUNCTION_ARGS)
+{
+    char        buf[9];
+
+    format_policy_version(pgg_enforced_policy(), buf);
+    PG_RETURN_TEXT_P(cstring_to_text(buf));
+}
@@ -0,0 +1,110 @@
+/*
+ * login.c
+ *
+ * "Password expiring soon" notice at login: with pg_passwordguard.login_expiry_notice_days set, a
+ * session that logged in with a password due to expire (VALID UNTIL) within that many days gets a
+ * NOTICE saying when.
+ *
+ * This runs for every connection, so it must not read the catalogs. The check is made in
+ * ClientAuthentication_hook, right after the password was verified: that verification has just
+ * looked up the role's pg_authid row by name, so the same lookup here is answered from the backend's
+ * catalog cache (which invalidations keep current) and costs a hash probe. Only password methods
+ * (password, md5, scram-sha-256) are considered, since VALID UNTIL only applies to them.
+ *
+ * The server does not send notices to the client until authentication is over, so the notice is
+ * raised when the session's first statement is parsed.
+ *
+ * ClientAuthentication_hook is only called if the library is loaded before authentication, i.e.
+ * through shared_preload_libraries.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres.h"
+
+#include "catalog/pg_authid.h"
+#include "libpq/auth.h"
+#include "libpq/hba.h"
+#include "libpq/libpq-be.h"
+#include "miscadmin.h"
+#include "parser/analyze.h"
+#include "utils/builtins.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+
+#include "passwordguard.h"
+
+/* The expiry to announce at the first statement, if any. */
+static bool login_notice_pending = false;
+static TimestampTz login_valid_until;
+
+static ClientAuthentication_hook_type prev_client_auth_hook = NULL;
+static post_parse_analyze_hook_type prev_post_parse_analyze_hook = NULL;
+
+static void
+login_client_auth(Port *port, int status)
+{
+    HeapTuple   tuple;
+    Datum       datum;
+    bool        isnull;
+    TimestampTz valid_until;
+
+    if (prev_client_auth_hook)
+        prev_client_auth_hook(port, status);
+
+    if (status != STATUS_OK || pgg_login_expiry_notice_days <= 0)
+        return;
+    if (port->hba->auth_method != uaPassword && port->hba->auth_method != uaMD5 &&
+        port->hba->auth_method != uaSCRAM)
+        return;
+
+    /* In the catalog cache since the password was checked. */
+    tuple = SearchSysCache1(AUTHNAME, PointerGetDatum(port->user_name));
+    if (!HeapTupleIsValid(tuple))
+        return;
+    datum = SysCacheGetAttr(AUTHNAME, tuple, Anum_pg_authid_rolvaliduntil, &isnull);
+    valid_until = isnull ? DT_NOEND : DatumGetTimestampTz(datum);
+    ReleaseSysCache(tuple);
+
+    if (TIMESTAMP_NOT_FINITE(valid_until) ||
+        valid_until - GetCurrentTimestamp() > (TimestampTz) pgg_login_expiry_notice_days * USECS_PER_DAY)
+        return;
+
+    login_valid_until = valid_until;
+    login_notice_pending = true;
+}
+
+static void
+login_post_parse_analyze(ParseState *pstate, Query *query, JumbleState *jstate)
+{
+    if (prev_post_parse_analyze_hook)
+        prev_post_parse_analyze_hook(pstate, query, jstate);
+
+    if (login_notice_pending)
+    {
+        int         days;
+
+        login_notice_pending = false;
+        days = (int) ((login_valid_until - GetCurrentTimestamp()) / USECS_PER_DAY);
+
+        ereport(NOTICE,
+                (errmsg_plural("your password expires in %d day, at %s",
+                               "your password expires in %d days, at %s",
+                               days, days, timestamptz_to_str(login_valid_until)),
+                 errhint("Change it with ALTER ROLE ... PASSWORD, or \\password in psql.")));
+    }
+}
+
+/*
+ * pgg_login_init
+ *
+ * Called from _PG_init.
+ */
+void
+pgg_login_init(void)
+{
+    prev_client_auth_hook = ClientAuthentication_hook;
+    ClientAuthentication_hook = login_client_auth;
+    prev_post_parse_analyze_hook = post_parse_analyze_hook;
+    post_parse_analyze_hook = login_post_parse_analyze;
+}
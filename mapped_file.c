@@ -0,0 +1,118 @@
+/*
+ * mapped_file.c
+ *
+ * Read-only memory mapping of the model/dictionary files used by pg_passwordguard rules.
+ *
+ * Files are mapped with MAP_SHARED, so every backend using the same file shares one copy of it in
+ * the OS page cache; nothing is read or parsed up front. Relative paths are taken relative to the
+ * data directory, like other server-side file settings.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef FRONTEND
+#include "storage/fd.h"
+#endif
+
+#include "passwordguard.h"
+
+/*
+ * pgg_map_file
+ *
+ * Maps the whole file read-only. "what" names the file in error messages (e.g. "Markov model").
+ */
+void
+pgg_map_file(const char *path, const char *what, PggMappedFile *file)
+{
+    struct stat st;
+    void       *addr;
+    int         fd;
+
+    fd = OpenTransientFile(path, O_RDONLY | PG_BINARY);
+    if (fd < 0)
+        ereport(ERROR,
+                (errcode_for_file_access(),
+                 errmsg("pg_passwordguard: could not open %s file \"%s\": %m", what, path)));
+
+    if (fstat(fd, &st) < 0)
+    {
+        int         save_errno = errno;
+
+        CloseTransientFile(fd);
+        errno = save_errno;
+        ereport(ERROR,
+                (errcode_for_file_access(),
+                 errmsg("pg_passwordguard: could not stat %s file \"%s\": %m", what, path)));
+    }
+
+    if (st.st_size == 0)
+    {
+        CloseTransientFile(fd);
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: %s file \"%s\" is empty", what, path)));
+    }
+
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        int         save_errno = errno;
+
+        CloseTransientFile(fd);
+        errno = save_errno;
+        ereport(ERROR,
+                (errcode_for_file_access(),
+                 errmsg("pg_passwordguard: could not map %s file \"%s\": %m", what, path)));
+    }
+
+    /* The mapping stays valid after the descriptor is closed. */
+    CloseTransientFile(fd);
+
+    file->data = (const char *) addr;
+    file->size = (Size) st.st_size;
+}
+
+/* pgg_unmap_file, release a mapping made by pgg_map_file (no-op if nothing is mapped). */
+void
+pgg_unmap_file(PggMappedFile *file)
+{
+    if (file->data != NULL)
+        munmap((void *) file->data, file->size);
+    file->data = NULL;
+    file->size = 0;
+}
+
+/*
+ * pgg_check_file_header
+ *
+ * Validates the common header every pg_passwordguard data file starts with: an 8-byte magic string
+ * followed by PGG_BYTE_ORDER_MARK written in the byte order of the machine that built it.
+ */
+void
+pgg_check_file_header(const PggMappedFile *file, const char *path, const char *what,
+                      const char *magic, Size header_size)
+{
+    uint32      byte_order;
+
+    if (file->size < header_size || memcmp(file->data, magic, PGG_MAGIC_LEN) != 0)
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: \"%s\" is not a valid %s file", path, what)));
+
+    memcpy(&byte_order, file->data + PGG_MAGIC_LEN, sizeof(uint32));
+    if (byte_order != PGG_BYTE_ORDER_MARK)
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: %s file \"%s\" was built for a different byte order", what, path)));
+}
@@ -0,0 +1,174 @@
+/*
+ * markov.c
+ *
+ * Character n-gram (Markov) scorer for pg_passwordguard.min_markov_bits.
+ *
+ * The model is trained offline (tools/train_markov.pl) and stored as a dense table of quantized
+ * costs, -log2 P(symbol | previous order-1 symbols) in 1/scale bit units, one uint8 or uint16 per
+ * entry. The file is memory-mapped, so all backends share it through the page cache, and scoring a
+ * password is one table lookup per character.
+ *
+ * File layout (native byte order, see PggMarkovHeader):
+ *   header                     magic "PGGMKV01", byte order mark, order, symbol count, ...
+ *   symbol_map[256]            byte -> symbol; symbol 0 marks the start/end of the password
+ *   costs[nsymbols ^ order]    indexed by the symbols of the n-gram, oldest first
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#ifndef FRONTEND
+#include "utils/memutils.h"
+#endif
+
+#include "passwordguard.h"
+
+#define MARKOV_MAGIC        "PGGMKV01"
+#define MARKOV_MAX_ORDER    6
+
+typedef struct PggMarkovHeader
+{
+    char        magic[PGG_MAGIC_LEN];
+    uint32      byte_order;
+    uint32      order;          /* n of the n-gram, 2..MARKOV_MAX_ORDER */
+    uint32      nsymbols;       /* alphabet size including the boundary symbol */
+    uint32      cost_bytes;     /* 1 (uint8 costs) or 2 (uint16 costs) */
+    uint32      scale;          /* cost units per bit */
+    uint32      reserved;
+    uint8       symbol_map[256];
+} PggMarkovHeader;
+
+/* Currently mapped model, and the setting it was loaded from. */
+static PggMappedFile markov_file = {NULL, 0};
+static char *markov_loaded_path = NULL;
+static const PggMarkovHeader *markov_header = NULL;
+static const void *markov_costs = NULL;
+static uint32 markov_contexts = 0;  /* nsymbols ^ (order - 1) */
+
+/* Map and validate the model file at path, replacing any previously loaded model. */
+static void
+markov_load(const char *path)
+{
+    const PggMarkovHeader *hdr;
+    uint64      entries = 1;
+    uint32      i;
+
+    pgg_unmap_file(&markov_file);
+    markov_header = NULL;
+    if (markov_loaded_path)
+    {
+        pfree(markov_loaded_path);
+        markov_loaded_path = NULL;
+    }
+
+    pgg_map_file(path, "Markov model", &markov_file);
+    pgg_check_file_header(&markov_file, path, "Markov model", MARKOV_MAGIC, sizeof(PggMarkovHeader));
+
+    hdr = (const PggMarkovHeader *) markov_file.data;
+    if (hdr->order < 2 || hdr->order > MARKOV_MAX_ORDER ||
+        hdr->nsymbols < 2 || hdr->nsymbols > 256 ||
+        (hdr->cost_bytes != 1 && hdr->cost_bytes != 2) || hdr->scale == 0)
+    {
+        pgg_unmap_file(&markov_file);
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: invalid Markov model file \"%s\"", path),
+                 errdetail("Unsupported order, alphabet size, cost width or scale.")));
+    }
+
+    for (i = 0; i < hdr->order; i++)
+        entries *= hdr->nsymbols;
+
+    /* n-gram indexes are computed in 32 bits */
+    if (entries > PG_INT32_MAX || markov_file.size != sizeof(PggMarkovHeader) + entries * hdr->cost_bytes)
+    {
+        pgg_unmap_file(&markov_file);
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: invalid Markov model file \"%s\"", path),
+                 errdetail("Expected %llu cost entries.", (unsigned long long) entries)));
+    }
+
+    for (i = 0; i < 256; i++)
+    {
+        /* only the NUL byte may map to the boundary symbol */
+        if (hdr->symbol_map[i] >= hdr->nsymbols || (i > 0 && hdr->symbol_map[i] == 0))
+        {
+            pgg_unmap_file(&markov_file);
+            ereport(ERROR,
+                    (errcode(ERRCODE_DATA_CORRUPTED),
+                     errmsg("pg_passwordguard: invalid Markov model file \"%s\"", path),
+                     errdetail("Symbol map entry %u is out of range.", i)));
+        }
+    }
+
+    markov_header = hdr;
+    markov_costs = markov_file.data + sizeof(PggMarkovHeader);
+    markov_contexts = (uint32) (entries / hdr->nsymbols);
+    markov_loaded_path = MemoryContextStrdup(TopMemoryContext, path);
+}
+
+/*
+ * pgg_markov_bits
+ *
+ * Returns -log2 of the probability of the password under the model at model_path, i.e. roughly
+ * how many bits of guessing work the model needs for it. The model is (re)mapped on first use and
+ * whenever the path changes.
+ */
+double
+pgg_markov_bits(const char *model_path, const char *password, size_t len)
+{
+    const uint8 *map;
+    uint32      nsym;
+    uint32      ctx = 0;        /* all-boundary context before the first character */
+    uint64      total = 0;
+    size_t      i;
+
+    if (markov_loaded_path == NULL || strcmp(markov_loaded_path, model_path) != 0)
+        markov_load(model_path);
+
+    map = markov_header->symbol_map;
+    nsym = markov_header->nsymbols;
+
+    /* Score each character, then the end-of-password transition (symbol 0). */
+    if (markov_header->cost_bytes == 1)
+    {
+        const uint8 *costs = (const uint8 *) markov_costs;
+
+        for (i = 0; i < len; i++)
+        {
+            uint32      idx = ctx * nsym + map[(unsigned char) password[i]];
+
+            total += costs[idx];
+            ctx = idx % markov_contexts;
+        }
+        total += costs[ctx * nsym];
+    }
+    else
+    {
+        const uint16 *costs = (const uint16 *) markov_costs;
+
+        for (i = 0; i < len; i++)
+        {
+            uint32      idx = ctx * nsym + map[(unsigned char) password[i]];
+
+            total += costs[idx];
+            ctx = idx % markov_contexts;
+        }
+        total += costs[ctx * nsym];
+    }
+
+    return (double) total / markov_header->scale;
+}
+
+/* pgg_markov_model_size, size of the currently loaded model file (0 if none), to tie companion tables to it. */
+Size
+pgg_markov_model_size(void)
+{
+    return markov_file.size;
+}
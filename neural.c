@@ -0,0 +1,337 @@
+/*
+ * neural.c
+ *
+ * Small int8-quantized character CNN for pg_passwordguard.max_neural_score.
+ *
+ * The network is deliberately tiny so it runs on CPU-only database hosts in a few tens of
+ * microseconds:
+ *
+ *   bytes -> symbols -> int8 embeddings (D per symbol)
+ *         -> 1-D convolution, F filters of width K, int8 weights, int32 accumulation, ReLU
+ *         -> max-pool over positions -> dense layer (F -> 1) -> sigmoid
+ *
+ * The output is the model's probability that the password is weak (e.g. appears in leaked
+ * corpora). The convolution is a series of int8 dot products over contiguous memory: the
+ * embeddings of the padded password are laid out row after row, so the window at position t is
+ * simply K*D consecutive bytes. Dot products use AVX2 when the CPU has it, SSE2 otherwise on
+ * x86-64, and plain C elsewhere.
+ *
+ * Training happens offline; tools/export_neural_model.pl quantizes the weights into the format
+ * below. The file is memory-mapped and shared by all backends.
+ *
+ * File layout (native byte order, see PggNeuralHeader). Every section starts at a 16-byte aligned
+ * offset and row_len is a multiple of 32, zero-padded, so kernels never need a scalar tail:
+ *   header                         magic "PGGNN001", byte order mark, dimensions, symbol map
+ *   int8  embedding[nsymbols][embed_dim]
+ *   int8  conv_weight[filters][row_len]    (row = kernel * embed_dim weights, then zeros)
+ *   float conv_scale[filters]              int32 accumulator -> float
+ *   float conv_bias[filters]
+ *   float dense_weight[filters]
+ *   float dense_bias
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#include <math.h>
+
+#include "portability/instr_time.h"
+#ifndef FRONTEND
+#include "utils/memutils.h"
+#endif
+
+#include "passwordguard.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define NEURAL_USE_X86 1
+#endif
+
+#define NEURAL_MAGIC        "PGGNN001"
+
+/* Limits that bound the stack buffers used during inference. */
+#define NEURAL_MAX_CHARS    128     /* longer passwords are truncated */
+#define NEURAL_MAX_DIM      64
+#define NEURAL_MAX_KERNEL   9
+#define NEURAL_MAX_FILTERS  256
+#define NEURAL_ROW_ALIGN    32
+
+/* The time budget is checked after this many positions. */
+#define NEURAL_CHECK_EVERY  8
+
+typedef struct PggNeuralHeader
+{
+    char        magic[PGG_MAGIC_LEN];
+    uint32      byte_order;
+    uint32      nsymbols;
+    uint32      embed_dim;
+    uint32      kernel;
+    uint32      filters;
+    uint32      row_len;
+    uint32      reserved[4];
+    uint8       symbol_map[256];    /* symbol 0 is padding */
+} PggNeuralHeader;
+
+typedef int32 (*neural_dot_fn) (const int8 *a, const int8 *b, int len);
+
+static PggMappedFile neural_file = {NULL, 0};
+static char *neural_loaded_path = NULL;
+static const PggNeuralHeader *neural_header = NULL;
+static const int8 *neural_embedding = NULL;
+static const int8 *neural_conv_weight = NULL;
+static const float *neural_conv_scale = NULL;
+static const float *neural_conv_bias = NULL;
+static const float *neural_dense_weight = NULL;
+static const float *neural_dense_bias = NULL;
+static neural_dot_fn neural_dot = NULL;
+
+#ifdef NEURAL_USE_X86
+/* SSE2: sign-extend 8 bytes at a time to int16 and multiply-add pairs into int32. */
+static int32
+neural_dot_sse2(const int8 *a, const int8 *b, int len)
+{
+    __m128i     acc = _mm_setzero_si128();
+    int         i;
+
+    for (i = 0; i < len; i += 16)
+    {
+        __m128i     va = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i     vb = _mm_loadu_si128((const __m128i *) (b + i));
+        __m128i     a_lo = _mm_srai_epi16(_mm_unpacklo_epi8(va, va), 8);
+        __m128i     a_hi = _mm_srai_epi16(_mm_unpackhi_epi8(va, va), 8);
+        __m128i     b_lo = _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8);
+        __m128i     b_hi = _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8);
+
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(a_lo, b_lo));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(a_hi, b_hi));
+    }
+
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+}
+
+/* AVX2: same idea, 32 bytes per iteration. */
+__attribute__((target("avx2")))
+static int32
+neural_dot_avx2(const int8 *a, const int8 *b, int len)
+{
+    __m256i     acc = _mm256_setzero_si256();
+    __m128i     sum;
+    int         i;
+
+    for (i = 0; i < len; i += 32)
+    {
+        __m256i     a_lo = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (a + i)));
+        __m256i     a_hi = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (a + i + 16)));
+        __m256i     b_lo = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (b + i)));
+        __m256i     b_hi = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (b + i + 16)));
+
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(a_lo, b_lo));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(a_hi, b_hi));
+    }
+
+    sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+#else
+/* Portable int8 dot product. */
+static int32
+neural_dot_c(const int8 *a, const int8 *b, int len)
+{
+    int32       sum = 0;
+    int         i;
+
+    for (i = 0; i < len; i++)
+        sum += (int32) a[i] * b[i];
+    return sum;
+}
+#endif                          /* NEURAL_USE_X86 */
+
+static void
+neural_choose_kernel(void)
+{
+#ifdef NEURAL_USE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        neural_dot = neural_dot_avx2;
+    else
+        neural_dot = neural_dot_sse2;
+#else
+    neural_dot = neural_dot_c;
+#endif
+}
+
+static inline Size
+neural_align(Size offset)
+{
+    return TYPEALIGN(16, offset);
+}
+
+static void
+neural_load(const char *path)
+{
+    const PggNeuralHeader *hdr;
+    Size        offset;
+    int         i;
+
+    pgg_unmap_file(&neural_file);
+    neural_header = NULL;
+    if (neural_loaded_path)
+    {
+        pfree(neural_loaded_path);
+        neural_loaded_path = NULL;
+    }
+
+    pgg_map_file(path, "neural model", &neural_file);
+    pgg_check_file_header(&neural_file, path, "neural model", NEURAL_MAGIC, sizeof(PggNeuralHeader));
+
+    hdr = (const PggNeuralHeader *) neural_file.data;
+    if (hdr->nsymbols < 2 || hdr->nsymbols > 256 ||
+        hdr->embed_dim == 0 || hdr->embed_dim > NEURAL_MAX_DIM ||
+        hdr->kernel == 0 || hdr->kernel > NEURAL_MAX_KERNEL ||
+        hdr->filters == 0 || hdr->filters > NEURAL_MAX_FILTERS ||
+        hdr->row_len != TYPEALIGN(NEURAL_ROW_ALIGN, hdr->kernel * hdr->embed_dim))
+    {
+        pgg_unmap_file(&neural_file);
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: invalid neural model file \"%s\"", path),
+                 errdetail("Unsupported model dimensions.")));
+    }
+
+    for (i = 0; i < 256; i++)
+    {
+        if (hdr->symbol_map[i] >= hdr->nsymbols)
+        {
+            pgg_unmap_file(&neural_file);
+            ereport(ERROR,
+                    (errcode(ERRCODE_DATA_CORRUPTED),
+                     errmsg("pg_passwordguard: invalid neural model file \"%s\"", path),
+                     errdetail("Symbol map entry %d is out of range.", i)));
+        }
+    }
+
+    /* Lay out the sections exactly as the exporter writes them. */
+    offset = sizeof(PggNeuralHeader);
+    neural_embedding = (const int8 *) (neural_file.data + offset);
+    offset = neural_align(offset + hdr->nsymbols * hdr->embed_dim);
+    neural_conv_weight = (const int8 *) (neural_file.data + offset);
+    offset = neural_align(offset + (Size) hdr->filters * hdr->row_len);
+    neural_conv_scale = (const float *) (neural_file.data + offset);
+    offset = neural_align(offset + hdr->filters * sizeof(float));
+    neural_conv_bias = (const float *) (neural_file.data + offset);
+    offset = neural_align(offset + hdr->filters * sizeof(float));
+    neural_dense_weight = (const float *) (neural_file.data + offset);
+    offset = neural_align(offset + hdr->filters * sizeof(float));
+    neural_dense_bias = (const float *) (neural_file.data + offset);
+    offset += sizeof(float);
+
+    if (neural_file.size != offset)
+    {
+        pgg_unmap_file(&neural_file);
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: invalid neural model file \"%s\"", path),
+                 errdetail("File size does not match the model dimensions.")));
+    }
+
+    if (neural_dot == NULL)
+        neural_choose_kernel();
+
+    neural_header = hdr;
+    neural_loaded_path = MemoryContextStrdup(TopMemoryContext, path);
+}
+
+/*
+ * pgg_neural_score
+ *
+ * Returns the model's probability (0..1) that the password is weak. If inference takes longer than
+ * max_time_us microseconds it is abandoned and false is returned, so a slow host can never stall
+ * the DDL that is setting the password.
+ */
+bool
+pgg_neural_score(const char *model_path, const char *password, size_t len, int max_time_us,
+                 double *score)
+{
+    /* padded embedding rows, plus slack so the last window can be read as a whole row_len */
+    int8        rows[(NEURAL_MAX_CHARS + 2 * (NEURAL_MAX_KERNEL - 1)) * NEURAL_MAX_DIM + NEURAL_ROW_ALIGN];
+    float       pooled[NEURAL_MAX_FILTERS];
+    instr_time  start;
+    instr_time  now;
+    uint32      dim;
+    uint32      kernel;
+    uint32      filters;
+    uint32      row_len;
+    int         npositions;
+    int         nrows;
+    int         t;
+    uint32      f;
+    double      logit;
+
+    if (neural_loaded_path == NULL || strcmp(neural_loaded_path, model_path) != 0)
+        neural_load(model_path);
+
+    INSTR_TIME_SET_CURRENT(start);
+
+    dim = neural_header->embed_dim;
+    kernel = neural_header->kernel;
+    filters = neural_header->filters;
+    row_len = neural_header->row_len;
+
+    if (len > NEURAL_MAX_CHARS)
+        len = NEURAL_MAX_CHARS;
+
+    /* K-1 padding rows on each side, so every character is seen at every filter offset. */
+    nrows = (int) len + 2 * (kernel - 1);
+    for (t = 0; t < nrows; t++)
+    {
+        int         c = t - (int) (kernel - 1);
+        uint8       sym = (c >= 0 && c < (int) len) ?
+            neural_header->symbol_map[(unsigned char) password[c]] : 0;
+
+        memcpy(rows + t * dim, neural_embedding + sym * dim, dim);
+    }
+    memset(rows + nrows * dim, 0, NEURAL_ROW_ALIGN);
+
+    /* Convolution + ReLU + max-pool; starting from 0 applies the ReLU. */
+    for (f = 0; f < filters; f++)
+        pooled[f] = 0.0f;
+
+    npositions = nrows - (kernel - 1);
+    for (t = 0; t < npositions; t++)
+    {
+        const int8 *window = rows + t * dim;
+
+        for (f = 0; f < filters; f++)
+        {
+            int32       acc = neural_dot(window, neural_conv_weight + f * row_len, row_len);
+            float       v = acc * neural_conv_scale[f] + neural_conv_bias[f];
+
+            if (v > pooled[f])
+                pooled[f] = v;
+        }
+
+        if (max_time_us > 0 && (t + 1) % NEURAL_CHECK_EVERY == 0)
+        {
+            INSTR_TIME_SET_CURRENT(now);
+            INSTR_TIME_SUBTRACT(now, start);
+            if (INSTR_TIME_GET_MICROSEC(now) > (uint64) max_time_us)
+                return false;
+        }
+    }
+
+    logit = *neural_dense_bias;
+    for (f = 0; f < filters; f++)
+        logit += (double) pooled[f] * neural_dense_weight[f];
+
+    *score = 1.0 / (1.0 + exp(-logit));
+    return true;
+}
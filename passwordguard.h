@@ -0,0 +1,441 @@
+/*
+ * passwordguard.h
+ *
+ * Declarations shared between the pg_passwordguard source files.
+ *
+ * pg_passwordguard.c owns the GUCs and the check_password_hook; the other files
+ * implement individual rules and only expose small lookup/scoring functions here.
+ *
+ * Developed by: Kothari Nishchay
+ */
+#ifndef PASSWORDGUARD_H
+#define PASSWORDGUARD_H
+
+#include <ctype.h>
+
+#include "portability/instr_time.h"
+#ifndef FRONTEND
+#include "utils/guc.h"
+#endif
+
+#ifdef FRONTEND
+/*
+ * The policy core (policy.c, the rule and model files) is also compiled with FRONTEND into the client
+ * library, libpg_passwordguard.a. These stand in for the backend facilities it uses: an ERROR ends
+ * the current library call with its message (see frontend.c), warnings are dropped, there are no
+ * interrupts to service, and memory is plain malloc'd memory.
+ */
+#define WARNING         19
+#define ERROR           21
+
+#define ERRCODE_DATA_CORRUPTED              0
+#define ERRCODE_INVALID_PARAMETER_VALUE     0
+#define ERRCODE_OUT_OF_MEMORY               0
+
+#define ereport(elevel, ...) \
+    do { \
+        pgg_fe_report_start(elevel); \
+        __VA_ARGS__; \
+        pgg_fe_report_finish(elevel); \
+        if ((elevel) >= ERROR) \
+            pg_unreachable(); \
+    } while (0)
+
+extern void pgg_fe_report_start(int elevel);
+extern void pgg_fe_report_finish(int elevel);
+extern int  errcode(int sqlerrcode);
+extern int  errcode_for_file_access(void);
+extern int  errmsg(const char *fmt,...) pg_attribute_printf(1, 2);
+extern int  errdetail(const char *fmt,...) pg_attribute_printf(1, 2);
+
+#define CHECK_FOR_INTERRUPTS()              ((void) 0)
+#define MemoryContextAlloc(context, size)   palloc(size)
+#define MemoryContextStrdup(context, s)     pstrdup(s)
+#define OpenTransientFile(path, flags)      open(path, flags)
+#define CloseTransientFile(fd)              close(fd)
+
+/* As in utils/guc.h; the policy settings table refers to it. */
+struct config_enum_entry
+{
+    const char *name;
+    int         val;
+    bool        hidden;
+};
+#endif                          /* FRONTEND */
+
+/*
+ * Seeded 32-bit string hash (FNV-1a with a murmur3 finalizer).
+ *
+ * Used for the build-time generated tables, so it must stay in sync with
+ * gen_common_passwords.pl.
+ */
+static inline uint32
+pgg_hash32(const char *s, size_t len, uint32 seed)
+{
+    uint32      h = 0x811c9dc5 ^ (seed * 0x9e3779b9);
+    size_t      i;
+
+    for (i = 0; i < len; i++)
+    {
+        h ^= (unsigned char) s[i];
+        h *= 0x01000193;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+/*
+ * Data files (models, dictionaries) start with an 8-byte magic string followed by this mark written
+ * in the byte order of the machine that built them; the rest of the file is native byte order.
+ */
+#define PGG_MAGIC_LEN           8
+#define PGG_BYTE_ORDER_MARK     0x01020304
+
+/* Policy rules, in the order the hook evaluates them. */
+typedef enum PggRule
+{
+    PGG_RULE_MIN_LENGTH,
+    PGG_RULE_REQUIRE_UPPER,
+    PGG_RULE_REQUIRE_LOWER,
+    PGG_RULE_REQUIRE_DIGIT,
+    PGG_RULE_REQUIRE_SPECIAL,
+    PGG_RULE_REJECT_USERNAME,
+    PGG_RULE_REJECT_COMMON,
+    PGG_RULE_REJECT_ROLENAMES,
+    PGG_RULE_DATE_PATTERNS,
+    PGG_RULE_MARKOV,
+    PGG_RULE_GUESSES,
+    PGG_RULE_PCFG,
+    PGG_RULE_NEURAL,
+    PGG_RULE_REJECT_REUSE,
+    PGG_RULE_COMMON_FRACTION,
+    PGG_RULE_REJECT_DICTIONARY,
+    PGG_RULE_REJECT_CRACKLIB
+} PggRule;
+
+#define PGG_NUM_RULES           (PGG_RULE_REJECT_CRACKLIB + 1)
+
+typedef struct PggMappedFile
+{
+    const char *data;
+    Size        size;
+} PggMappedFile;
+
+/* mapped_file.c */
+extern void pgg_map_file(const char *path, const char *what, PggMappedFile *file);
+extern void pgg_unmap_file(PggMappedFile *file);
+extern void pgg_check_file_header(const PggMappedFile *file, const char *path, const char *what,
+                                  const char *magic, Size header_size);
+
+/* analysis.c */
+#define PGG_ANALYSIS_INLINE     64      /* longest password analyzed without allocating */
+
+typedef struct PggRun
+{
+    int         start;
+    int         len;
+} PggRun;
+
+typedef struct PggAnalysis
+{
+    int         nbytes;
+    bool        ascii;          /* no byte outside ASCII */
+    int         nupper;
+    int         nlower;
+    int         ndigit;
+    int         nspecial;
+    char       *folded;         /* lowercased, NUL-terminated */
+    PggRun     *digit_runs;     /* maximal runs of ASCII digits */
+    int         ndigit_runs;
+    void       *allocated;      /* for longer passwords, else NULL */
+    char        inline_text[PGG_ANALYSIS_INLINE + 1];
+    PggRun      inline_runs[(PGG_ANALYSIS_INLINE + 1) / 2];
+} PggAnalysis;
+
+/* How PggAnalysis.folded lowercases a byte: ASCII without the locale, other bytes with it. */
+static inline unsigned char
+pgg_fold_char(unsigned char c)
+{
+    if (c < 0x80)
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    return (unsigned char) tolower(c);
+}
+
+extern void pgg_analyze(const char *password, int len, PggAnalysis *analysis);
+extern void pgg_analysis_free(PggAnalysis *analysis);
+
+/* skeleton.c */
+extern char *pgg_skeleton(const char *str, int len, int *skeleton_len);
+
+/* common_passwords.c */
+extern bool pgg_is_common_password(const char *folded, size_t len);
+
+/* common_index.c */
+extern int  pgg_longest_common_password(const char *index_path, const char *folded, int len);
+
+/* dictionary.c */
+#define PGG_DICTIONARY_MAX_EDITS    2
+
+extern int  pgg_dictionary_distance(const char *dictionary_path, const char *folded, int len);
+
+/* cracklib.c */
+#define PGG_CRACKLIB_NONE       0
+#define PGG_CRACKLIB_WORD       1       /* based on a dictionary word */
+#define PGG_CRACKLIB_REVERSED   2       /* based on a reversed dictionary word */
+
+extern int  pgg_cracklib_match(const char *dictionary_path, const char *folded, int len);
+
+/* role_names.c */
+extern bool pgg_contains_other_role_name(const char *skeleton, size_t len,
+                                         const char *user_skeleton);
+
+/* date_patterns.c */
+#define PGG_DATE_YEAR           0x01    /* 1900-2099 */
+#define PGG_DATE_NUMERIC        0x02    /* MMDDYY, DDMMYYYY, YYYYMMDD, ... */
+#define PGG_DATE_SEPARATED      0x04    /* DD.MM.YYYY, MM/DD/YY, YYYY-MM-DD, ... */
+#define PGG_DATE_SEASON_YEAR    0x08    /* Summer2024, winter_24, ... */
+
+typedef struct PggDateScan
+{
+    uint32      kinds;          /* PGG_DATE_* bits found */
+    int         covered;        /* bytes of the password inside a date pattern */
+} PggDateScan;
+
+extern void pgg_scan_dates(const char *password, const PggAnalysis *analysis, PggDateScan *result);
+
+/* markov.c */
+extern double pgg_markov_bits(const char *model_path, const char *password, size_t len);
+extern Size pgg_markov_model_size(void);
+
+/* guess_numbers.c */
+extern double pgg_guess_log10(const char *table_path, Size model_size, double bits);
+
+/* pcfg.c */
+extern double pgg_pcfg_bits(const char *model_path, const char *password, size_t len);
+
+/* neural.c */
+extern bool pgg_neural_score(const char *model_path, const char *password, size_t len,
+                             int max_time_us, double *score);
+
+/* policy.c */
+#define PGG_RULE_BIT(rule)      (UINT32_C(1) << (rule))
+
+/* How embedded dates and years are treated (date_patterns). */
+typedef enum PggDatePatternsMode
+{
+    PGG_DATE_PATTERNS_OFF,
+    PGG_DATE_PATTERNS_DISCOUNT, /* date characters count less toward min_length */
+    PGG_DATE_PATTERNS_REJECT    /* any date or year rejects the password */
+} PggDatePatternsMode;
+
+/* The rule settings of one policy (the enforced one, the shadow one, or a simulated one). */
+typedef struct PggPolicy
+{
+    int         min_length;
+    bool        require_upper;
+    bool        require_lower;
+    bool        require_digit;
+    bool        require_special;
+    bool        reject_username;
+    bool        reject_common;
+    bool        reject_rolenames;
+    int         date_patterns;          /* PggDatePatternsMode */
+    double      date_char_weight;
+    int         min_markov_bits;
+    double      min_guesses_log10;
+    int         min_pcfg_bits;
+    double      max_neural_score;
+    bool        reject_reuse;
+    double      max_common_fraction;
+    bool        reject_dictionary;
+    int         dictionary_edits;
+    bool        reject_cracklib;
+} PggPolicy;
+
+typedef enum PggSettingType
+{
+    PGG_SETTING_BOOL,
+    PGG_SETTING_INT,
+    PGG_SETTING_REAL,
+    PGG_SETTING_ENUM
+} PggSettingType;
+
+/* Describes one PggPolicy field; used to define its GUCs and to read policies from JSON. */
+typedef struct PggPolicySetting
+{
+    const char *name;               /* GUC name without the "pg_passwordguard." prefix */
+    const char *short_desc;
+    const char *long_desc;
+    PggSettingType type;
+    Size        offset;             /* of the field in PggPolicy */
+    double      boot_value;
+    double      min_value;
+    double      max_value;
+    const struct config_enum_entry *options;    /* PGG_SETTING_ENUM only */
+} PggPolicySetting;
+
+/*
+ * One password being checked. The analysis stages run lazily, the first time a policy needs them,
+ * and their results are kept here so that every policy evaluated for the password shares them.
+ */
+typedef struct PggCheck
+{
+    const char *password;
+    int         len;
+    const char *username;
+
+    /* server-wide settings: model files and time limits */
+    const char *markov_model;
+    const char *guess_table;
+    const char *pcfg_model;
+    const char *neural_model;
+    const char *common_index;
+    const char *dictionary;
+    const char *cracklib_dictionary;    /* path without .pwd/.pwi */
+    int         neural_time_budget;     /* microseconds, 0 = none */
+    int         max_check_time_ms;      /* 0 = none */
+    instr_time  start;
+    bool        budget_exhausted;
+
+    /* PGG_STAGE_* bits: results available, model not configured, skipped for time */
+    uint32      done;
+    uint32      unavailable;
+    uint32      skipped;
+
+    PggAnalysis analysis;       /* read by every cheap stage; freed by pgg_check_end() */
+
+    /*
+     * Skeletons for the name rules (skeleton.c). An ASCII password's is analysis.folded and an
+     * ASCII username's is folded into user_folded; only others are allocated.
+     */
+    const char *skeleton;
+    int         skeleton_len;
+    const char *user_skeleton;  /* NULL without a username */
+    char       *skeleton_allocated;
+    char       *user_skeleton_allocated;
+    char        user_folded[NAMEDATALEN];
+
+    bool        contains_username;
+    bool        is_common;
+    bool        contains_rolename;
+    PggDateScan dates;
+    double      markov_bits;
+    double      guesses_log10;
+    double      pcfg_bits;
+    double      neural_score;
+    bool        is_reused;
+    int         common_len;     /* bytes of the longest common password contained */
+    int         dictionary_distance;    /* edits to the nearest dictionary word, or -1 */
+    int         cracklib_match;         /* PGG_CRACKLIB_* */
+} PggCheck;
+
+/* Outcome of evaluating one policy: PGG_RULE_BIT() masks. */
+typedef struct PggVerdict
+{
+    uint32      violated;
+    uint32      skipped;
+} PggVerdict;
+
+extern const char *const pgg_rule_names[PGG_NUM_RULES];
+extern const PggPolicySetting pgg_policy_settings[];
+extern const int pgg_num_policy_settings;
+
+extern void pgg_policy_set_defaults(PggPolicy *policy);
+extern uint32 pgg_policy_version(const PggPolicy *policy);
+extern const char *pgg_policy_missing_model(const PggPolicy *policy, const PggCheck *settings);
+extern void pgg_policy_evaluate(const PggPolicy *policy, PggCheck *check, bool stop_at_first,
+                                PggVerdict *verdict);
+extern void pgg_policy_report(const PggPolicy *policy, const PggCheck *check,
+                              const PggVerdict *verdict, bool log_only);
+extern void pgg_check_end(PggCheck *check);
+
+/* Exported policies (pg_passwordguard_policy_export(), read by the client library). */
+#define PGG_POLICY_EXPORT_MAGIC     "PGGPOLCY"
+#define PGG_POLICY_EXPORT_MAX_SIZE  1024
+
+extern Size pgg_policy_export(const PggPolicy *policy, char *buf);
+extern void pgg_policy_import(const char *data, Size size, PggPolicy *policy);
+
+/* generate.c */
+#define PGG_GENERATE_MAX_LENGTH     1024
+
+typedef struct PggGenerator
+{
+    const PggPolicy *policy;
+    int         len;
+    int         nrequired;
+    const char *required[4];    /* characters of each class the policy requires */
+} PggGenerator;
+
+extern void pgg_generator_init(PggGenerator *gen, const PggPolicy *policy, int len);
+extern void pgg_generate_password(const PggGenerator *gen, char *password);
+extern void pgg_generator_end(void);
+
+#ifndef FRONTEND
+
+/* pg_passwordguard.c */
+extern int  pgg_rotate_workers;
+extern char *pgg_event_log;
+extern int  pgg_event_log_rotation_size;
+extern int  pgg_event_queue_size;
+extern int  pgg_log_only_max_warnings;
+extern int  pgg_log_only_summary_interval;
+extern bool pgg_track_policy_versions;
+extern char *pgg_expiry_database;
+extern char *pgg_expiry_notice_days;
+extern int  pgg_expiry_max_roles;
+extern int  pgg_login_expiry_notice_days;
+extern int  pgg_reuse_max_roles;
+extern char *pgg_reuse_key_file;
+
+extern const PggPolicy *pgg_enforced_policy(void);
+extern void pgg_check_init(PggCheck *check, const char *password, int len, const char *username);
+
+/* stats.c */
+typedef enum PggPolicyKind
+{
+    PGG_POLICY_ENFORCED,
+    PGG_POLICY_SHADOW
+} PggPolicyKind;
+
+#define PGG_NUM_POLICY_KINDS    (PGG_POLICY_SHADOW + 1)
+
+extern void pgg_stats_init(void);
+extern void pgg_stats_count(PggPolicyKind kind, const PggVerdict *verdict);
+
+/* eventlog.c */
+extern void pgg_eventlog_init(void);
+extern bool pgg_eventlog_enabled(void);
+extern void pgg_eventlog_add(PggPolicyKind kind, const char *role, const PggPolicy *policy,
+                             const PggVerdict *verdict, bool rejected);
+
+/* warnings.c */
+extern void pgg_warnings_init(void);
+extern bool pgg_warning_allowed(const char *role, PggRule rule);
+extern void pgg_warnings_summarize(void);
+
+/* history.c */
+extern void pgg_history_init(void);
+extern void pgg_history_remember(const PggPolicy *policy, bool compliant);
+
+/* expiry.c */
+extern void pgg_expiry_init(void);
+extern bool pgg_expiry_days_check(char **newval, void **extra, GucSource source);
+extern void pgg_expiry_days_assign(const char *newval, void *extra);
+
+/* login.c */
+extern void pgg_login_init(void);
+
+/* reuse.c */
+extern void pgg_reuse_init(void);
+extern bool pgg_reuse_enabled(void);
+extern bool pgg_password_reused(const char *password, size_t len, const char *username);
+extern void pgg_reuse_remember(const char *password, size_t len);
+
+#endif                          /* !FRONTEND */
+
+#endif                          /* PASSWORDGUARD_H */
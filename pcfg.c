@@ -0,0 +1,210 @@
+/*
+ * pcfg.c
+ *
+ * Probabilistic context-free grammar (PCFG) scorer for pg_passwordguard.min_pcfg_bits.
+ *
+ * Following Weir et al., a password is split into maximal runs of letters (L), digits (D) and
+ * other characters (S); "Summer2024!" has structure L6D4S1 and terminals "summer", "2024", "!".
+ * Its probability is P(structure) times P(terminal | segment type and length) for each segment.
+ * This catches passwords whose content looks random but whose shape is common.
+ *
+ * The grammar is trained offline (tools/train_pcfg.pl). Structures and terminals are stored only as
+ * 64-bit hashes in one open-addressing table, with quantized costs (-log2 p in 1/scale bit units),
+ * inside a memory-mapped file. Scoring splits the password on the stack and does one table lookup
+ * per segment plus one for the structure, with no parsing or allocation per check.
+ *
+ * File layout (native byte order, see PggPcfgHeader):
+ *   header                     magic "PGGPCFG1", byte order mark, slot count, costs for unseen items
+ *   slots[nslots]              PggPcfgEntry; nslots is a power of two
+ *
+ * Keys are hashed with pgg_hash32() (two seeds) over a one-byte kind ('#' for a structure, or
+ * 'L', 'D', 'S' for a terminal) followed by the structure string or the lowercased terminal.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#ifndef FRONTEND
+#include "utils/memutils.h"
+#endif
+
+#include "passwordguard.h"
+
+#define PCFG_MAGIC          "PGGPCFG1"
+#define PCFG_SEED_SLOT      0x50434647
+#define PCFG_SEED_CHECK     0x7063666b
+#define PCFG_EMPTY          PG_UINT32_MAX
+
+/* Passwords with more segments, or longer segments, are scored as unseen beyond these limits. */
+#define PCFG_MAX_SEGMENTS   32
+#define PCFG_MAX_TERMINAL   64
+
+typedef enum
+{
+    SEG_LETTER,
+    SEG_DIGIT,
+    SEG_SYMBOL
+} PcfgSegmentType;
+
+static const char pcfg_type_char[] = {'L', 'D', 'S'};
+
+typedef struct PggPcfgHeader
+{
+    char        magic[PGG_MAGIC_LEN];
+    uint32      byte_order;
+    uint32      nslots;
+    uint32      scale;              /* cost units per bit */
+    uint32      unseen_structure;   /* cost of a structure not in the table */
+    uint32      unseen_char[3];     /* per-character cost of an unseen L, D, S terminal */
+    uint32      reserved;
+} PggPcfgHeader;
+
+typedef struct PggPcfgEntry
+{
+    uint32      slot_hash;      /* pgg_hash32(key, PCFG_SEED_SLOT) */
+    uint32      check_hash;     /* pgg_hash32(key, PCFG_SEED_CHECK) */
+    uint32      cost;           /* PCFG_EMPTY for an unused slot */
+} PggPcfgEntry;
+
+static PggMappedFile pcfg_file = {NULL, 0};
+static char *pcfg_loaded_path = NULL;
+static const PggPcfgHeader *pcfg_header = NULL;
+static const PggPcfgEntry *pcfg_slots = NULL;
+
+static void
+pcfg_load(const char *path)
+{
+    const PggPcfgHeader *hdr;
+
+    pgg_unmap_file(&pcfg_file);
+    pcfg_header = NULL;
+    if (pcfg_loaded_path)
+    {
+        pfree(pcfg_loaded_path);
+        pcfg_loaded_path = NULL;
+    }
+
+    pgg_map_file(path, "PCFG model", &pcfg_file);
+    pgg_check_file_header(&pcfg_file, path, "PCFG model", PCFG_MAGIC, sizeof(PggPcfgHeader));
+
+    hdr = (const PggPcfgHeader *) pcfg_file.data;
+    if (hdr->nslots == 0 || (hdr->nslots & (hdr->nslots - 1)) != 0 || hdr->scale == 0 ||
+        pcfg_file.size != sizeof(PggPcfgHeader) + (Size) hdr->nslots * sizeof(PggPcfgEntry))
+    {
+        pgg_unmap_file(&pcfg_file);
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("pg_passwordguard: invalid PCFG model file \"%s\"", path)));
+    }
+
+    pcfg_header = hdr;
+    pcfg_slots = (const PggPcfgEntry *) (pcfg_file.data + sizeof(PggPcfgHeader));
+    pcfg_loaded_path = MemoryContextStrdup(TopMemoryContext, path);
+}
+
+/* Cost of key, or PCFG_EMPTY if the table does not contain it. */
+static uint32
+pcfg_lookup(const char *key, size_t keylen)
+{
+    uint32      mask = pcfg_header->nslots - 1;
+    uint32      slot_hash = pgg_hash32(key, keylen, PCFG_SEED_SLOT);
+    uint32      check_hash = pgg_hash32(key, keylen, PCFG_SEED_CHECK);
+    uint32      slot = slot_hash & mask;
+    uint32      probes;
+
+    /* The builder keeps the table at most half full, so probe sequences are short. */
+    for (probes = 0; probes <= mask; probes++)
+    {
+        const PggPcfgEntry *e = &pcfg_slots[slot];
+
+        if (e->cost == PCFG_EMPTY)
+            return PCFG_EMPTY;
+        if (e->slot_hash == slot_hash && e->check_hash == check_hash)
+            return e->cost;
+        slot = (slot + 1) & mask;
+    }
+    return PCFG_EMPTY;
+}
+
+static inline PcfgSegmentType
+pcfg_char_type(unsigned char c)
+{
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'z')
+        return SEG_LETTER;
+    if (c >= '0' && c <= '9')
+        return SEG_DIGIT;
+    return SEG_SYMBOL;
+}
+
+/*
+ * pgg_pcfg_bits
+ *
+ * Returns -log2 of the probability of the password under the PCFG model at model_path.
+ */
+double
+pgg_pcfg_bits(const char *model_path, const char *password, size_t len)
+{
+    char        structure[1 + PCFG_MAX_SEGMENTS * 4];
+    char        terminal[1 + PCFG_MAX_TERMINAL];
+    int         structure_len = 1;
+    int         nsegments = 0;
+    uint64      total = 0;
+    uint32      cost;
+    size_t      i = 0;
+
+    if (pcfg_loaded_path == NULL || strcmp(pcfg_loaded_path, model_path) != 0)
+        pcfg_load(model_path);
+
+    structure[0] = '#';
+
+    while (i < len)
+    {
+        PcfgSegmentType type = pcfg_char_type((unsigned char) password[i]);
+        size_t      start = i;
+        size_t      seglen;
+
+        while (i < len && pcfg_char_type((unsigned char) password[i]) == type)
+            i++;
+        seglen = i - start;
+
+        /* Append e.g. "L6" to the structure string. */
+        if (++nsegments <= PCFG_MAX_SEGMENTS && seglen < 1000)
+        {
+            structure[structure_len++] = pcfg_type_char[type];
+            if (seglen >= 100)
+                structure[structure_len++] = (char) ('0' + seglen / 100);
+            if (seglen >= 10)
+                structure[structure_len++] = (char) ('0' + seglen / 10 % 10);
+            structure[structure_len++] = (char) ('0' + seglen % 10);
+        }
+        else
+            nsegments = PCFG_MAX_SEGMENTS + 1;  /* structure can't be in the table */
+
+        /* Terminal probability, given its type and length. */
+        cost = PCFG_EMPTY;
+        if (seglen <= PCFG_MAX_TERMINAL)
+        {
+            size_t      j;
+
+            terminal[0] = pcfg_type_char[type];
+            for (j = 0; j < seglen; j++)
+            {
+                unsigned char c = (unsigned char) password[start + j];
+
+                terminal[1 + j] = (type == SEG_LETTER) ? (char) (c | 0x20) : (char) c;
+            }
+            cost = pcfg_lookup(terminal, 1 + seglen);
+        }
+        total += (cost != PCFG_EMPTY) ? cost : (uint64) seglen * pcfg_header->unseen_char[type];
+    }
+
+    cost = (nsegments <= PCFG_MAX_SEGMENTS) ? pcfg_lookup(structure, structure_len) : PCFG_EMPTY;
+    total += (cost != PCFG_EMPTY) ? cost : pcfg_header->unseen_structure;
+
+    return (double) total / pcfg_header->scale;
+}
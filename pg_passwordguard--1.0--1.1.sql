@@ -0,0 +1,202 @@
+-- pg_passwordguard--1.0--1.1.sql
+-- Adds the statistics views, the policy simulation function, the password generator, the
+-- password rotation function, the policy-version tracking table and the expiry queue (below).
+-- Statistics views:
+--   pg_passwordguard_stats         per policy (enforced, shadow) and rule: violations, and the number
+--                                  of times the rule was skipped because max_check_time_ms ran out
+--   pg_passwordguard_policy_stats  per policy: checks, and checks with at least one violation
+--
+-- The counters live in shared memory, so the library must be in shared_preload_libraries.
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_passwordguard UPDATE TO '1.1'" to load this file. \quit
+
+CREATE FUNCTION pg_passwordguard_stats(
+    OUT policy text,
+    OUT rule text,
+    OUT violations bigint,
+    OUT skipped bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_passwordguard_stats'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+
+CREATE VIEW pg_passwordguard_stats AS
+    SELECT * FROM pg_passwordguard_stats();
+
+CREATE FUNCTION pg_passwordguard_policy_stats(
+    OUT policy text,
+    OUT checks bigint,
+    OUT failed bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_passwordguard_policy_stats'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+
+CREATE VIEW pg_passwordguard_policy_stats AS
+    SELECT * FROM pg_passwordguard_policy_stats();
+
+CREATE FUNCTION pg_passwordguard_stats_reset()
+RETURNS void
+AS 'MODULE_PATHNAME', 'pg_passwordguard_stats_reset'
+LANGUAGE C STRICT VOLATILE PARALLEL RESTRICTED;
+
+-- Only superusers may reset the counters unless granted.
+REVOKE ALL ON FUNCTION pg_passwordguard_stats_reset() FROM PUBLIC;
+
+-- Policy simulation: pg_passwordguard_simulate(candidates, policies) evaluates each candidate policy
+-- (a jsonb object of rule settings, applied on top of the enforced policy) against every value of
+-- the "password" column of the candidates table, in one scan that can run in parallel.
+
+CREATE FUNCTION pg_passwordguard_simulate_trans(internal, text, jsonb[])
+RETURNS internal
+AS 'MODULE_PATHNAME', 'pg_passwordguard_simulate_trans'
+LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+
+CREATE FUNCTION pg_passwordguard_simulate_combine(internal, internal)
+RETURNS internal
+AS 'MODULE_PATHNAME', 'pg_passwordguard_simulate_combine'
+LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+
+CREATE FUNCTION pg_passwordguard_simulate_serialize(internal)
+RETURNS bytea
+AS 'MODULE_PATHNAME', 'pg_passwordguard_simulate_serialize'
+LANGUAGE C STRICT PARALLEL SAFE;
+
+CREATE FUNCTION pg_passwordguard_simulate_deserialize(bytea, internal)
+RETURNS internal
+AS 'MODULE_PATHNAME', 'pg_passwordguard_simulate_deserialize'
+LANGUAGE C STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE pg_passwordguard_simulate_agg(password text, policies jsonb[]) (
+    SFUNC = pg_passwordguard_simulate_trans,
+    STYPE = internal,
+    COMBINEFUNC = pg_passwordguard_simulate_combine,
+    SERIALFUNC = pg_passwordguard_simulate_serialize,
+    DESERIALFUNC = pg_passwordguard_simulate_deserialize,
+    FINALFUNC = pg_passwordguard_simulate_serialize,
+    PARALLEL = SAFE
+);
+
+CREATE FUNCTION pg_passwordguard_simulate_rows(
+    state bytea,
+    OUT policy integer,
+    OUT rule text,
+    OUT checked bigint,
+    OUT rejected bigint,
+    OUT rejection_rate double precision)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_passwordguard_simulate_rows'
+LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+
+-- One row per policy with a null rule (passwords rejected by any rule), then one per rule. The dynamic
+-- query names the extension's schema, which need not be on the caller's search_path.
+CREATE FUNCTION pg_passwordguard_simulate(
+    candidates regclass,
+    policies jsonb[],
+    OUT policy integer,
+    OUT rule text,
+    OUT checked bigint,
+    OUT rejected bigint,
+    OUT rejection_rate double precision)
+RETURNS SETOF record
+LANGUAGE plpgsql
+AS $$
+BEGIN
+    RETURN QUERY EXECUTE format(
+        'SELECT r.* FROM (SELECT @extschema@.pg_passwordguard_simulate_agg(password::text, $1) AS state FROM %s) s, '
+        'LATERAL @extschema@.pg_passwordguard_simulate_rows(s.state) r',
+        candidates)
+    USING policies;
+END
+$$;
+
+-- Password generation: pg_passwordguard_generate(count, length) returns count random passwords that
+-- satisfy the enforced policy. Without a length they are 16 characters, or min_length if longer.
+CREATE FUNCTION pg_passwordguard_generate(count integer, length integer DEFAULT NULL)
+RETURNS SETOF text
+AS 'MODULE_PATHNAME', 'pg_passwordguard_generate'
+LANGUAGE C CALLED ON NULL INPUT VOLATILE PARALLEL SAFE;
+
+-- Password rotation: pg_passwordguard_rotate(roles) sets a new generated password for every role, in
+-- the calling transaction, and returns the new passwords. The SCRAM hashing runs in background workers
+-- (pg_passwordguard.rotate_workers).
+CREATE FUNCTION pg_passwordguard_rotate(
+    roles regrole[],
+    OUT role regrole,
+    OUT password text)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_passwordguard_rotate'
+LANGUAGE C STRICT VOLATILE PARALLEL UNSAFE;
+
+-- ALTER ROLE still checks privileges on every role, but rotation starts workers; grant as needed.
+REVOKE ALL ON FUNCTION pg_passwordguard_rotate(regrole[]) FROM PUBLIC;
+
+-- Policy-version tracking: with pg_passwordguard.track_policy_versions on, every password change is
+-- recorded with the version hash of the enforced policy that checked it (as in the event log), and
+-- whether the password passed it (it may not have in log-only mode). Pre-hashed passwords can't be
+-- checked and have both null. Rows of dropped roles are deleted. Written by the library as the table
+-- owner; only superusers may read it unless granted.
+CREATE TABLE pg_passwordguard_password_changes (
+    roleid oid NOT NULL,
+    changed_at timestamptz NOT NULL DEFAULT now(),
+    policy_version text,
+    compliant boolean
+);
+
+CREATE INDEX pg_passwordguard_password_changes_role_idx
+    ON pg_passwordguard_password_changes (roleid, changed_at);
+CREATE INDEX pg_passwordguard_password_changes_version_idx
+    ON pg_passwordguard_password_changes (policy_version, changed_at);
+
+REVOKE ALL ON TABLE pg_passwordguard_password_changes FROM PUBLIC;
+
+SELECT pg_catalog.pg_extension_config_dump('pg_passwordguard_password_changes', '');
+
+-- The version hash of the enforced policy.
+CREATE FUNCTION pg_passwordguard_policy_version()
+RETURNS text
+AS 'MODULE_PATHNAME', 'pg_passwordguard_policy_version'
+LANGUAGE C STRICT STABLE PARALLEL SAFE;
+
+-- The last recorded change of every role; nulls for roles with none.
+CREATE VIEW pg_passwordguard_role_passwords AS
+    SELECT r.oid::regrole AS role, c.changed_at, c.policy_version, c.compliant
+    FROM pg_catalog.pg_roles r
+    LEFT JOIN LATERAL (
+        SELECT changed_at, policy_version, compliant
+        FROM pg_passwordguard_password_changes
+        WHERE roleid = r.oid
+        ORDER BY changed_at DESC
+        LIMIT 1) c ON true;
+
+REVOKE ALL ON pg_passwordguard_role_passwords FROM PUBLIC;
+
+-- Password expiry notifications: the notifications the expiry notifier (pg_passwordguard.expiry_database)
+-- will send next, earliest first, one per role.
+CREATE FUNCTION pg_passwordguard_expiry_queue(
+    OUT role regrole,
+    OUT valid_until timestamptz,
+    OUT days integer,
+    OUT notify_at timestamptz)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_passwordguard_expiry_queue'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+
+REVOKE ALL ON FUNCTION pg_passwordguard_expiry_queue() FROM PUBLIC;
+
+-- The enforced policy in the format of the client library (pg_passwordguard.h), which checks
+-- passwords against it before they are sent. Every setting in it can be read with SHOW anyway.
+CREATE FUNCTION pg_passwordguard_policy_export()
+RETURNS bytea
+AS 'MODULE_PATHNAME', 'pg_passwordguard_policy_export'
+LANGUAGE C STRICT STABLE PARALLEL SAFE;
+
+-- Cross-role password reuse (pg_passwordguard.reject_reuse): the groups of roles known to have the
+-- same password, from the fingerprints kept with pg_passwordguard.reuse_max_roles set.
+CREATE FUNCTION pg_passwordguard_password_reuse(
+    OUT roles regrole[],
+    OUT role_count integer)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_passwordguard_password_reuse'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+
+REVOKE ALL ON FUNCTION pg_passwordguard_password_reuse() FROM PUBLIC;
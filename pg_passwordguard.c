@@ -7,6 +7,21 @@
  *   - minimum length
  *   - must include upper/lower-case letters, digits, and a special character
  *   - must not contain the username
+ *   - must not be on the built-in common-password list
+ *   - optionally, must not contain the name of any other role
+ *   - optionally, dates and years (e.g. "Summer2024") are discounted or rejected
+ *   - optionally, a minimum score under a character n-gram (Markov) model
+ *   - optionally, a minimum estimated guess number derived from that model
+ *   - optionally, a minimum score under a PCFG (password structure) model
+ *   - optionally, a maximum weakness score from a small int8 neural network
+ *   - optionally, a maximum share of the password taken by a common password it contains
+ *   - optionally, must not be within a few edits of a dictionary word
+ *   - optionally, must not be based on a word of a cracklib dictionary, by cracklib's rules
+ *
+ * The model-based rules are the expensive ones; pg_passwordguard.max_check_time_ms bounds the time
+ * they may take, and violations and skipped stages are counted in the pg_passwordguard_stats view.
+ * A second, non-enforcing "shadow" policy (pg_passwordguard.shadow_*) can be evaluated alongside the
+ * enforced one to measure what a stricter policy would reject; see policy.c.
  *
  * Settings are exposed as GUCs under the "pg_passwordguard.*" prefix so they can be tuned in postgresql.conf or per-role.
  * NOTE
@@ -18,27 +33,51 @@
 
 #include "postgres.h"
 
-#include <ctype.h>
-#include <string.h>
 #include <limits.h>
+#include <string.h>
 #include "commands/user.h"
 #include "fmgr.h"
 #include "utils/guc.h"
+#include "utils/memutils.h"
 #include "utils/elog.h"
 
+#include "passwordguard.h"
+
 PG_MODULE_MAGIC;
 
 /* Store any previous password-check hook so this will don't break other extensions */
 static check_password_hook_type prev_check_password_hook = NULL;
 
-/* GUC-backed parameters with defaults. These can be overridden in postgresql.conf or with ALTER ROLE SET. */
-static int  pg_passwordguard_min_length      = 12;
-static bool pg_passwordguard_require_upper   = true;
-static bool pg_passwordguard_require_lower   = true;
-static bool pg_passwordguard_require_digit   = true;
-static bool pg_passwordguard_require_special = true;
-static bool pg_passwordguard_reject_username = true;
+/*
+ * GUC-backed parameters with defaults. These can be overridden in postgresql.conf or with ALTER ROLE SET.
+ * The rule settings of the enforced and the shadow policy are defined from pgg_policy_settings.
+ */
+static PggPolicy pg_passwordguard_policy;
+static PggPolicy pg_passwordguard_shadow_policy;
+static bool pg_passwordguard_shadow_enabled  = false;
+static char *pg_passwordguard_markov_model   = NULL;
+static char *pg_passwordguard_guess_table    = NULL;
+static char *pg_passwordguard_pcfg_model     = NULL;
+static char *pg_passwordguard_neural_model   = NULL;
+static char *pg_passwordguard_common_index   = NULL;
+static char *pg_passwordguard_dictionary     = NULL;
+static char *pg_passwordguard_cracklib_dictionary = NULL;
+static int  pg_passwordguard_neural_time_budget = 2000;
+static int  pg_passwordguard_max_check_time_ms = 0;
 static bool pg_passwordguard_log_only        = false;
+int         pgg_rotate_workers               = 4;
+char       *pgg_event_log                    = NULL;
+int         pgg_event_log_rotation_size      = 10240;
+int         pgg_event_queue_size             = 4096;
+int         pgg_log_only_max_warnings        = 0;
+int         pgg_log_only_summary_interval    = 60;
+bool        pgg_track_policy_versions        = false;
+char       *pgg_expiry_database              = NULL;
+char       *pgg_expiry_notice_days           = NULL;
+int         pgg_expiry_max_roles             = 65536;
+int         pgg_login_expiry_notice_days     = 0;
+int         pgg_reuse_max_roles              = 0;
+char       *pgg_reuse_key_file               = NULL;
 
 static void pg_passwordguard_check(const char *username,
                                 const char *shadow_pass,
@@ -46,67 +85,178 @@ static void pg_passwordguard_check(const char *username,
                                 Datum validuntil_time,
                                 bool validuntil_null);
 
+/*
+ * define_policy_gucs
+ *
+ * Defines one GUC per rule setting, named prefix + setting name, backed by the fields of policy.
+ * The GUC machinery keeps pointers to the descriptions, so they are built in TopMemoryContext.
+ */
+static void
+define_policy_gucs(const char *prefix, const char *desc_prefix, PggPolicy *policy)
+{
+    MemoryContext oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+    int         i;
+
+    pgg_policy_set_defaults(policy);
+
+    for (i = 0; i < pgg_num_policy_settings; i++)
+    {
+        const PggPolicySetting *s = &pgg_policy_settings[i];
+        char       *name = psprintf("%s%s", prefix, s->name);
+        char       *short_desc = psprintf("%s%s", desc_prefix, s->short_desc);
+        char       *field = (char *) policy + s->offset;
+
+        switch (s->type)
+        {
+            case PGG_SETTING_BOOL:
+                DefineCustomBoolVariable(name, short_desc, s->long_desc,
+                                         (bool *) field, s->boot_value != 0,
+                                         PGC_SUSET, 0,
+                                         NULL, NULL, NULL);
+                break;
+            case PGG_SETTING_INT:
+                DefineCustomIntVariable(name, short_desc, s->long_desc,
+                                        (int *) field, (int) s->boot_value,
+                                        (int) s->min_value, (int) s->max_value,
+                                        PGC_SUSET, 0,
+                                        NULL, NULL, NULL);
+                break;
+            case PGG_SETTING_REAL:
+                DefineCustomRealVariable(name, short_desc, s->long_desc,
+                                         (double *) field, s->boot_value,
+                                         s->min_value, s->max_value,
+                                         PGC_SUSET, 0,
+                                         NULL, NULL, NULL);
+                break;
+            case PGG_SETTING_ENUM:
+                DefineCustomEnumVariable(name, short_desc, s->long_desc,
+                                         (int *) field, (int) s->boot_value, s->options,
+                                         PGC_SUSET, 0,
+                                         NULL, NULL, NULL);
+                break;
+        }
+    }
+
+    MemoryContextSwitchTo(oldcontext);
+}
+
 /*_PG_init Called once when the server loads the module (at startup). Also register few GUCs and hook into check_password_hook here. */
 void
 _PG_init(void)
 {
-    DefineCustomIntVariable(
-        "pg_passwordguard.min_length",
-        "Minimum allowed password length.",
-        NULL,
-        &pg_passwordguard_min_length,
-        12,
-        0, INT_MAX,
+    define_policy_gucs("pg_passwordguard.", "", &pg_passwordguard_policy);
+
+    DefineCustomBoolVariable(
+        "pg_passwordguard.shadow_policy",
+        "Also evaluate the shadow policy (pg_passwordguard.shadow_*) for every password, without enforcing it.",
+        "Its violations are only counted in pg_passwordguard_stats.",
+        &pg_passwordguard_shadow_enabled,
+        false,
         PGC_SUSET,
         0,
         NULL, NULL, NULL);
 
-    DefineCustomBoolVariable(
-        "pg_passwordguard.require_upper",
-        "Require at least one uppercase letter in passwords.",
-        NULL,
-        &pg_passwordguard_require_upper,
-        true,
-        PGC_SUSET,
+    define_policy_gucs("pg_passwordguard.shadow_", "Shadow policy: ", &pg_passwordguard_shadow_policy);
+
+    DefineCustomStringVariable(
+        "pg_passwordguard.markov_model",
+        "Path of the Markov model file used by min_markov_bits (see tools/train_markov.pl).",
+        "Relative paths are relative to the data directory.",
+        &pg_passwordguard_markov_model,
+        "",
+        PGC_SIGHUP,
         0,
         NULL, NULL, NULL);
 
-    DefineCustomBoolVariable(
-        "pg_passwordguard.require_lower",
-        "Require at least one lowercase letter in passwords.",
-        NULL,
-        &pg_passwordguard_require_lower,
-        true,
-        PGC_SUSET,
+    DefineCustomStringVariable(
+        "pg_passwordguard.guess_table",
+        "Path of the guess-number table used by min_guesses_log10 (see tools/build_guess_table.pl).",
+        "Relative paths are relative to the data directory.",
+        &pg_passwordguard_guess_table,
+        "",
+        PGC_SIGHUP,
         0,
         NULL, NULL, NULL);
 
-    DefineCustomBoolVariable(
-        "pg_passwordguard.require_digit",
-        "Require at least one digit in passwords.",
-        NULL,
-        &pg_passwordguard_require_digit,
-        true,
-        PGC_SUSET,
+    DefineCustomStringVariable(
+        "pg_passwordguard.pcfg_model",
+        "Path of the PCFG model file used by min_pcfg_bits (see tools/train_pcfg.pl).",
+        "Relative paths are relative to the data directory.",
+        &pg_passwordguard_pcfg_model,
+        "",
+        PGC_SIGHUP,
         0,
         NULL, NULL, NULL);
 
-    DefineCustomBoolVariable(
-        "pg_passwordguard.require_special",
-        "Require at least one special (non-alphanumeric) character in passwords.",
-        NULL,
-        &pg_passwordguard_require_special,
-        true,
+    DefineCustomStringVariable(
+        "pg_passwordguard.neural_model",
+        "Path of the neural model file used by max_neural_score (see tools/export_neural_model.pl).",
+        "Relative paths are relative to the data directory.",
+        &pg_passwordguard_neural_model,
+        "",
+        PGC_SIGHUP,
+        0,
+        NULL, NULL, NULL);
+
+    DefineCustomStringVariable(
+        "pg_passwordguard.common_index",
+        "Path of the common-password index used by max_common_fraction (see tools/build_common_index.pl).",
+        "Relative paths are relative to the data directory.",
+        &pg_passwordguard_common_index,
+        "",
+        PGC_SIGHUP,
+        0,
+        NULL, NULL, NULL);
+
+    DefineCustomStringVariable(
+        "pg_passwordguard.dictionary",
+        "Path of the dictionary used by reject_dictionary (see tools/build_dictionary.pl).",
+        "Relative paths are relative to the data directory.",
+        &pg_passwordguard_dictionary,
+        "",
+        PGC_SIGHUP,
+        0,
+        NULL, NULL, NULL);
+
+    DefineCustomStringVariable(
+        "pg_passwordguard.cracklib_dictionary",
+        "Path of the cracklib dictionary used by reject_cracklib, without the .pwd/.pwi suffix (e.g. /usr/share/cracklib/pw_dict).",
+        "Relative paths are relative to the data directory.",
+        &pg_passwordguard_cracklib_dictionary,
+        "",
+        PGC_SIGHUP,
+        0,
+        NULL, NULL, NULL);
+
+    DefineCustomIntVariable(
+        "pg_passwordguard.neural_time_budget",
+        "Maximum time in microseconds the neural model may spend on one password; 0 means no limit.",
+        "If inference takes longer, the check is skipped with a warning.",
+        &pg_passwordguard_neural_time_budget,
+        2000,
+        0, 1000000,
         PGC_SUSET,
         0,
         NULL, NULL, NULL);
 
-    DefineCustomBoolVariable(
-        "pg_passwordguard.reject_username",
-        "Reject passwords that contain the username (case-insensitive).",
-        NULL,
-        &pg_passwordguard_reject_username,
-        true,
+    DefineCustomIntVariable(
+        "pg_passwordguard.max_check_time_ms",
+        "Time after which a password check skips its remaining expensive stages; 0 means no limit.",
+        "Skipped stages are reported with a warning and counted in pg_passwordguard_stats.",
+        &pg_passwordguard_max_check_time_ms,
+        0,
+        0, 60000,
+        PGC_SUSET,
+        GUC_UNIT_MS,
+        NULL, NULL, NULL);
+
+    DefineCustomIntVariable(
+        "pg_passwordguard.rotate_workers",
+        "Maximum number of background workers pg_passwordguard_rotate() uses to hash new passwords.",
+        "Also limited by max_worker_processes; 0 hashes everything in the calling backend.",
+        &pgg_rotate_workers,
+        4,
+        0, 1024,
         PGC_SUSET,
         0,
         NULL, NULL, NULL);
@@ -121,14 +271,194 @@ _PG_init(void)
         0,
         NULL, NULL, NULL);
 
+    DefineCustomStringVariable(
+        "pg_passwordguard.event_log",
+        "File to which policy violations are written as JSON lines by a background worker; empty disables it.",
+        "Relative paths are relative to the data directory. In log-only mode, violations go only to this file "
+        "instead of being logged as warnings. Requires shared_preload_libraries.",
+        &pgg_event_log,
+        "",
+        PGC_SIGHUP,
+        0,
+        NULL, NULL, NULL);
+
+    DefineCustomIntVariable(
+        "pg_passwordguard.event_log_rotation_size",
+        "Size at which the event log is renamed with a \".1\" suffix and a new one is started; 0 disables rotation.",
+        NULL,
+        &pgg_event_log_rotation_size,
+        10240,
+        0, INT_MAX / 1024,
+        PGC_SIGHUP,
+        GUC_UNIT_KB,
+        NULL, NULL, NULL);
+
+    DefineCustomIntVariable(
+        "pg_passwordguard.event_queue_size",
+        "Number of events the shared queue to the event log worker can hold.",
+        "Events that don't fit are dropped and counted.",
+        &pgg_event_queue_size,
+        4096,
+        16, 1048576,
+        PGC_POSTMASTER,
+        0,
+        NULL, NULL, NULL);
+
+    DefineCustomIntVariable(
+        "pg_passwordguard.log_only_max_warnings",
+        "Maximum number of log-only warnings per second, across all sessions; 0 means no limit.",
+        "Violations over the limit are counted per role and rule and logged as a periodic summary. "
+        "Requires shared_preload_libraries.",
+        &pgg_log_only_max_warnings,
+        0,
+        0, 1000000,
+        PGC_SIGHUP,
+        0,
+        NULL, NULL, NULL);
+
+    DefineCustomIntVariable(
+        "pg_passwordguard.log_only_summary_interval",
+        "Interval between summaries of the log-only warnings suppressed by log_only_max_warnings.",
+        NULL,
+        &pgg_log_only_summary_interval,
+        60,
+        1, 86400,
+        PGC_SIGHUP,
+        GUC_UNIT_S,
+        NULL, NULL, NULL);
+
+    DefineCustomBoolVariable(
+        "pg_passwordguard.track_policy_versions",
+        "Record every password change with the version of the policy that checked it.",
+        "Changes are recorded in pg_passwordguard_password_changes.",
+        &pgg_track_policy_versions,
+        false,
+        PGC_SUSET,
+        0,
+        NULL, NULL, NULL);
+
+    DefineCustomStringVariable(
+        "pg_passwordguard.expiry_database",
+        "Database the password expiry notifier connects to; empty disables it.",
+        "Requires shared_preload_libraries. Expiry notifications are sent on the channel "
+        "pg_passwordguard_expiry of this database.",
+        &pgg_expiry_database,
+        "",
+        PGC_POSTMASTER,
+        0,
+        NULL, NULL, NULL);
+
+    DefineCustomStringVariable(
+        "pg_passwordguard.expiry_notice_days",
+        "Comma-separated days before a password expires at which to announce it.",
+        NULL,
+        &pgg_expiry_notice_days,
+        "7,1",
+        PGC_SIGHUP,
+        GUC_LIST_INPUT,
+        pgg_expiry_days_check, pgg_expiry_days_assign, NULL);
+
+    DefineCustomIntVariable(
+        "pg_passwordguard.expiry_max_roles",
+        "Number of roles with an upcoming expiry notification the notifier can keep track of.",
+        "Beyond that, the notifier reads pg_authid again at every notification.",
+        &pgg_expiry_max_roles,
+        65536,
+        16, 10000000,
+        PGC_POSTMASTER,
+        0,
+        NULL, NULL, NULL);
+
+    DefineCustomIntVariable(
+        "pg_passwordguard.login_expiry_notice_days",
+        "Send a notice at login when the password expires within this many days; 0 disables it.",
+        "Requires shared_preload_libraries.",
+        &pgg_login_expiry_notice_days,
+        0,
+        0, 3650,
+        PGC_SIGHUP,
+        0,
+        NULL, NULL, NULL);
+
+    DefineCustomIntVariable(
+        "pg_passwordguard.reuse_max_roles",
+        "Number of roles whose password fingerprints are kept for reject_reuse; 0 disables fingerprinting.",
+        "Requires shared_preload_libraries. Fingerprints beyond that are not kept.",
+        &pgg_reuse_max_roles,
+        0,
+        0, 10000000,
+        PGC_POSTMASTER,
+        0,
+        NULL, NULL, NULL);
+
+    DefineCustomStringVariable(
+        "pg_passwordguard.reuse_key_file",
+        "File holding the secret key of the password fingerprints (32 to 256 bytes); empty uses a random key.",
+        "Relative paths are relative to the data directory. Fingerprints are only kept across restarts "
+        "with a key file.",
+        &pgg_reuse_key_file,
+        "",
+        PGC_POSTMASTER,
+        0,
+        NULL, NULL, NULL);
+
     /* Reserve the prefix so other extensions don't clash with us. */
     MarkGUCPrefixReserved("pg_passwordguard");
 
+    /* Shared-memory counters, warning rate limit and the event log worker (only when preloaded). */
+    pgg_stats_init();
+    pgg_warnings_init();
+    pgg_eventlog_init();
+
+    /* Password expiry notifier (only when preloaded with expiry_database set). */
+    pgg_expiry_init();
+
+    /* Notice at login about a password that expires soon. */
+    pgg_login_init();
+
+    /* Recording of password changes in pg_passwordguard_password_changes. */
+    pgg_history_init();
+
+    /* Password fingerprints for reject_reuse (only when preloaded with reuse_max_roles set). */
+    pgg_reuse_init();
+
     /* Chain our hook after any existing one. */
     prev_check_password_hook = check_password_hook;
     check_password_hook = pg_passwordguard_check;
 }
 
+/* The enforced policy, as currently configured. */
+const PggPolicy *
+pgg_enforced_policy(void)
+{
+    return &pg_passwordguard_policy;
+}
+
+/*
+ * pgg_check_init
+ *
+ * Prepares a check of password with the current server-wide settings (model files, time limits).
+ * The time budget starts now.
+ */
+void
+pgg_check_init(PggCheck *check, const char *password, int len, const char *username)
+{
+    memset(check, 0, sizeof(PggCheck));
+    check->password = password;
+    check->len = len;
+    check->username = username;
+    check->markov_model = pg_passwordguard_markov_model;
+    check->guess_table = pg_passwordguard_guess_table;
+    check->pcfg_model = pg_passwordguard_pcfg_model;
+    check->neural_model = pg_passwordguard_neural_model;
+    check->common_index = pg_passwordguard_common_index;
+    check->dictionary = pg_passwordguard_dictionary;
+    check->cracklib_dictionary = pg_passwordguard_cracklib_dictionary;
+    check->neural_time_budget = pg_passwordguard_neural_time_budget;
+    check->max_check_time_ms = pg_passwordguard_max_check_time_ms;
+    INSTR_TIME_SET_CURRENT(check->start);
+}
+
 /* pg_passwordguard_check, This is called whenever a password is set or changed. This extension only validate plaintext passwords. Existing passwords are not re-checked; they continue to work until changed. */
 static void
 pg_passwordguard_check(const char *username,
@@ -137,14 +467,9 @@ pg_passwordguard_check(const char *username,
                     Datum validuntil_time,
                     bool validuntil_null)
 {
-    bool has_upper   = false;
-    bool has_lower   = false;
-    bool has_digit   = false;
-    bool has_special = false;
-
-    const char *password;
-    int         len;
-    int         i;
+    PggCheck    check;
+    PggVerdict  verdict;
+    bool        events;
 
     /* This extension don't use these, but the hook API requires them. */
     (void) validuntil_time;
@@ -163,6 +488,10 @@ pg_passwordguard_check(const char *username,
     {
         ereport(DEBUG1,
                 (errmsg("pg_passwordguard: skipping non-plaintext password")));
+        /* Its fingerprint can't be known; the role's old one goes. */
+        pgg_reuse_remember(NULL, 0);
+        /* Recorded as checked by no policy. */
+        pgg_history_remember(NULL, false);
         return;
     }
 
@@ -170,123 +499,57 @@ pg_passwordguard_check(const char *username,
     if (shadow_pass == NULL)
         return;
 
-    password = shadow_pass;
-    len = strlen(password);
+    pgg_check_init(&check, shadow_pass, strlen(shadow_pass), username);
 
-    /* Minimum length check. */
-    if (len < pg_passwordguard_min_length)
+    /*
+     * A rejected password ends with the ERROR raised by pgg_policy_report(); pgg_check_end() must
+     * still wipe the copies of the password the stages made.
+     */
+    PG_TRY();
     {
-        if (pg_passwordguard_log_only)
+        /*
+         * Evaluate the enforced policy first, so the shadow policy can never take its time budget.
+         * Unless every violation is going to be logged, or the shadow policy needs the full analysis
+         * anyway, evaluation stops at the first violation.
+         */
+        pgg_policy_evaluate(&pg_passwordguard_policy, &check,
+                            !pg_passwordguard_log_only && !pg_passwordguard_shadow_enabled,
+                            &verdict);
+
+        events = pgg_eventlog_enabled();
+
+        /* The shadow policy reuses the analysis the enforced one already did; it is only counted. */
+        if (pg_passwordguard_shadow_enabled)
         {
-            ereport(WARNING,
-                    (errmsg("pg_passwordguard: password too short (len=%d, min=%d)",
-                            len, pg_passwordguard_min_length)));
-        }
-        else
-        {
-            ereport(ERROR,
-                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                     errmsg("password does not meet complexity requirements"),
-                     errdetail("Password must be at least %d characters long.",
-                               pg_passwordguard_min_length)));
-        }
-        return;
-    }
+            PggVerdict  shadow_verdict;
 
-    /* Classify characters. */
-    for (i = 0; i < len; i++)
-    {
-        unsigned char c = (unsigned char) password[i];
-
-        if (isupper(c))
-            has_upper = true;
-        else if (islower(c))
-            has_lower = true;
-        else if (isdigit(c))
-            has_digit = true;
-        else
-            has_special = true;
-    }
-
-    /* Uppercase requirement. */
-    if (pg_passwordguard_require_upper && !has_upper)
-    {
-        if (pg_passwordguard_log_only)
-            ereport(WARNING, (errmsg("pg_passwordguard: missing uppercase letter")));
-        else
-            ereport(ERROR,
-                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                     errmsg("password does not meet complexity requirements"),
-                     errdetail("Password must contain at least one uppercase letter.")));
-    }
+            pgg_policy_evaluate(&pg_passwordguard_shadow_policy, &check, false, &shadow_verdict);
+            pgg_stats_count(PGG_POLICY_SHADOW, &shadow_verdict);
+            if (events && shadow_verdict.violated != 0)
+                pgg_eventlog_add(PGG_POLICY_SHADOW, username, &pg_passwordguard_shadow_policy,
+                                 &shadow_verdict, false);
+        }
 
-    /* Lowercase requirement. */
-    if (pg_passwordguard_require_lower && !has_lower)
-    {
-        if (pg_passwordguard_log_only)
-            ereport(WARNING, (errmsg("pg_passwordguard: missing lowercase letter")));
-        else
-            ereport(ERROR,
-                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                     errmsg("password does not meet complexity requirements"),
-                     errdetail("Password must contain at least one lowercase letter.")));
-    }
+        pgg_stats_count(PGG_POLICY_ENFORCED, &verdict);
+        if (events && verdict.violated != 0)
+            pgg_eventlog_add(PGG_POLICY_ENFORCED, username, &pg_passwordguard_policy, &verdict,
+                             !pg_passwordguard_log_only);
 
-    /* Digit requirement. */
-    if (pg_passwordguard_require_digit && !has_digit)
-    {
-        if (pg_passwordguard_log_only)
-            ereport(WARNING, (errmsg("pg_passwordguard: missing digit")));
-        else
-            ereport(ERROR,
-                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                     errmsg("password does not meet complexity requirements"),
-                     errdetail("Password must contain at least one digit.")));
-    }
+        /*
+         * ERROR for the first violation, or a WARNING for each one in log-only mode; with the event
+         * log on, log-only violations are only recorded there.
+         */
+        if (!(events && pg_passwordguard_log_only))
+            pgg_policy_report(&pg_passwordguard_policy, &check, &verdict, pg_passwordguard_log_only);
 
-    /* Special character requirement. */
-    if (pg_passwordguard_require_special && !has_special)
-    {
-        if (pg_passwordguard_log_only)
-            ereport(WARNING, (errmsg("pg_passwordguard: missing special character")));
-        else
-            ereport(ERROR,
-                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                     errmsg("password does not meet complexity requirements"),
-                     errdetail("Password must contain at least one special character.")));
+        pgg_history_remember(&pg_passwordguard_policy, verdict.violated == 0);
+        pgg_reuse_remember(shadow_pass, check.len);
     }
-
-    /* Reject passwords that contain the username (case-insensitive). */
-    if (pg_passwordguard_reject_username && username != NULL)
+    PG_FINALLY();
     {
-        char *lower_pwd  = pstrdup(password);
-        char *lower_user = pstrdup(username);
-
-        for (i = 0; lower_pwd[i]; i++)
-            lower_pwd[i] = (char) tolower((unsigned char) lower_pwd[i]);
-        for (i = 0; lower_user[i]; i++)
-            lower_user[i] = (char) tolower((unsigned char) lower_user[i]);
-
-        if (strstr(lower_pwd, lower_user) != NULL)
-        {
-            if (pg_passwordguard_log_only)
-            {
-                ereport(WARNING,
-                        (errmsg("pg_passwordguard: password contains username")));
-            }
-            else
-            {
-                ereport(ERROR,
-                        (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                         errmsg("password does not meet complexity requirements"),
-                         errdetail("Password must not contain the username.")));
-            }
-        }
-
-        pfree(lower_pwd);
-        pfree(lower_user);
+        pgg_check_end(&check);
     }
+    PG_END_TRY();
 
     /* If we reach here, all enabled checks passed and the password is accepted. */
 }
-
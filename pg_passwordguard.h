@@ -0,0 +1,107 @@
+/*
+ * pg_passwordguard.h
+ *
+ * Client library of pg_passwordguard (libpg_passwordguard.a): checks passwords against the server's
+ * policy without a round trip, with the same policy code the server runs.
+ *
+ * Get the policy from the server with SELECT pg_passwordguard_policy_export() and load it with
+ * pgguard_policy_load(). The rules that need model files are checked only if the same files are
+ * available locally (pgguard_policy_set_model()); reject_rolenames and reject_reuse are never
+ * checked, since only the server knows the roles and their passwords' fingerprints.
+ * pgguard_policy_unchecked_rules() tells which rules of a policy are left unchecked. The server
+ * stays the authority: a password that passes here may still be rejected there.
+ *
+ * Passwords and usernames are taken to be UTF-8, as reject_username compares them after Unicode
+ * normalization.
+ *
+ * The library is thread-safe once the policy is loaded and its models set: any number of threads
+ * may check passwords against it. Model files are process-wide, so use one set per process.
+ *
+ * Link with -lpg_passwordguard -lpgcommon -lpgport -lm.
+ *
+ * Developed by: Kothari Nishchay
+ */
+#ifndef PG_PASSWORDGUARD_H
+#define PG_PASSWORDGUARD_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Rules, as bits of PgGuardResult; the order of pg_passwordguard_stats. */
+#define PGGUARD_MIN_LENGTH          (1u << 0)
+#define PGGUARD_REQUIRE_UPPER       (1u << 1)
+#define PGGUARD_REQUIRE_LOWER       (1u << 2)
+#define PGGUARD_REQUIRE_DIGIT       (1u << 3)
+#define PGGUARD_REQUIRE_SPECIAL     (1u << 4)
+#define PGGUARD_REJECT_USERNAME     (1u << 5)
+#define PGGUARD_REJECT_COMMON       (1u << 6)
+#define PGGUARD_REJECT_ROLENAMES    (1u << 7)
+#define PGGUARD_DATE_PATTERNS       (1u << 8)
+#define PGGUARD_MIN_MARKOV_BITS     (1u << 9)
+#define PGGUARD_MIN_GUESSES_LOG10   (1u << 10)
+#define PGGUARD_MIN_PCFG_BITS       (1u << 11)
+#define PGGUARD_MAX_NEURAL_SCORE    (1u << 12)
+#define PGGUARD_REJECT_REUSE        (1u << 13)
+#define PGGUARD_MAX_COMMON_FRACTION (1u << 14)
+#define PGGUARD_REJECT_DICTIONARY   (1u << 15)
+#define PGGUARD_REJECT_CRACKLIB     (1u << 16)
+
+#define PGGUARD_NUM_RULES           17
+
+#define PGGUARD_MESSAGE_SIZE        256
+
+typedef struct PgGuardPolicy PgGuardPolicy;
+
+typedef struct PgGuardResult
+{
+    unsigned int violated;      /* rules the password breaks */
+    unsigned int skipped;       /* rules that ran out of time */
+    char        message[PGGUARD_MESSAGE_SIZE];  /* why a call failed */
+} PgGuardResult;
+
+/*
+ * Loads an exported policy; NULL on error, with the reason in errbuf.
+ */
+extern PgGuardPolicy *pgguard_policy_load(const void *data, size_t size,
+                                          char *errbuf, size_t errbuf_size);
+
+/*
+ * Sets the model file for a model setting ("markov_model", "guess_table", "pcfg_model",
+ * "neural_model", "common_index", "dictionary" or "cracklib_dictionary") and loads it. Returns 0, or
+ * -1 with the reason in errbuf.
+ */
+extern int  pgguard_policy_set_model(PgGuardPolicy *policy, const char *setting, const char *path,
+                                     char *errbuf, size_t errbuf_size);
+
+/* The policy version, as returned by pg_passwordguard_policy_version(). */
+extern unsigned int pgguard_policy_version(const PgGuardPolicy *policy);
+
+/*
+ * The rules the policy enables that pgguard_check() can't check, as PgGuardResult bits: the model
+ * rules whose model files aren't set, and reject_rolenames and reject_reuse. pgguard_check() never
+ * reports them as violated.
+ */
+extern unsigned int pgguard_policy_unchecked_rules(const PgGuardPolicy *policy);
+
+/*
+ * Checks password (for role username, which may be NULL) against the policy. Returns 0 if it
+ * passes, 1 if it breaks a rule (all violated rules are in result->violated), and -1 if it couldn't
+ * be checked (the reason is in result->message).
+ */
+extern int  pgguard_check(const PgGuardPolicy *policy, const char *password, const char *username,
+                          PgGuardResult *result);
+
+/* The name of the rule with bit 1 << rule, as in the server's messages and views. */
+extern const char *pgguard_rule_name(int rule);
+
+extern void pgguard_policy_free(PgGuardPolicy *policy);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                          /* PG_PASSWORDGUARD_H */
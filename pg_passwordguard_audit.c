@@ -0,0 +1,576 @@
+/*
+ * pg_passwordguard_audit.c
+ *
+ * pg_passwordguard_audit: checks every password of a file (one per line, or username:password with
+ * --usernames) against an exported policy with the client library, i.e. with the policy code of the
+ * server, without loading the file into a database. It prints a verdict per input line, in input
+ * order, or with --summary only the totals and the number of passwords breaking each rule.
+ *
+ * A rule the tool can't check (a model rule without its --model file, reject_rolenames, reject_reuse)
+ * would pass every password, so the tool refuses to run with one unless --allow-unchecked is given;
+ * the summary then lists them.
+ *
+ * The file is mapped into memory and cut into fixed-size chunks; each line belongs to the chunk it
+ * starts in. The chunks are dealt round-robin to the worker threads' queues. A worker takes its chunks
+ * in file order from the front of its queue and, once its queue is empty, steals from the front of
+ * another worker's queue, so a worker that got the slow passwords does not hold up the run. Since
+ * chunks are only ever taken from the front, all workers move through the file together and only a
+ * few chunks' worth of verdicts wait to be written in order.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres_fe.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/logging.h"
+#include "getopt_long.h"
+#include "lib/stringinfo.h"
+
+#include "pg_passwordguard.h"
+
+#define AUDIT_CHUNK_SIZE        (1024 * 1024)
+#define AUDIT_MAX_JOBS          1024
+
+/* Verdicts of one chunk, until it is its turn to be written. */
+typedef struct AuditChunk
+{
+    char       *output;
+    size_t      len;
+    bool        done;
+} AuditChunk;
+
+/*
+ * A worker's queue: the chunks id, id + njobs, id + 2 * njobs, ... whose sequence numbers are in
+ * [head, tail).
+ */
+typedef struct AuditWorker
+{
+    int         id;
+    pthread_t   thread;
+    pthread_mutex_t lock;
+    size_t      head;
+    size_t      tail;
+
+    /* results of the chunks this worker checked */
+    uint64      lines;
+    uint64      failed;
+    uint64      errors;
+    uint64      rule_counts[PGGUARD_NUM_RULES];
+} AuditWorker;
+
+static const char *progname;
+
+static PgGuardPolicy *policy;
+static unsigned int unchecked_rules;
+static bool with_usernames = false;
+static bool summary_only = false;
+
+static const char *data;
+static size_t data_size;
+static size_t nchunks;
+
+static int  njobs;
+static AuditWorker *workers;
+
+/* Ordered output of the verdicts: chunks[next_write] is the next to go. */
+static FILE *output;
+static AuditChunk *chunks;
+static size_t next_write = 0;
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+usage(void)
+{
+    printf("%s checks the passwords of a file against a pg_passwordguard policy.\n\n", progname);
+    printf("Usage:\n");
+    printf("  %s [OPTION]... --policy=FILE INPUT\n", progname);
+    printf("\nOptions:\n");
+    printf("  -p, --policy=FILE          exported policy, from SELECT pg_passwordguard_policy_export()\n");
+    printf("  -m, --model=SETTING=PATH   model file for a model setting, e.g. markov_model=/srv/markov.bin\n");
+    printf("  -U, --usernames            input lines are username:password\n");
+    printf("  -j, --jobs=NUM             number of worker threads (default: number of CPUs)\n");
+    printf("  -s, --summary              print only the totals, not a verdict per line\n");
+    printf("  -o, --output=FILE          write to FILE instead of standard output\n");
+    printf("      --allow-unchecked      check the other rules when some rules of the policy can't be\n"
+           "                             checked (model rules without --model, reject_rolenames,\n"
+           "                             reject_reuse)\n");
+    printf("  -?, --help                 show this help, then exit\n");
+    printf("\nThe verdict of each line is \"ok\", the violated rules separated by commas, or \"error\".\n");
+    printf("Exit status is 0 if every password passes, 2 if some do not, 1 on errors.\n");
+}
+
+static int
+hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * Reads the exported policy from path, either raw or as the hex text psql prints for a bytea.
+ */
+static PgGuardPolicy *
+load_policy(const char *path)
+{
+    FILE       *file;
+    StringInfoData buf;
+    char        block[8192];
+    size_t      n;
+    char       *bytes;
+    size_t      size;
+    char        errbuf[PGGUARD_MESSAGE_SIZE];
+    PgGuardPolicy *result;
+
+    if ((file = fopen(path, PG_BINARY_R)) == NULL)
+        pg_fatal("could not open policy file \"%s\": %m", path);
+
+    initStringInfo(&buf);
+    while ((n = fread(block, 1, sizeof(block), file)) > 0)
+        appendBinaryStringInfo(&buf, block, (int) n);
+    if (ferror(file))
+        pg_fatal("could not read policy file \"%s\": %m", path);
+    fclose(file);
+
+    bytes = buf.data;
+    size = buf.len;
+    if (size >= 2 && bytes[0] == '\\' && bytes[1] == 'x')
+    {
+        size_t      i;
+
+        while (size > 2 && isspace((unsigned char) bytes[size - 1]))
+            size--;
+        if (size % 2 != 0)
+            pg_fatal("invalid hex data in policy file \"%s\"", path);
+
+        for (i = 2; i < size; i += 2)
+        {
+            int         hi = hex_value(bytes[i]);
+            int         lo = hex_value(bytes[i + 1]);
+
+            if (hi < 0 || lo < 0)
+                pg_fatal("invalid hex data in policy file \"%s\"", path);
+            bytes[i / 2 - 1] = (char) (hi << 4 | lo);
+        }
+        size = size / 2 - 1;
+    }
+
+    result = pgguard_policy_load(bytes, size, errbuf, sizeof(errbuf));
+    if (result == NULL)
+        pg_fatal("could not load policy file \"%s\": %s", path, errbuf);
+    pfree(buf.data);
+
+    return result;
+}
+
+/* Adds a model file to the policy, from a --model argument. */
+static void
+set_model(const char *arg)
+{
+    char       *setting = pg_strdup(arg);
+    char       *path = strchr(setting, '=');
+    char        errbuf[PGGUARD_MESSAGE_SIZE];
+
+    if (path == NULL)
+        pg_fatal("invalid argument for option --model: \"%s\"", arg);
+    *path++ = '\0';
+
+    if (pgguard_policy_set_model(policy, setting, path, errbuf, sizeof(errbuf)) != 0)
+        pg_fatal("could not set %s: %s", setting, errbuf);
+    pg_free(setting);
+}
+
+/* The names of rules, separated by commas. */
+static char *
+rule_list(unsigned int rules)
+{
+    StringInfoData buf;
+    int         rule;
+
+    initStringInfo(&buf);
+    for (rule = 0; rule < PGGUARD_NUM_RULES; rule++)
+    {
+        if ((rules & (1u << rule)) == 0)
+            continue;
+        if (buf.len > 0)
+            appendStringInfoString(&buf, ", ");
+        appendStringInfoString(&buf, pgguard_rule_name(rule));
+    }
+    return buf.data;
+}
+
+/*
+ * Checks the lines that start in chunk, adding their verdicts to out unless summary_only.
+ */
+static void
+check_chunk(AuditWorker *worker, size_t chunk, StringInfo line, StringInfo out)
+{
+    size_t      pos = chunk * AUDIT_CHUNK_SIZE;
+    size_t      end = Min(pos + AUDIT_CHUNK_SIZE, data_size);
+
+    /* A line running into the chunk belongs to the previous one. */
+    if (pos > 0 && data[pos - 1] != '\n')
+    {
+        const char *nl = memchr(data + pos, '\n', data_size - pos);
+
+        pos = (nl == NULL) ? data_size : (size_t) (nl - data) + 1;
+    }
+
+    while (pos < end)
+    {
+        const char *nl = memchr(data + pos, '\n', data_size - pos);
+        size_t      len = (nl == NULL) ? data_size - pos : (size_t) (nl - data) - pos;
+        const char *password;
+        const char *username = NULL;
+        PgGuardResult result;
+        int         rc;
+        int         rule;
+
+        /* NUL-terminated copy, without the CR of a CRLF line end */
+        resetStringInfo(line);
+        appendBinaryStringInfo(line, data + pos, (int) len);
+        if (len > 0 && line->data[len - 1] == '\r')
+            line->data[--line->len] = '\0';
+        pos += len + 1;
+
+        password = line->data;
+        if (with_usernames)
+        {
+            char       *colon = strchr(line->data, ':');
+
+            if (colon != NULL)
+            {
+                *colon = '\0';
+                username = line->data;
+                password = colon + 1;
+            }
+        }
+
+        rc = pgguard_check(policy, password, username, &result);
+        worker->lines++;
+
+        if (rc < 0)
+        {
+            worker->errors++;
+            if (!summary_only)
+                appendStringInfoString(out, "error\n");
+            continue;
+        }
+        if (rc == 0)
+        {
+            if (!summary_only)
+                appendStringInfoString(out, "ok\n");
+            continue;
+        }
+
+        worker->failed++;
+        for (rule = 0; rule < PGGUARD_NUM_RULES; rule++)
+        {
+            if ((result.violated & (1u << rule)) == 0)
+                continue;
+            worker->rule_counts[rule]++;
+            if (!summary_only)
+            {
+                if (out->len > 0 && out->data[out->len - 1] != '\n')
+                    appendStringInfoChar(out, ',');
+                appendStringInfoString(out, pgguard_rule_name(rule));
+            }
+        }
+        if (!summary_only)
+            appendStringInfoChar(out, '\n');
+    }
+}
+
+/* Hands the verdicts of chunk to the writer, and writes all chunks whose turn has come. */
+static void
+write_chunk(size_t chunk, StringInfo out)
+{
+    pthread_mutex_lock(&output_lock);
+
+    chunks[chunk].output = out->data;
+    chunks[chunk].len = out->len;
+    chunks[chunk].done = true;
+
+    while (next_write < nchunks && chunks[next_write].done)
+    {
+        AuditChunk *c = &chunks[next_write++];
+
+        if (c->len > 0 && fwrite(c->output, 1, c->len, output) != c->len)
+            pg_fatal("could not write verdicts: %m");
+        pfree(c->output);
+        c->output = NULL;
+    }
+
+    pthread_mutex_unlock(&output_lock);
+}
+
+/*
+ * Takes the next chunk for worker: the front of its own queue, else the front of another's, the
+ * earliest chunk that worker has not started. Returns false once all queues are empty.
+ */
+static bool
+next_chunk(AuditWorker *worker, size_t *chunk)
+{
+    int         i;
+
+    pthread_mutex_lock(&worker->lock);
+    if (worker->head < worker->tail)
+    {
+        *chunk = worker->id + worker->head++ * njobs;
+        pthread_mutex_unlock(&worker->lock);
+        return true;
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    for (i = 1; i < njobs; i++)
+    {
+        AuditWorker *victim = &workers[(worker->id + i) % njobs];
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail)
+        {
+            *chunk = victim->id + victim->head++ * njobs;
+            pthread_mutex_unlock(&victim->lock);
+            return true;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+
+    return false;
+}
+
+static void *
+worker_main(void *arg)
+{
+    AuditWorker *worker = (AuditWorker *) arg;
+    StringInfoData line;
+    size_t      chunk;
+
+    initStringInfo(&line);
+    while (next_chunk(worker, &chunk))
+    {
+        StringInfoData out;
+
+        initStringInfo(&out);
+        check_chunk(worker, chunk, &line, &out);
+        if (summary_only)
+            pfree(out.data);
+        else
+            write_chunk(chunk, &out);
+    }
+    pfree(line.data);
+
+    return NULL;
+}
+
+static void
+print_summary(void)
+{
+    uint64      lines = 0;
+    uint64      failed = 0;
+    uint64      errors = 0;
+    int         rule;
+    int         i;
+
+    for (i = 0; i < njobs; i++)
+    {
+        lines += workers[i].lines;
+        failed += workers[i].failed;
+        errors += workers[i].errors;
+    }
+
+    fprintf(output, "policy version: %08x\n", pgguard_policy_version(policy));
+    fprintf(output, "passwords: " UINT64_FORMAT "\n", lines);
+    fprintf(output, "passed: " UINT64_FORMAT "\n", lines - failed - errors);
+    fprintf(output, "failed: " UINT64_FORMAT "\n", failed);
+    fprintf(output, "errors: " UINT64_FORMAT "\n", errors);
+    if (unchecked_rules != 0)
+        fprintf(output, "unchecked: %s\n", rule_list(unchecked_rules));
+
+    for (rule = 0; rule < PGGUARD_NUM_RULES; rule++)
+    {
+        uint64      count = 0;
+
+        for (i = 0; i < njobs; i++)
+            count += workers[i].rule_counts[rule];
+        if (count > 0)
+            fprintf(output, "  %s: " UINT64_FORMAT "\n", pgguard_rule_name(rule), count);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    static struct option long_options[] = {
+        {"policy", required_argument, NULL, 'p'},
+        {"model", required_argument, NULL, 'm'},
+        {"usernames", no_argument, NULL, 'U'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"summary", no_argument, NULL, 's'},
+        {"output", required_argument, NULL, 'o'},
+        {"allow-unchecked", no_argument, NULL, 1},
+        {"help", no_argument, NULL, '?'},
+        {NULL, 0, NULL, 0}
+    };
+    const char *policy_path = NULL;
+    const char *output_path = NULL;
+    char      **models;
+    int         nmodels = 0;
+    bool        allow_unchecked = false;
+    const char *input_path;
+    int         fd;
+    struct stat st;
+    uint64      failed = 0;
+    uint64      errors = 0;
+    int         c;
+    int         i;
+
+    pg_logging_init(argv[0]);
+    progname = get_progname(argv[0]);
+
+    if (argc > 1 && (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-?") == 0))
+    {
+        usage();
+        exit(0);
+    }
+
+    njobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    models = pg_malloc(argc * sizeof(char *));
+
+    while ((c = getopt_long(argc, argv, "p:m:Uj:so:?", long_options, NULL)) != -1)
+    {
+        switch (c)
+        {
+            case 'p':
+                policy_path = optarg;
+                break;
+            case 'm':
+                models[nmodels++] = optarg;
+                break;
+            case 'U':
+                with_usernames = true;
+                break;
+            case 'j':
+                njobs = atoi(optarg);
+                if (njobs < 1 || njobs > AUDIT_MAX_JOBS)
+                    pg_fatal("-j/--jobs must be in range %d..%d", 1, AUDIT_MAX_JOBS);
+                break;
+            case 's':
+                summary_only = true;
+                break;
+            case 'o':
+                output_path = optarg;
+                break;
+            case 1:
+                allow_unchecked = true;
+                break;
+            default:
+                pg_log_error_hint("Try \"%s --help\" for more information.", progname);
+                exit(1);
+        }
+    }
+
+    if (optind != argc - 1 || policy_path == NULL)
+    {
+        pg_log_error(policy_path == NULL ? "no policy file specified" :
+                     "exactly one input file must be specified");
+        pg_log_error_hint("Try \"%s --help\" for more information.", progname);
+        exit(1);
+    }
+    input_path = argv[optind];
+    if (njobs < 1)
+        njobs = 1;
+
+    policy = load_policy(policy_path);
+    for (i = 0; i < nmodels; i++)
+        set_model(models[i]);
+
+    /* Passing every password on a rule nobody checked would be a false pass. */
+    unchecked_rules = pgguard_policy_unchecked_rules(policy);
+    if (unchecked_rules != 0)
+    {
+        if (!allow_unchecked)
+        {
+            pg_log_error("the policy has rules that can't be checked here: %s",
+                         rule_list(unchecked_rules));
+            pg_log_error_detail("Model rules need their model file (--model); reject_rolenames and reject_reuse are only checked by the server.");
+            pg_log_error_hint("Use --allow-unchecked to check the other rules only.");
+            exit(1);
+        }
+        pg_log_warning("not checking rules: %s", rule_list(unchecked_rules));
+    }
+
+    if (output_path == NULL)
+        output = stdout;
+    else if ((output = fopen(output_path, "w")) == NULL)
+        pg_fatal("could not open output file \"%s\": %m", output_path);
+
+    /* Map the input; it is read once, front to back. */
+    if ((fd = open(input_path, O_RDONLY | PG_BINARY, 0)) < 0)
+        pg_fatal("could not open input file \"%s\": %m", input_path);
+    if (fstat(fd, &st) < 0)
+        pg_fatal("could not stat input file \"%s\": %m", input_path);
+    if (!S_ISREG(st.st_mode))
+        pg_fatal("input file \"%s\" is not a regular file", input_path);
+
+    data_size = st.st_size;
+    if (data_size > 0)
+    {
+        void       *map = mmap(NULL, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (map == MAP_FAILED)
+            pg_fatal("could not map input file \"%s\": %m", input_path);
+        (void) madvise(map, data_size, MADV_SEQUENTIAL);
+        data = map;
+    }
+    close(fd);
+
+    nchunks = (data_size + AUDIT_CHUNK_SIZE - 1) / AUDIT_CHUNK_SIZE;
+    if ((size_t) njobs > nchunks)
+        njobs = Max(nchunks, 1);
+    chunks = pg_malloc0(Max(nchunks, 1) * sizeof(AuditChunk));
+    workers = pg_malloc0(njobs * sizeof(AuditWorker));
+
+    /* Deal the chunks round-robin: worker i gets chunks i, i + njobs, ... */
+    for (i = 0; i < njobs; i++)
+    {
+        workers[i].id = i;
+        workers[i].head = 0;
+        workers[i].tail = (nchunks > (size_t) i) ? (nchunks - i + njobs - 1) / njobs : 0;
+        pthread_mutex_init(&workers[i].lock, NULL);
+    }
+
+    for (i = 0; i < njobs; i++)
+    {
+        errno = pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+        if (errno != 0)
+            pg_fatal("could not create thread: %m");
+    }
+    for (i = 0; i < njobs; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        failed += workers[i].failed;
+        errors += workers[i].errors;
+    }
+
+    if (summary_only)
+        print_summary();
+    if (fflush(output) != 0 || (output != stdout && fclose(output) != 0))
+        pg_fatal("could not write verdicts: %m");
+
+    pgguard_policy_free(policy);
+
+    if (errors > 0)
+        return 1;
+    return failed > 0 ? 2 : 0;
+}
@@ -0,0 +1,1028 @@
+/*
+ * policy.c
+ *
+ * Rule evaluation for pg_passwordguard.
+ *
+ * A policy (PggPolicy) is just the set of rule settings. Checking a password against it is split in
+ * two: the analysis stages (character classes, dictionary lookups, model scores) fill in a PggCheck,
+ * and each policy then only compares those results with its thresholds. Stages run lazily, the
+ * first time some policy needs them, so evaluating a second policy (the shadow policy, or several
+ * candidate policies in a simulation) costs little more than a few comparisons. The cheap stages
+ * all read one analysis of the password (analysis.c), made in a single pass, rather than each
+ * scanning and lowercasing it again.
+ *
+ * The model-based stages are the expensive ones. Before each of them the elapsed time is compared
+ * with max_check_time_ms and pending interrupts are serviced; once the budget is used up the
+ * remaining expensive stages are skipped, and the rules depending on them are reported as skipped.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#include <limits.h>
+
+#ifndef FRONTEND
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "utils/guc.h"
+#endif
+
+#include "passwordguard.h"
+
+/* Analysis stages (PggCheck.done etc.). */
+#define PGG_STAGE_ANALYSIS      0x0001
+#define PGG_STAGE_USERNAME      0x0002
+#define PGG_STAGE_COMMON        0x0004
+#define PGG_STAGE_ROLENAMES     0x0008
+#define PGG_STAGE_DATES         0x0010
+#define PGG_STAGE_MARKOV        0x0020
+#define PGG_STAGE_GUESSES       0x0040
+#define PGG_STAGE_PCFG          0x0080
+#define PGG_STAGE_NEURAL        0x0100
+#define PGG_STAGE_REUSE         0x0200
+#define PGG_STAGE_SKELETON      0x0400
+#define PGG_STAGE_COMMON_INDEX  0x0800
+#define PGG_STAGE_DICTIONARY    0x1000
+#define PGG_STAGE_CRACKLIB      0x2000
+
+/* Rule names, as reported in the stats views; each rule is named after the GUC that enables it. */
+const char *const pgg_rule_names[PGG_NUM_RULES] = {
+    "min_length",
+    "require_upper",
+    "require_lower",
+    "require_digit",
+    "require_special",
+    "reject_username",
+    "reject_common",
+    "reject_rolenames",
+    "date_patterns",
+    "min_markov_bits",
+    "min_guesses_log10",
+    "min_pcfg_bits",
+    "max_neural_score",
+    "reject_reuse",
+    "max_common_fraction",
+    "reject_dictionary",
+    "reject_cracklib"
+};
+
+static const struct config_enum_entry date_patterns_options[] = {
+    {"off", PGG_DATE_PATTERNS_OFF, false},
+    {"discount", PGG_DATE_PATTERNS_DISCOUNT, false},
+    {"reject", PGG_DATE_PATTERNS_REJECT, false},
+    {NULL, 0, false}
+};
+
+#define SETTING(field, type)    PGG_SETTING_##type, offsetof(PggPolicy, field)
+
+const PggPolicySetting pgg_policy_settings[] = {
+    {"min_length", "Minimum allowed password length.", NULL,
+     SETTING(min_length, INT), 12, 0, INT_MAX, NULL},
+    {"require_upper", "Require at least one uppercase letter in passwords.", NULL,
+     SETTING(require_upper, BOOL), true, 0, 0, NULL},
+    {"require_lower", "Require at least one lowercase letter in passwords.", NULL,
+     SETTING(require_lower, BOOL), true, 0, 0, NULL},
+    {"require_digit", "Require at least one digit in passwords.", NULL,
+     SETTING(require_digit, BOOL), true, 0, 0, NULL},
+    {"require_special", "Require at least one special (non-alphanumeric) character in passwords.", NULL,
+     SETTING(require_special, BOOL), true, 0, 0, NULL},
+    {"reject_username", "Reject passwords that contain the username (case-insensitive).", NULL,
+     SETTING(reject_username, BOOL), true, 0, 0, NULL},
+    {"reject_common", "Reject passwords found on the built-in common-password list (case-insensitive).", NULL,
+     SETTING(reject_common, BOOL), true, 0, 0, NULL},
+    {"reject_rolenames", "Reject passwords that contain the name of any other role (case-insensitive).",
+     "Role names shorter than 4 characters are ignored.",
+     SETTING(reject_rolenames, BOOL), false, 0, 0, NULL},
+    {"date_patterns", "How to treat dates and years embedded in passwords (off, discount, reject).",
+     "\"discount\" counts date characters as pg_passwordguard.date_char_weight characters toward min_length; "
+     "\"reject\" rejects any password containing a date or year.",
+     SETTING(date_patterns, ENUM), PGG_DATE_PATTERNS_OFF, 0, 0, date_patterns_options},
+    {"date_char_weight", "Weight of each date or year character toward min_length when date_patterns is \"discount\".", NULL,
+     SETTING(date_char_weight, REAL), 0.0, 0.0, 1.0, NULL},
+    {"min_markov_bits", "Minimum score (in bits) of a password under the Markov model; 0 disables the check.",
+     "Requires pg_passwordguard.markov_model.",
+     SETTING(min_markov_bits, INT), 0, 0, 1000, NULL},
+    {"min_guesses_log10", "Minimum estimated number of guesses (as a power of 10) under the Markov model; 0 disables the check.",
+     "Requires pg_passwordguard.markov_model and pg_passwordguard.guess_table.",
+     SETTING(min_guesses_log10, REAL), 0.0, 0.0, 300.0, NULL},
+    {"min_pcfg_bits", "Minimum score (in bits) of a password under the PCFG structure model; 0 disables the check.",
+     "Requires pg_passwordguard.pcfg_model.",
+     SETTING(min_pcfg_bits, INT), 0, 0, 1000, NULL},
+    {"max_neural_score", "Maximum weakness score (0..1) a password may get from the neural model; 1 disables the check.",
+     "Requires pg_passwordguard.neural_model.",
+     SETTING(max_neural_score, REAL), 1.0, 0.0, 1.0, NULL},
+    {"reject_reuse", "Reject passwords that another role already has.",
+     "Requires pg_passwordguard.reuse_max_roles; only passwords set since fingerprinting was turned on are known.",
+     SETTING(reject_reuse, BOOL), false, 0, 0, NULL},
+    {"max_common_fraction", "Maximum fraction (0..1) of a password that a common password it contains may cover; 1 disables the check.",
+     "Requires pg_passwordguard.common_index.",
+     SETTING(max_common_fraction, REAL), 1.0, 0.0, 1.0, NULL},
+    {"reject_dictionary", "Reject passwords that are within dictionary_edits edits of a dictionary word, ignoring leading and trailing digits and symbols.",
+     "Requires pg_passwordguard.dictionary.",
+     SETTING(reject_dictionary, BOOL), false, 0, 0, NULL},
+    {"dictionary_edits", "Number of edits (insertions, deletions, substitutions) within which reject_dictionary rejects a password.", NULL,
+     SETTING(dictionary_edits, INT), 1, 0, PGG_DICTIONARY_MAX_EDITS, NULL},
+    {"reject_cracklib", "Reject passwords based on a word of a cracklib dictionary, by the rules of cracklib's FascistCheck().",
+     "Requires pg_passwordguard.cracklib_dictionary.",
+     SETTING(reject_cracklib, BOOL), false, 0, 0, NULL}
+};
+
+const int   pgg_num_policy_settings = lengthof(pgg_policy_settings);
+
+#ifndef FRONTEND
+PG_FUNCTION_INFO_V1(pg_passwordguard_policy_export);
+#endif
+
+/*
+ * pgg_policy_set_defaults
+ *
+ * Sets every field to its default (the GUC boot value).
+ */
+void
+pgg_policy_set_defaults(PggPolicy *policy)
+{
+    int         i;
+
+    for (i = 0; i < pgg_num_policy_settings; i++)
+    {
+        const PggPolicySetting *s = &pgg_policy_settings[i];
+        char       *field = (char *) policy + s->offset;
+
+        switch (s->type)
+        {
+            case PGG_SETTING_BOOL:
+                *(bool *) field = (s->boot_value != 0);
+                break;
+            case PGG_SETTING_INT:
+            case PGG_SETTING_ENUM:
+                *(int *) field = (int) s->boot_value;
+                break;
+            case PGG_SETTING_REAL:
+                *(double *) field = s->boot_value;
+                break;
+        }
+    }
+}
+
+/*
+ * pgg_policy_version
+ *
+ * A compact hash of the rule settings, identifying a policy in logs and records: two policies get the
+ * same version exactly when all their settings are equal (barring collisions).
+ */
+uint32
+pgg_policy_version(const PggPolicy *policy)
+{
+    char        buf[lengthof(pgg_policy_settings) * sizeof(double)];
+    Size        len = 0;
+    int         i;
+
+    /* Field by field, so padding never affects the result. */
+    for (i = 0; i < pgg_num_policy_settings; i++)
+    {
+        const PggPolicySetting *s = &pgg_policy_settings[i];
+        const char *field = (const char *) policy + s->offset;
+
+        switch (s->type)
+        {
+            case PGG_SETTING_BOOL:
+                buf[len++] = *(const bool *) field ? 1 : 0;
+                break;
+            case PGG_SETTING_INT:
+            case PGG_SETTING_ENUM:
+                memcpy(buf + len, field, sizeof(int));
+                len += sizeof(int);
+                break;
+            case PGG_SETTING_REAL:
+                memcpy(buf + len, field, sizeof(double));
+                len += sizeof(double);
+                break;
+        }
+    }
+
+    return pgg_hash32(buf, len, 0);
+}
+
+/*
+ * pgg_policy_missing_model
+ *
+ * Returns the name of the first model setting that policy needs but the check settings leave unset,
+ * or NULL. Used by callers that check many passwords and would rather fail once than warn per check.
+ * reject_reuse counts as needing pg_passwordguard.reuse_max_roles, since without fingerprints (the
+ * setting left at 0, or the library not preloaded) it can't be checked either.
+ */
+const char *
+pgg_policy_missing_model(const PggPolicy *policy, const PggCheck *settings)
+{
+    if ((policy->min_markov_bits > 0 || policy->min_guesses_log10 > 0) &&
+        (settings->markov_model == NULL || settings->markov_model[0] == '\0'))
+        return "pg_passwordguard.markov_model";
+    if (policy->min_guesses_log10 > 0 &&
+        (settings->guess_table == NULL || settings->guess_table[0] == '\0'))
+        return "pg_passwordguard.guess_table";
+    if (policy->min_pcfg_bits > 0 &&
+        (settings->pcfg_model == NULL || settings->pcfg_model[0] == '\0'))
+        return "pg_passwordguard.pcfg_model";
+    if (policy->max_neural_score < 1.0 &&
+        (settings->neural_model == NULL || settings->neural_model[0] == '\0'))
+        return "pg_passwordguard.neural_model";
+    if (policy->max_common_fraction < 1.0 &&
+        (settings->common_index == NULL || settings->common_index[0] == '\0'))
+        return "pg_passwordguard.common_index";
+    if (policy->reject_dictionary &&
+        (settings->dictionary == NULL || settings->dictionary[0] == '\0'))
+        return "pg_passwordguard.dictionary";
+    if (policy->reject_cracklib &&
+        (settings->cracklib_dictionary == NULL || settings->cracklib_dictionary[0] == '\0'))
+        return "pg_passwordguard.cracklib_dictionary";
+#ifndef FRONTEND
+    if (policy->reject_reuse && !pgg_reuse_enabled())
+        return "pg_passwordguard.reuse_max_roles";
+#endif
+    return NULL;
+}
+
+/*
+ * stage_allowed
+ *
+ * Called before each expensive stage. Services interrupts, so a cancel is not held up by a slow
+ * stage, and returns false once max_check_time_ms is used up.
+ */
+static bool
+stage_allowed(PggCheck *check)
+{
+    instr_time  elapsed;
+
+    CHECK_FOR_INTERRUPTS();
+
+    if (check->max_check_time_ms <= 0)
+        return true;
+    if (check->budget_exhausted)
+        return false;
+
+    INSTR_TIME_SET_CURRENT(elapsed);
+    INSTR_TIME_SUBTRACT(elapsed, check->start);
+    if (INSTR_TIME_GET_MILLISEC(elapsed) < check->max_check_time_ms)
+        return true;
+
+    check->budget_exhausted = true;
+    ereport(WARNING,
+            (errmsg("pg_passwordguard: max_check_time_ms (%d ms) exceeded; skipping remaining expensive checks",
+                    check->max_check_time_ms)));
+    return false;
+}
+
+/* Microseconds left in the budget (at least 1), or 0 if there is no limit. */
+static int
+budget_remaining_us(const PggCheck *check)
+{
+    instr_time  elapsed;
+    double      remaining;
+
+    if (check->max_check_time_ms <= 0)
+        return 0;
+
+    INSTR_TIME_SET_CURRENT(elapsed);
+    INSTR_TIME_SUBTRACT(elapsed, check->start);
+    remaining = check->max_check_time_ms * 1000.0 - INSTR_TIME_GET_MICROSEC(elapsed);
+    return remaining < 1 ? 1 : (int) remaining;
+}
+
+/*
+ * The skeletons of the password and username, for the name rules. ASCII strings, the usual case, only
+ * need lowercasing, which costs no allocation; see skeleton.c for the others.
+ */
+static void
+stage_skeleton(PggCheck *check)
+{
+    const char *username = check->username;
+
+    if (check->analysis.ascii)
+    {
+        check->skeleton = check->analysis.folded;
+        check->skeleton_len = check->len;
+    }
+    else
+    {
+        check->skeleton_allocated = pgg_skeleton(check->password, check->len, &check->skeleton_len);
+        check->skeleton = check->skeleton_allocated;
+    }
+
+    if (username == NULL)
+        check->user_skeleton = NULL;
+    else
+    {
+        int         ulen = strlen(username);
+        int         user_skeleton_len;
+        int         i;
+
+        for (i = 0; i < ulen && !IS_HIGHBIT_SET(username[i]); i++)
+            ;
+        if (i == ulen && ulen < NAMEDATALEN)
+        {
+            for (i = 0; i < ulen; i++)
+                check->user_folded[i] = (char) pgg_fold_char((unsigned char) username[i]);
+            check->user_folded[ulen] = '\0';
+            check->user_skeleton = check->user_folded;
+        }
+        else
+        {
+            check->user_skeleton_allocated = pgg_skeleton(username, ulen, &user_skeleton_len);
+            check->user_skeleton = check->user_skeleton_allocated;
+        }
+    }
+}
+
+/*
+ * run_stage
+ *
+ * Makes sure the results of a stage are in check. Returns false if they are not available, because
+ * the stage needs a model file that is not configured or because it was skipped for time.
+ */
+static bool
+run_stage(PggCheck *check, uint32 stage)
+{
+    if (check->done & stage)
+        return true;
+    if ((check->unavailable | check->skipped) & stage)
+        return false;
+
+    /* The cheap stages all read the shared analysis; the name rules compare skeletons. */
+    if (stage & (PGG_STAGE_USERNAME | PGG_STAGE_COMMON | PGG_STAGE_ROLENAMES | PGG_STAGE_DATES |
+                 PGG_STAGE_SKELETON | PGG_STAGE_COMMON_INDEX | PGG_STAGE_DICTIONARY |
+                 PGG_STAGE_CRACKLIB))
+        run_stage(check, PGG_STAGE_ANALYSIS);
+    if (stage == PGG_STAGE_USERNAME)
+        run_stage(check, PGG_STAGE_SKELETON);
+
+    switch (stage)
+    {
+        case PGG_STAGE_ANALYSIS:
+            pgg_analyze(check->password, check->len, &check->analysis);
+            break;
+
+        case PGG_STAGE_SKELETON:
+            stage_skeleton(check);
+            break;
+
+        case PGG_STAGE_USERNAME:
+            /* Does the password contain the username, or something that looks like it? */
+            check->contains_username = check->user_skeleton != NULL &&
+                strstr(check->skeleton, check->user_skeleton) != NULL;
+            break;
+
+        case PGG_STAGE_COMMON:
+            check->is_common = pgg_is_common_password(check->analysis.folded, check->len);
+            break;
+
+        case PGG_STAGE_DATES:
+            pgg_scan_dates(check->password, &check->analysis, &check->dates);
+            break;
+
+        case PGG_STAGE_ROLENAMES:
+#ifdef FRONTEND
+            /* Only the server knows the roles. */
+            goto unavailable;
+#else
+            if (!stage_allowed(check))
+                goto skipped;
+            run_stage(check, PGG_STAGE_SKELETON);
+            check->contains_rolename =
+                pgg_contains_other_role_name(check->skeleton, check->skeleton_len,
+                                             check->user_skeleton);
+            break;
+#endif
+
+        case PGG_STAGE_MARKOV:
+            if (check->markov_model == NULL || check->markov_model[0] == '\0')
+            {
+                ereport(WARNING,
+                        (errmsg("pg_passwordguard: Markov checks are enabled but markov_model is not set; skipping")));
+                goto unavailable;
+            }
+            if (!stage_allowed(check))
+                goto skipped;
+            check->markov_bits = pgg_markov_bits(check->markov_model, check->password, check->len);
+            break;
+
+        case PGG_STAGE_GUESSES:
+            /* The guess number is looked up from the Markov score. */
+            if (!run_stage(check, PGG_STAGE_MARKOV))
+            {
+                if (check->skipped & PGG_STAGE_MARKOV)
+                    goto skipped;
+                goto unavailable;
+            }
+            if (check->guess_table == NULL || check->guess_table[0] == '\0')
+            {
+                ereport(WARNING,
+                        (errmsg("pg_passwordguard: min_guesses_log10 is set but guess_table is not; skipping check")));
+                goto unavailable;
+            }
+            check->guesses_log10 = pgg_guess_log10(check->guess_table, pgg_markov_model_size(),
+                                                   check->markov_bits);
+            break;
+
+        case PGG_STAGE_PCFG:
+            if (check->pcfg_model == NULL || check->pcfg_model[0] == '\0')
+            {
+                ereport(WARNING,
+                        (errmsg("pg_passwordguard: min_pcfg_bits is set but pcfg_model is not; skipping check")));
+                goto unavailable;
+            }
+            if (!stage_allowed(check))
+                goto skipped;
+            check->pcfg_bits = pgg_pcfg_bits(check->pcfg_model, check->password, check->len);
+            break;
+
+        case PGG_STAGE_NEURAL:
+            {
+                int         time_budget = check->neural_time_budget;
+                int         remaining;
+
+                if (check->neural_model == NULL || check->neural_model[0] == '\0')
+                {
+                    ereport(WARNING,
+                            (errmsg("pg_passwordguard: max_neural_score is set but neural_model is not; skipping check")));
+                    goto unavailable;
+                }
+                if (!stage_allowed(check))
+                    goto skipped;
+
+                /* The model's own limit, capped by what is left of max_check_time_ms. */
+                remaining = budget_remaining_us(check);
+                if (remaining > 0 && (time_budget == 0 || remaining < time_budget))
+                    time_budget = remaining;
+
+                if (!pgg_neural_score(check->neural_model, check->password, check->len,
+                                      time_budget, &check->neural_score))
+                {
+                    ereport(WARNING,
+                            (errmsg("pg_passwordguard: neural model exceeded its time budget (%d us); skipping check",
+                                    time_budget)));
+                    goto skipped;
+                }
+            }
+            break;
+
+        case PGG_STAGE_REUSE:
+#ifdef FRONTEND
+            /* Only the server has the fingerprints. */
+            goto unavailable;
+#else
+            if (!pgg_reuse_enabled())
+            {
+                ereport(WARNING,
+                        (errmsg("pg_passwordguard: reject_reuse is set but no password fingerprints are kept (reuse_max_roles); skipping check")));
+                goto unavailable;
+            }
+            check->is_reused = pgg_password_reused(check->password, check->len, check->username);
+            break;
+#endif
+
+        case PGG_STAGE_COMMON_INDEX:
+            if (check->common_index == NULL || check->common_index[0] == '\0')
+            {
+                ereport(WARNING,
+                        (errmsg("pg_passwordguard: max_common_fraction is set but common_index is not; skipping check")));
+                goto unavailable;
+            }
+            if (!stage_allowed(check))
+                goto skipped;
+            check->common_len = pgg_longest_common_password(check->common_index,
+                                                            check->analysis.folded, check->len);
+            break;
+
+        case PGG_STAGE_DICTIONARY:
+            if (check->dictionary == NULL || check->dictionary[0] == '\0')
+            {
+                ereport(WARNING,
+                        (errmsg("pg_passwordguard: reject_dictionary is set but dictionary is not; skipping check")));
+                goto unavailable;
+            }
+            if (!stage_allowed(check))
+                goto skipped;
+            check->dictionary_distance = pgg_dictionary_distance(check->dictionary,
+                                                                 check->analysis.folded, check->len);
+            break;
+
+        case PGG_STAGE_CRACKLIB:
+            if (check->cracklib_dictionary == NULL || check->cracklib_dictionary[0] == '\0')
+            {
+                ereport(WARNING,
+                        (errmsg("pg_passwordguard: reject_cracklib is set but cracklib_dictionary is not; skipping check")));
+                goto unavailable;
+            }
+            if (!stage_allowed(check))
+                goto skipped;
+            check->cracklib_match = pgg_cracklib_match(check->cracklib_dictionary,
+                                                       check->analysis.folded, check->len);
+            break;
+    }
+
+    check->done |= stage;
+    return true;
+
+unavailable:
+    check->unavailable |= stage;
+    return false;
+
+skipped:
+    check->skipped |= stage;
+    return false;
+}
+
+/*
+ * Records a violated rule; returns true if evaluation should stop here.
+ */
+static inline bool
+violate(PggVerdict *verdict, PggRule rule, bool stop_at_first)
+{
+    verdict->violated |= PGG_RULE_BIT(rule);
+    return stop_at_first;
+}
+
+/*
+ * Runs the stage a rule needs. Returns false (and records the rule as skipped if the stage was
+ * skipped for time) if the rule can't be evaluated.
+ */
+static bool
+rule_stage(PggCheck *check, uint32 stage, PggVerdict *verdict, PggRule rule)
+{
+    if (run_stage(check, stage))
+        return true;
+    if (check->skipped & stage)
+        verdict->skipped |= PGG_RULE_BIT(rule);
+    return false;
+}
+
+/*
+ * pgg_policy_evaluate
+ *
+ * Evaluates every enabled rule of policy, in order, and sets the violated and skipped rule bits. A
+ * password that is too short is not checked further, as before; with stop_at_first, evaluation also
+ * ends at the first violation, which avoids running expensive stages for a password that is rejected
+ * anyway.
+ */
+void
+pgg_policy_evaluate(const PggPolicy *policy, PggCheck *check, bool stop_at_first, PggVerdict *verdict)
+{
+    verdict->violated = 0;
+    verdict->skipped = 0;
+
+    if (check->len < policy->min_length)
+    {
+        violate(verdict, PGG_RULE_MIN_LENGTH, true);
+        return;
+    }
+
+    if (policy->require_upper || policy->require_lower || policy->require_digit ||
+        policy->require_special)
+        run_stage(check, PGG_STAGE_ANALYSIS);
+    if (policy->require_upper && check->analysis.nupper == 0 &&
+        violate(verdict, PGG_RULE_REQUIRE_UPPER, stop_at_first))
+        return;
+    if (policy->require_lower && check->analysis.nlower == 0 &&
+        violate(verdict, PGG_RULE_REQUIRE_LOWER, stop_at_first))
+        return;
+    if (policy->require_digit && check->analysis.ndigit == 0 &&
+        violate(verdict, PGG_RULE_REQUIRE_DIGIT, stop_at_first))
+        return;
+    if (policy->require_special && check->analysis.nspecial == 0 &&
+        violate(verdict, PGG_RULE_REQUIRE_SPECIAL, stop_at_first))
+        return;
+
+    if (policy->reject_username && run_stage(check, PGG_STAGE_USERNAME) &&
+        check->contains_username &&
+        violate(verdict, PGG_RULE_REJECT_USERNAME, stop_at_first))
+        return;
+
+    if (policy->reject_common && run_stage(check, PGG_STAGE_COMMON) &&
+        check->is_common &&
+        violate(verdict, PGG_RULE_REJECT_COMMON, stop_at_first))
+        return;
+
+    if (policy->reject_rolenames &&
+        rule_stage(check, PGG_STAGE_ROLENAMES, verdict, PGG_RULE_REJECT_ROLENAMES) &&
+        check->contains_rolename &&
+        violate(verdict, PGG_RULE_REJECT_ROLENAMES, stop_at_first))
+        return;
+
+    if (policy->date_patterns != PGG_DATE_PATTERNS_OFF && run_stage(check, PGG_STAGE_DATES) &&
+        check->dates.kinds != 0)
+    {
+        bool        violated;
+
+        if (policy->date_patterns == PGG_DATE_PATTERNS_REJECT)
+            violated = true;
+        else
+            violated = (check->len - check->dates.covered) +
+                check->dates.covered * policy->date_char_weight < policy->min_length;
+
+        if (violated && violate(verdict, PGG_RULE_DATE_PATTERNS, stop_at_first))
+            return;
+    }
+
+    if (policy->min_markov_bits > 0 &&
+        rule_stage(check, PGG_STAGE_MARKOV, verdict, PGG_RULE_MARKOV) &&
+        check->markov_bits < policy->min_markov_bits &&
+        violate(verdict, PGG_RULE_MARKOV, stop_at_first))
+        return;
+
+    if (policy->min_guesses_log10 > 0 &&
+        rule_stage(check, PGG_STAGE_GUESSES, verdict, PGG_RULE_GUESSES) &&
+        check->guesses_log10 < policy->min_guesses_log10 &&
+        violate(verdict, PGG_RULE_GUESSES, stop_at_first))
+        return;
+
+    if (policy->min_pcfg_bits > 0 &&
+        rule_stage(check, PGG_STAGE_PCFG, verdict, PGG_RULE_PCFG) &&
+        check->pcfg_bits < policy->min_pcfg_bits &&
+        violate(verdict, PGG_RULE_PCFG, stop_at_first))
+        return;
+
+    if (policy->max_neural_score < 1.0 &&
+        rule_stage(check, PGG_STAGE_NEURAL, verdict, PGG_RULE_NEURAL) &&
+        check->neural_score > policy->max_neural_score &&
+        violate(verdict, PGG_RULE_NEURAL, stop_at_first))
+        return;
+
+    if (policy->reject_reuse && run_stage(check, PGG_STAGE_REUSE) &&
+        check->is_reused &&
+        violate(verdict, PGG_RULE_REJECT_REUSE, stop_at_first))
+        return;
+
+    if (policy->max_common_fraction < 1.0 &&
+        rule_stage(check, PGG_STAGE_COMMON_INDEX, verdict, PGG_RULE_COMMON_FRACTION) &&
+        check->common_len > policy->max_common_fraction * check->len &&
+        violate(verdict, PGG_RULE_COMMON_FRACTION, stop_at_first))
+        return;
+
+    if (policy->reject_dictionary &&
+        rule_stage(check, PGG_STAGE_DICTIONARY, verdict, PGG_RULE_REJECT_DICTIONARY) &&
+        check->dictionary_distance >= 0 && check->dictionary_distance <= policy->dictionary_edits &&
+        violate(verdict, PGG_RULE_REJECT_DICTIONARY, stop_at_first))
+        return;
+
+    if (policy->reject_cracklib &&
+        rule_stage(check, PGG_STAGE_CRACKLIB, verdict, PGG_RULE_REJECT_CRACKLIB) &&
+        check->cracklib_match != PGG_CRACKLIB_NONE)
+        violate(verdict, PGG_RULE_REJECT_CRACKLIB, stop_at_first);
+}
+
+/*
+ * pgg_check_end
+ *
+ * Releases what the stages of check allocated, wiping the copies of the password. Call once done
+ * evaluating policies against it.
+ */
+void
+pgg_check_end(PggCheck *check)
+{
+    pgg_analysis_free(&check->analysis);
+    if (check->skeleton_allocated != NULL)
+    {
+        explicit_bzero(check->skeleton_allocated, check->skeleton_len);
+        pfree(check->skeleton_allocated);
+    }
+    if (check->user_skeleton_allocated != NULL)
+        pfree(check->user_skeleton_allocated);
+    check->skeleton = check->skeleton_allocated = NULL;
+    check->user_skeleton = check->user_skeleton_allocated = NULL;
+    check->done &= ~(PGG_STAGE_ANALYSIS | PGG_STAGE_SKELETON);
+}
+
+/*
+ * pgg_policy_export
+ *
+ * Writes policy to buf (PGG_POLICY_EXPORT_MAX_SIZE bytes) in the exported format and returns its
+ * size: the usual magic string and byte order mark, the policy version, the number of settings, then
+ * each setting as its name (a length byte and the characters) and its value as a double. Settings
+ * are identified by name, so a client library from another release reads the ones it knows.
+ */
+Size
+pgg_policy_export(const PggPolicy *policy, char *buf)
+{
+    uint32      byte_order = PGG_BYTE_ORDER_MARK;
+    uint32      version = pgg_policy_version(policy);
+    uint32      nsettings = pgg_num_policy_settings;
+    Size        len = 0;
+    int         i;
+
+    memcpy(buf, PGG_POLICY_EXPORT_MAGIC, PGG_MAGIC_LEN);
+    len += PGG_MAGIC_LEN;
+    memcpy(buf + len, &byte_order, sizeof(uint32));
+    len += sizeof(uint32);
+    memcpy(buf + len, &version, sizeof(uint32));
+    len += sizeof(uint32);
+    memcpy(buf + len, &nsettings, sizeof(uint32));
+    len += sizeof(uint32);
+
+    for (i = 0; i < pgg_num_policy_settings; i++)
+    {
+        const PggPolicySetting *s = &pgg_policy_settings[i];
+        const char *field = (const char *) policy + s->offset;
+        uint8       namelen = (uint8) strlen(s->name);
+        double      value = 0;
+
+        switch (s->type)
+        {
+            case PGG_SETTING_BOOL:
+                value = *(const bool *) field ? 1 : 0;
+                break;
+            case PGG_SETTING_INT:
+            case PGG_SETTING_ENUM:
+                value = *(const int *) field;
+                break;
+            case PGG_SETTING_REAL:
+                value = *(const double *) field;
+                break;
+        }
+
+        Assert(len + 1 + namelen + sizeof(double) <= PGG_POLICY_EXPORT_MAX_SIZE);
+        buf[len++] = (char) namelen;
+        memcpy(buf + len, s->name, namelen);
+        len += namelen;
+        memcpy(buf + len, &value, sizeof(double));
+        len += sizeof(double);
+    }
+
+    return len;
+}
+
+static void
+import_error(const char *detail)
+{
+    ereport(ERROR,
+            (errcode(ERRCODE_DATA_CORRUPTED),
+             errmsg("pg_passwordguard: invalid exported policy"),
+             errdetail("%s", detail)));
+}
+
+/*
+ * pgg_policy_import
+ *
+ * Reads a policy written by pgg_policy_export. Settings it doesn't know are ignored, and those it
+ * doesn't find keep their defaults.
+ */
+void
+pgg_policy_import(const char *data, Size size, PggPolicy *policy)
+{
+    uint32      byte_order;
+    uint32      version;
+    uint32      nsettings;
+    bool        complete = true;
+    Size        pos;
+    uint32      n;
+
+    if (size < PGG_MAGIC_LEN + 3 * sizeof(uint32) ||
+        memcmp(data, PGG_POLICY_EXPORT_MAGIC, PGG_MAGIC_LEN) != 0)
+        import_error("The data does not start with an exported policy header.");
+
+    pos = PGG_MAGIC_LEN;
+    memcpy(&byte_order, data + pos, sizeof(uint32));
+    pos += sizeof(uint32);
+    if (byte_order != PGG_BYTE_ORDER_MARK)
+        import_error("The policy was exported by a server with a different byte order.");
+    memcpy(&version, data + pos, sizeof(uint32));
+    pos += sizeof(uint32);
+    memcpy(&nsettings, data + pos, sizeof(uint32));
+    pos += sizeof(uint32);
+
+    pgg_policy_set_defaults(policy);
+
+    for (n = 0; n < nsettings; n++)
+    {
+        const PggPolicySetting *s = NULL;
+        uint8       namelen;
+        double      value;
+        char       *field;
+        int         i;
+
+        if (pos >= size || size - pos < 1 + (Size) (uint8) data[pos] + sizeof(double))
+            import_error("The data ends in the middle of a setting.");
+        namelen = (uint8) data[pos++];
+
+        for (i = 0; i < pgg_num_policy_settings; i++)
+        {
+            if (strlen(pgg_policy_settings[i].name) == namelen &&
+                memcmp(pgg_policy_settings[i].name, data + pos, namelen) == 0)
+                s = &pgg_policy_settings[i];
+        }
+        pos += namelen;
+        memcpy(&value, data + pos, sizeof(double));
+        pos += sizeof(double);
+
+        if (s == NULL)
+        {
+            complete = false;
+            continue;
+        }
+
+        field = (char *) policy + s->offset;
+        switch (s->type)
+        {
+            case PGG_SETTING_BOOL:
+                *(bool *) field = (value != 0);
+                break;
+            case PGG_SETTING_INT:
+                if (value < s->min_value || value > s->max_value)
+                    import_error("A setting is out of range.");
+                *(int *) field = (int) value;
+                break;
+            case PGG_SETTING_ENUM:
+                {
+                    const struct config_enum_entry *option;
+
+                    for (option = s->options; option->name; option++)
+                    {
+                        if (option->val == value)
+                            break;
+                    }
+                    if (option->name == NULL)
+                        import_error("A setting has an unknown value.");
+                    *(int *) field = option->val;
+                }
+                break;
+            case PGG_SETTING_REAL:
+                if (!(value >= s->min_value && value <= s->max_value))
+                    import_error("A setting is out of range.");
+                *(double *) field = value;
+                break;
+        }
+    }
+
+    if (pos != size)
+        import_error("There is data after the last setting.");
+
+    /* With every setting read, the policy must be the one that was exported. */
+    if (complete && nsettings == (uint32) pgg_num_policy_settings &&
+        pgg_policy_version(policy) != version)
+        import_error("The policy version does not match the settings.");
+}
+
+#ifndef FRONTEND
+
+/*
+ * report_violation
+ *
+ * Raises the ERROR for a violated rule or, in log-only mode, logs a WARNING with the measured value.
+ */
+static void
+report_violation(PggRule rule, const PggPolicy *policy, const PggCheck *check, bool log_only)
+{
+    char       *message = NULL;     /* for the log-only WARNING */
+    char       *detail = NULL;      /* for the ERROR */
+
+    switch (rule)
+    {
+        case PGG_RULE_MIN_LENGTH:
+            message = psprintf("password too short (len=%d, min=%d)", check->len, policy->min_length);
+            detail = psprintf("Password must be at least %d characters long.", policy->min_length);
+            break;
+        case PGG_RULE_REQUIRE_UPPER:
+            message = "missing uppercase letter";
+            detail = "Password must contain at least one uppercase letter.";
+            break;
+        case PGG_RULE_REQUIRE_LOWER:
+            message = "missing lowercase letter";
+            detail = "Password must contain at least one lowercase letter.";
+            break;
+        case PGG_RULE_REQUIRE_DIGIT:
+            message = "missing digit";
+            detail = "Password must contain at least one digit.";
+            break;
+        case PGG_RULE_REQUIRE_SPECIAL:
+            message = "missing special character";
+            detail = "Password must contain at least one special character.";
+            break;
+        case PGG_RULE_REJECT_USERNAME:
+            message = "password contains username";
+            detail = "Password must not contain the username.";
+            break;
+        case PGG_RULE_REJECT_COMMON:
+            message = "password is a commonly used password";
+            detail = "Password must not be a commonly used password.";
+            break;
+        case PGG_RULE_REJECT_ROLENAMES:
+            message = "password contains the name of another role";
+            detail = "Password must not contain the name of another role.";
+            break;
+        case PGG_RULE_DATE_PATTERNS:
+            if (policy->date_patterns == PGG_DATE_PATTERNS_REJECT)
+            {
+                message = "password contains a date or year";
+                detail = "Password must not contain a date or year.";
+            }
+            else
+            {
+                message = psprintf("password too short once dates are discounted (len=%d, dates=%d, min=%d)",
+                                   check->len, check->dates.covered, policy->min_length);
+                detail = psprintf("Password must be at least %d characters long, not counting dates or years.",
+                                  policy->min_length);
+            }
+            break;
+        case PGG_RULE_MARKOV:
+            message = psprintf("password too predictable (markov bits=%.1f, min=%d)",
+                               check->markov_bits, policy->min_markov_bits);
+            detail = "Password is too predictable.";
+            break;
+        case PGG_RULE_GUESSES:
+            message = psprintf("password too easy to guess (about 10^%.1f guesses, min=10^%.1f)",
+                               check->guesses_log10, policy->min_guesses_log10);
+            detail = psprintf("Password would be guessed in fewer than 10^%g attempts.",
+                              policy->min_guesses_log10);
+            break;
+        case PGG_RULE_PCFG:
+            message = psprintf("password structure too common (pcfg bits=%.1f, min=%d)",
+                               check->pcfg_bits, policy->min_pcfg_bits);
+            detail = "Password follows a common structure and is too easy to guess.";
+            break;
+        case PGG_RULE_NEURAL:
+            message = psprintf("password looks weak to the neural model (score=%.3f, max=%.3f)",
+                               check->neural_score, policy->max_neural_score);
+            detail = "Password resembles known weak passwords.";
+            break;
+        case PGG_RULE_REJECT_REUSE:
+            message = "password is already used by another role";
+            detail = "Password must not be the same as the password of another role.";
+            break;
+        case PGG_RULE_COMMON_FRACTION:
+            message = psprintf("password is mostly a common password (common part=%d of %d characters, max=%.2f)",
+                               check->common_len, check->len, policy->max_common_fraction);
+            detail = "Password must not be built around a commonly used password.";
+            break;
+        case PGG_RULE_REJECT_DICTIONARY:
+            if (check->dictionary_distance == 0)
+                message = "password is a dictionary word";
+            else
+                message = psprintf("password is %d edit(s) away from a dictionary word (max=%d)",
+                                   check->dictionary_distance, policy->dictionary_edits);
+            detail = "Password must not be a dictionary word or a slight variation of one.";
+            break;
+        case PGG_RULE_REJECT_CRACKLIB:
+            if (check->cracklib_match == PGG_CRACKLIB_REVERSED)
+                message = "password is based on a reversed dictionary word";
+            else
+                message = "password is based on a dictionary word";
+            detail = "Password must not be based on a dictionary word.";
+            break;
+    }
+
+    if (log_only)
+        ereport(WARNING,
+                (errmsg("pg_passwordguard: %s", message)));
+    else
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("password does not meet complexity requirements"),
+                 errdetail("%s", detail)));
+}
+
+/*
+ * pgg_policy_report
+ *
+ * Reports the violations in verdict for the enforced policy: an ERROR for the first one, or a WARNING
+ * for each of them in log-only mode, as far as pg_passwordguard.log_only_max_warnings allows.
+ */
+void
+pgg_policy_report(const PggPolicy *policy, const PggCheck *check, const PggVerdict *verdict,
+                  bool log_only)
+{
+    int         rule;
+
+    for (rule = 0; rule < PGG_NUM_RULES; rule++)
+    {
+        if (!(verdict->violated & PGG_RULE_BIT(rule)))
+            continue;
+
+        /* Over the warning rate limit, the violation is only counted for the next summary. */
+        if (log_only && !pgg_warning_allowed(check->username, (PggRule) rule))
+            continue;
+
+        report_violation((PggRule) rule, policy, check, log_only);
+    }
+}
+
+/*
+ * pg_passwordguard_policy_export()
+ *
+ * The enforced policy in the exported format, for the client library.
+ */
+Datum
+pg_passwordguard_policy_export(PG_FUNCTION_ARGS)
+{
+    bytea      *result = palloc(VARHDRSZ + PGG_POLICY_EXPORT_MAX_SIZE);
+    Size        len;
+
+    len = pgg_policy_export(pgg_enforced_policy(), VARDATA(result));
+    SET_VARSIZE(result, VARHDRSZ + len);
+    PG_RETURN_BYTEA_P(result);
+}
+
+#endif                          /* !FRONTEND */
@@ -0,0 +1,707 @@
+/*
+ * reuse.c
+ *
+ * Cross-role password reuse (pg_passwordguard.reject_reuse): rejects a password that another role
+ * already has.
+ *
+ * The stored SCRAM secrets can't be compared with a new password short of one PBKDF2 run per role, so
+ * every password accepted while fingerprinting is on (pg_passwordguard.reuse_max_roles) leaves a
+ * fingerprint instead: HMAC-SHA256 of the password under a secret key, which is useless for guessing
+ * without the key. The key comes from pg_passwordguard.reuse_key_file, or is drawn at server start;
+ * either way it is only held in shared memory. Fingerprints are kept in two shared hash tables, one
+ * by role and one by fingerprint (with the number of roles that have it), so checking a password is
+ * one HMAC and one lookup.
+ *
+ * The fingerprint follows the password through the transaction: the check hook computes it, the
+ * object access hook attaches it to the role the statement creates or alters, and the hash tables are
+ * updated at commit. A pre-hashed password can't be fingerprinted, so setting one forgets the role's
+ * fingerprint; dropping the role does too. Removing a role's password (PASSWORD NULL, or renaming a
+ * role with an MD5 password) doesn't go through the check hook, so every other change to a role is
+ * looked at before commit, and a role left without a password loses its fingerprint.
+ *
+ * With a key file, the fingerprints are saved to pg_passwordguard_reuse.dat in the data directory at
+ * shutdown and read back at startup (like pg_stat_statements, the file is removed once read, so after
+ * a crash they are lost). With a random key they would be useless after a restart and are not saved.
+ *
+ * Needs shared memory, so the library must be loaded through shared_preload_libraries.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres.h"
+
+#include <unistd.h>
+
+#include "access/xact.h"
+#include "catalog/objectaccess.h"
+#include "catalog/pg_authid.h"
+#include "catalog/pg_type.h"
+#include "common/cryptohash.h"
+#include "common/hmac.h"
+#include "common/sha2.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/pg_list.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/acl.h"
+#include "utils/array.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+
+#include "passwordguard.h"
+
+#define REUSE_FINGERPRINT_LEN   PG_SHA256_DIGEST_LENGTH
+#define REUSE_KEY_MIN           32
+#define REUSE_KEY_MAX           256
+
+#define REUSE_DUMP_FILE         "pg_passwordguard_reuse.dat"
+#define REUSE_DUMP_MAGIC        "PGGREUSE"
+
+typedef struct ReuseFingerprint
+{
+    uint8       bytes[REUSE_FINGERPRINT_LEN];
+} ReuseFingerprint;
+
+typedef struct ReuseRoleEntry
+{
+    Oid         roleid;
+    ReuseFingerprint fingerprint;
+} ReuseRoleEntry;
+
+typedef struct ReuseFingerprintEntry
+{
+    ReuseFingerprint fingerprint;
+    int         nroles;
+} ReuseFingerprintEntry;
+
+typedef struct PggReuseShared
+{
+    LWLock     *lock;           /* protects both hash tables */
+    int         keylen;
+    uint8       key[REUSE_KEY_MAX];
+} PggReuseShared;
+
+/* A fingerprint change made by the current transaction, applied at commit. */
+typedef struct ReuseChange
+{
+    Oid         roleid;
+    SubTransactionId subid;
+    bool        known;          /* false: forget the role's fingerprint */
+    bool        recheck;        /* forget it only if the role has no password at commit */
+    ReuseFingerprint fingerprint;
+} ReuseChange;
+
+static PggReuseShared *pgg_reuse = NULL;
+static HTAB *reuse_by_role = NULL;
+static HTAB *reuse_by_fingerprint = NULL;
+
+/* The password the check hook saw last, until the statement that set it picks it up. */
+static bool reuse_next_pending = false;
+static bool reuse_next_known;
+static ReuseFingerprint reuse_next;
+
+/* ReuseChange list, in TopTransactionContext. */
+static List *reuse_changes = NIL;
+
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+static object_access_hook_type prev_object_access_hook = NULL;
+
+PG_FUNCTION_INFO_V1(pg_passwordguard_password_reuse);
+
+/* Identifies the key in the dump file, so fingerprints made under another key are not loaded. */
+static uint64
+reuse_key_check(void)
+{
+    return (uint64) pgg_hash32((const char *) pgg_reuse->key, pgg_reuse->keylen, 1) << 32 |
+        pgg_hash32((const char *) pgg_reuse->key, pgg_reuse->keylen, 2);
+}
+
+static Size
+reuse_shmem_size(void)
+{
+    Size        size = MAXALIGN(sizeof(PggReuseShared));
+
+    size = add_size(size, hash_estimate_size(pgg_reuse_max_roles, sizeof(ReuseRoleEntry)));
+    size = add_size(size, hash_estimate_size(pgg_reuse_max_roles, sizeof(ReuseFingerprintEntry)));
+    return size;
+}
+
+static void
+reuse_shmem_request(void)
+{
+    if (prev_shmem_request_hook)
+        prev_shmem_request_hook();
+
+    RequestAddinShmemSpace(reuse_shmem_size());
+    RequestNamedLWLockTranche("pg_passwordguard reuse", 1);
+}
+
+/* Reads the key from pg_passwordguard.reuse_key_file, or draws a random one. */
+static void
+reuse_load_key(void)
+{
+    FILE       *file;
+    size_t      n;
+
+    if (pgg_reuse_key_file == NULL || pgg_reuse_key_file[0] == '\0')
+    {
+        if (!pg_strong_random(pgg_reuse->key, REUSE_KEY_MIN))
+            ereport(FATAL,
+                    (errmsg("pg_passwordguard: could not generate a random password fingerprint key")));
+        pgg_reuse->keylen = REUSE_KEY_MIN;
+        return;
+    }
+
+    file = AllocateFile(pgg_reuse_key_file, PG_BINARY_R);
+    if (file == NULL)
+        ereport(FATAL,
+                (errcode_for_file_access(),
+                 errmsg("pg_passwordguard: could not open reuse key file \"%s\": %m", pgg_reuse_key_file)));
+
+    /* A key of REUSE_KEY_MAX bytes must be the whole file. */
+    n = fread(pgg_reuse->key, 1, REUSE_KEY_MAX, file);
+    if (ferror(file))
+        ereport(FATAL,
+                (errcode_for_file_access(),
+                 errmsg("pg_passwordguard: could not read reuse key file \"%s\": %m", pgg_reuse_key_file)));
+    if (n < REUSE_KEY_MIN || (n == REUSE_KEY_MAX && fgetc(file) != EOF))
+        ereport(FATAL,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("pg_passwordguard: reuse key file \"%s\" must hold %d to %d bytes",
+                        pgg_reuse_key_file, REUSE_KEY_MIN, REUSE_KEY_MAX)));
+    FreeFile(file);
+
+    pgg_reuse->keylen = (int) n;
+}
+
+/* Counts one more role with fingerprint; false if the table is full. */
+static bool
+fingerprint_add(const ReuseFingerprint *fingerprint)
+{
+    ReuseFingerprintEntry *entry;
+    bool        found;
+
+    entry = hash_search(reuse_by_fingerprint, fingerprint, HASH_ENTER_NULL, &found);
+    if (entry == NULL)
+        return false;
+    if (!found)
+        entry->nroles = 0;
+    entry->nroles++;
+    return true;
+}
+
+static void
+fingerprint_remove(const ReuseFingerprint *fingerprint)
+{
+    ReuseFingerprintEntry *entry;
+
+    entry = hash_search(reuse_by_fingerprint, fingerprint, HASH_FIND, NULL);
+    if (entry != NULL && --entry->nroles <= 0)
+        hash_search(reuse_by_fingerprint, fingerprint, HASH_REMOVE, NULL);
+}
+
+/*
+ * Sets the fingerprint of role roleid, or forgets it if fingerprint is NULL. Caller holds the lock
+ * exclusively. Never raises an error (this runs at commit): a fingerprint the tables have no room for
+ * is dropped.
+ */
+static void
+reuse_set(Oid roleid, const ReuseFingerprint *fingerprint)
+{
+    ReuseRoleEntry *entry;
+    bool        found;
+
+    entry = hash_search(reuse_by_role, &roleid, fingerprint ? HASH_ENTER_NULL : HASH_FIND, &found);
+    if (entry == NULL)
+        return;
+
+    if (found)
+        fingerprint_remove(&entry->fingerprint);
+
+    if (fingerprint == NULL || !fingerprint_add(fingerprint))
+    {
+        hash_search(reuse_by_role, &roleid, HASH_REMOVE, NULL);
+        return;
+    }
+    entry->fingerprint = *fingerprint;
+}
+
+/* Loads the fingerprints saved at the last shutdown, if they were made with the current key. */
+static void
+reuse_load_dump(void)
+{
+    FILE       *file;
+    char        magic[PGG_MAGIC_LEN];
+    uint32      byte_order;
+    uint64      key_check;
+    uint32      count;
+    uint32      i;
+
+    file = AllocateFile(REUSE_DUMP_FILE, PG_BINARY_R);
+    if (file == NULL)
+    {
+        if (errno != ENOENT)
+            ereport(LOG,
+                    (errcode_for_file_access(),
+                     errmsg("pg_passwordguard: could not read file \"%s\": %m", REUSE_DUMP_FILE)));
+        return;
+    }
+
+    if (fread(magic, 1, PGG_MAGIC_LEN, file) != PGG_MAGIC_LEN ||
+        memcmp(magic, REUSE_DUMP_MAGIC, PGG_MAGIC_LEN) != 0 ||
+        fread(&byte_order, sizeof(uint32), 1, file) != 1 || byte_order != PGG_BYTE_ORDER_MARK ||
+        fread(&key_check, sizeof(uint64), 1, file) != 1 ||
+        fread(&count, sizeof(uint32), 1, file) != 1)
+        goto bad_file;
+
+    if (key_check != reuse_key_check())
+    {
+        ereport(LOG,
+                (errmsg("pg_passwordguard: ignoring password fingerprints made with another key")));
+        goto done;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        Oid         roleid;
+        ReuseFingerprint fingerprint;
+
+        if (fread(&roleid, sizeof(Oid), 1, file) != 1 ||
+            fread(&fingerprint, sizeof(ReuseFingerprint), 1, file) != 1)
+            goto bad_file;
+        reuse_set(roleid, &fingerprint);
+    }
+    goto done;
+
+bad_file:
+    ereport(LOG,
+            (errmsg("pg_passwordguard: ignoring invalid file \"%s\"", REUSE_DUMP_FILE)));
+
+done:
+    FreeFile(file);
+    unlink(REUSE_DUMP_FILE);
+}
+
+/* Saves the fingerprints at a clean postmaster shutdown (on_shmem_exit callback). */
+static void
+reuse_shmem_shutdown(int code, Datum arg)
+{
+    FILE       *file;
+    uint32      byte_order = PGG_BYTE_ORDER_MARK;
+    uint64      key_check = reuse_key_check();
+    uint32      count;
+    HASH_SEQ_STATUS status;
+    ReuseRoleEntry *entry;
+
+    if (code != 0 || pgg_reuse == NULL)
+        return;
+
+    file = AllocateFile(REUSE_DUMP_FILE ".tmp", PG_BINARY_W);
+    if (file == NULL)
+        goto error;
+
+    count = (uint32) hash_get_num_entries(reuse_by_role);
+    if (fwrite(REUSE_DUMP_MAGIC, 1, PGG_MAGIC_LEN, file) != PGG_MAGIC_LEN ||
+        fwrite(&byte_order, sizeof(uint32), 1, file) != 1 ||
+        fwrite(&key_check, sizeof(uint64), 1, file) != 1 ||
+        fwrite(&count, sizeof(uint32), 1, file) != 1)
+        goto error;
+
+    hash_seq_init(&status, reuse_by_role);
+    while ((entry = hash_seq_search(&status)) != NULL)
+    {
+        if (fwrite(&entry->roleid, sizeof(Oid), 1, file) != 1 ||
+            fwrite(&entry->fingerprint, sizeof(ReuseFingerprint), 1, file) != 1)
+        {
+            hash_seq_term(&status);
+            goto error;
+        }
+    }
+
+    if (FreeFile(file) != 0)
+    {
+        file = NULL;
+        goto error;
+    }
+
+    (void) durable_rename(REUSE_DUMP_FILE ".tmp", REUSE_DUMP_FILE, LOG);
+    return;
+
+error:
+    ereport(LOG,
+            (errcode_for_file_access(),
+             errmsg("pg_passwordguard: could not write file \"%s\": %m", REUSE_DUMP_FILE ".tmp")));
+    if (file)
+        FreeFile(file);
+    unlink(REUSE_DUMP_FILE ".tmp");
+}
+
+static void
+reuse_shmem_startup(void)
+{
+    HASHCTL     info;
+    bool        found;
+
+    if (prev_shmem_startup_hook)
+        prev_shmem_startup_hook();
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+    pgg_reuse = ShmemInitStruct("pg_passwordguard reuse", sizeof(PggReuseShared), &found);
+
+    info.keysize = sizeof(Oid);
+    info.entrysize = sizeof(ReuseRoleEntry);
+    reuse_by_role = ShmemInitHash("pg_passwordguard reuse by role",
+                                  pgg_reuse_max_roles, pgg_reuse_max_roles,
+                                  &info, HASH_ELEM | HASH_BLOBS | HASH_FIXED_SIZE);
+
+    info.keysize = sizeof(ReuseFingerprint);
+    info.entrysize = sizeof(ReuseFingerprintEntry);
+    reuse_by_fingerprint = ShmemInitHash("pg_passwordguard reuse by fingerprint",
+                                         pgg_reuse_max_roles, pgg_reuse_max_roles,
+                                         &info, HASH_ELEM | HASH_BLOBS | HASH_FIXED_SIZE);
+
+    if (!found)
+    {
+        pgg_reuse->lock = &(GetNamedLWLockTranche("pg_passwordguard reuse"))->lock;
+        reuse_load_key();
+    }
+
+    LWLockRelease(AddinShmemInitLock);
+
+    /* Only the postmaster saves and restores the fingerprints, and only under a key that lasts. */
+    if (!IsUnderPostmaster && pgg_reuse_key_file != NULL && pgg_reuse_key_file[0] != '\0')
+    {
+        on_shmem_exit(reuse_shmem_shutdown, (Datum) 0);
+        if (!found)
+            reuse_load_dump();
+    }
+}
+
+/* Computes the fingerprint of a password. */
+static void
+reuse_fingerprint(const char *password, size_t len, ReuseFingerprint *fingerprint)
+{
+    pg_hmac_ctx *ctx = pg_hmac_create(PG_SHA256);
+
+    if (ctx == NULL)
+        ereport(ERROR,
+                (errcode(ERRCODE_OUT_OF_MEMORY),
+                 errmsg("out of memory")));
+
+    if (pg_hmac_init(ctx, pgg_reuse->key, pgg_reuse->keylen) < 0 ||
+        pg_hmac_update(ctx, (const uint8 *) password, len) < 0 ||
+        pg_hmac_final(ctx, fingerprint->bytes, REUSE_FINGERPRINT_LEN) < 0)
+    {
+        const char *error = pg_hmac_error(ctx);
+
+        pg_hmac_free(ctx);
+        elog(ERROR, "could not compute password fingerprint: %s", error);
+    }
+
+    pg_hmac_free(ctx);
+}
+
+static void
+reuse_object_access(ObjectAccessType access, Oid classId, Oid objectId, int subId, void *arg)
+{
+    ReuseChange *change;
+    MemoryContext oldcontext;
+
+    if (prev_object_access_hook)
+        prev_object_access_hook(access, classId, objectId, subId, arg);
+
+    if (classId != AuthIdRelationId || !IsTransactionState())
+        return;
+    if (access != OAT_POST_ALTER && access != OAT_DROP &&
+        !(reuse_next_pending && access == OAT_POST_CREATE))
+        return;
+
+    oldcontext = MemoryContextSwitchTo(TopTransactionContext);
+    change = palloc(sizeof(ReuseChange));
+    change->roleid = objectId;
+    change->subid = GetCurrentSubTransactionId();
+    change->known = (access != OAT_DROP && reuse_next_pending && reuse_next_known);
+    change->recheck = (access == OAT_POST_ALTER && !reuse_next_pending);
+    if (change->known)
+        change->fingerprint = reuse_next;
+    reuse_changes = lappend(reuse_changes, change);
+    MemoryContextSwitchTo(oldcontext);
+
+    if (access != OAT_DROP)
+        reuse_next_pending = false;
+}
+
+/*
+ * Resolves the changes of roles altered without a password being checked: the role's fingerprint is
+ * forgotten if the role (as left by the transaction) has no password, and kept otherwise.
+ */
+static void
+reuse_resolve_rechecks(void)
+{
+    ListCell   *lc;
+
+    foreach(lc, reuse_changes)
+    {
+        ReuseChange *change = (ReuseChange *) lfirst(lc);
+        HeapTuple   tuple;
+        bool        has_password = false;
+
+        if (!change->recheck)
+            continue;
+
+        tuple = SearchSysCache1(AUTHOID, ObjectIdGetDatum(change->roleid));
+        if (HeapTupleIsValid(tuple))
+        {
+            bool        isnull;
+
+            (void) SysCacheGetAttr(AUTHOID, tuple, Anum_pg_authid_rolpassword, &isnull);
+            has_password = !isnull;
+            ReleaseSysCache(tuple);
+        }
+
+        if (has_password)
+            reuse_changes = foreach_delete_current(reuse_changes, lc);
+        else
+            change->recheck = false;
+    }
+}
+
+/* At commit, the transaction's fingerprint changes reach the hash tables. */
+static void
+reuse_xact_callback(XactEvent event, void *arg)
+{
+    ListCell   *lc;
+
+    /* Still in the transaction: the catalogs can be read. */
+    if (event == XACT_EVENT_PRE_COMMIT && reuse_changes != NIL)
+        reuse_resolve_rechecks();
+
+    if ((event == XACT_EVENT_COMMIT || event == XACT_EVENT_PARALLEL_COMMIT) && reuse_changes != NIL)
+    {
+        LWLockAcquire(pgg_reuse->lock, LW_EXCLUSIVE);
+        foreach(lc, reuse_changes)
+        {
+            ReuseChange *change = (ReuseChange *) lfirst(lc);
+
+            if (!change->recheck)
+                reuse_set(change->roleid, change->known ? &change->fingerprint : NULL);
+        }
+        LWLockRelease(pgg_reuse->lock);
+    }
+
+    if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT ||
+        event == XACT_EVENT_PARALLEL_COMMIT || event == XACT_EVENT_PARALLEL_ABORT ||
+        event == XACT_EVENT_PREPARE)
+    {
+        /* The list itself goes away with TopTransactionContext. */
+        reuse_changes = NIL;
+        reuse_next_pending = false;
+    }
+}
+
+/* Changes made in an aborted subtransaction (or its children, which have later IDs) are dropped. */
+static void
+reuse_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+                       SubTransactionId parentSubid, void *arg)
+{
+    ListCell   *lc;
+
+    if (event != SUBXACT_EVENT_ABORT_SUB)
+        return;
+
+    foreach(lc, reuse_changes)
+    {
+        ReuseChange *change = (ReuseChange *) lfirst(lc);
+
+        if (change->subid >= mySubid)
+            reuse_changes = foreach_delete_current(reuse_changes, lc);
+    }
+    reuse_next_pending = false;
+}
+
+/*
+ * pgg_reuse_init
+ *
+ * Called from _PG_init. Fingerprints are only kept when loaded at server start with
+ * pg_passwordguard.reuse_max_roles set.
+ */
+void
+pgg_reuse_init(void)
+{
+    if (!process_shared_preload_libraries_in_progress || pgg_reuse_max_roles <= 0)
+        return;
+
+    prev_shmem_request_hook = shmem_request_hook;
+    shmem_request_hook = reuse_shmem_request;
+    prev_shmem_startup_hook = shmem_startup_hook;
+    shmem_startup_hook = reuse_shmem_startup;
+    prev_object_access_hook = object_access_hook;
+    object_access_hook = reuse_object_access;
+
+    RegisterXactCallback(reuse_xact_callback, NULL);
+    RegisterSubXactCallback(reuse_subxact_callback, NULL);
+}
+
+/* Are password fingerprints kept? */
+bool
+pgg_reuse_enabled(void)
+{
+    return pgg_reuse != NULL;
+}
+
+/*
+ * pgg_password_reused
+ *
+ * Does a role other than username have this password? Only passwords fingerprinted since
+ * fingerprinting was turned on are known.
+ */
+bool
+pgg_password_reused(const char *password, size_t len, const char *username)
+{
+    ReuseFingerprint fingerprint;
+    ReuseFingerprintEntry *entry;
+    Oid         roleid = InvalidOid;
+    int         others = 0;
+
+    Assert(pgg_reuse_enabled());
+
+    reuse_fingerprint(password, len, &fingerprint);
+    if (username != NULL)
+        roleid = get_role_oid(username, true);
+
+    LWLockAcquire(pgg_reuse->lock, LW_SHARED);
+    entry = hash_search(reuse_by_fingerprint, &fingerprint, HASH_FIND, NULL);
+    if (entry != NULL)
+    {
+        ReuseRoleEntry *own = NULL;
+
+        others = entry->nroles;
+        if (OidIsValid(roleid))
+            own = hash_search(reuse_by_role, &roleid, HASH_FIND, NULL);
+        if (own != NULL && memcmp(&own->fingerprint, &fingerprint, sizeof(ReuseFingerprint)) == 0)
+            others--;
+    }
+    LWLockRelease(pgg_reuse->lock);
+
+    return others > 0;
+}
+
+/*
+ * pgg_reuse_remember
+ *
+ * Called from the check hook for every password set: the statement that sets it records its
+ * fingerprint for the role, or, for a pre-hashed password (password NULL), forgets the role's one.
+ */
+void
+pgg_reuse_remember(const char *password, size_t len)
+{
+    if (!pgg_reuse_enabled())
+        return;
+
+    reuse_next_known = (password != NULL);
+    if (reuse_next_known)
+    {
+        long        nroles;
+
+        reuse_fingerprint(password, len, &reuse_next);
+
+        LWLockAcquire(pgg_reuse->lock, LW_SHARED);
+        nroles = hash_get_num_entries(reuse_by_role);
+        LWLockRelease(pgg_reuse->lock);
+        if (nroles >= pgg_reuse_max_roles)
+            ereport(WARNING,
+                    (errmsg("pg_passwordguard: reuse_max_roles (%d) reached; new passwords may not be fingerprinted",
+                            pgg_reuse_max_roles)));
+    }
+    reuse_next_pending = true;
+}
+
+static int
+reuse_entry_cmp(const void *a, const void *b)
+{
+    const ReuseRoleEntry *ea = (const ReuseRoleEntry *) a;
+    const ReuseRoleEntry *eb = (const ReuseRoleEntry *) b;
+    int         cmp = memcmp(&ea->fingerprint, &eb->fingerprint, sizeof(ReuseFingerprint));
+
+    if (cmp != 0)
+        return cmp;
+    if (ea->roleid != eb->roleid)
+        return ea->roleid < eb->roleid ? -1 : 1;
+    return 0;
+}
+
+/*
+ * pg_passwordguard_password_reuse
+ *
+ * The groups of roles that have the same password, one row each (roles, role_count); the fingerprints
+ * are not shown.
+ */
+Datum
+pg_passwordguard_password_reuse(PG_FUNCTION_ARGS)
+{
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    ReuseRoleEntry *entries;
+    HASH_SEQ_STATUS status;
+    ReuseRoleEntry *entry;
+    int         count = 0;
+    int         start;
+    int         i;
+    int         j;
+
+    if (pgg_reuse == NULL)
+        ereport(ERROR,
+                (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                 errmsg("pg_passwordguard.reuse_max_roles is not set, or pg_passwordguard is not loaded via shared_preload_libraries")));
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    /* Copy the roles whose fingerprint is shared. */
+    LWLockAcquire(pgg_reuse->lock, LW_SHARED);
+    entries = palloc(Max(hash_get_num_entries(reuse_by_role), 1) * sizeof(ReuseRoleEntry));
+    hash_seq_init(&status, reuse_by_role);
+    while ((entry = hash_seq_search(&status)) != NULL)
+    {
+        ReuseFingerprintEntry *fp;
+
+        fp = hash_search(reuse_by_fingerprint, &entry->fingerprint, HASH_FIND, NULL);
+        if (fp != NULL && fp->nroles > 1)
+            entries[count++] = *entry;
+    }
+    LWLockRelease(pgg_reuse->lock);
+
+    qsort(entries, count, sizeof(ReuseRoleEntry), reuse_entry_cmp);
+
+    for (start = 0; start < count; start = i)
+    {
+        Datum      *roles;
+        Datum       values[2];
+        bool        nulls[2] = {false, false};
+
+        for (i = start + 1; i < count; i++)
+        {
+            if (memcmp(&entries[i].fingerprint, &entries[start].fingerprint,
+                       sizeof(ReuseFingerprint)) != 0)
+                break;
+        }
+
+        roles = palloc((i - start) * sizeof(Datum));
+        for (j = start; j < i; j++)
+            roles[j - start] = ObjectIdGetDatum(entries[j].roleid);
+
+        values[0] = PointerGetDatum(construct_array(roles, i - start, REGROLEOID,
+                                                    sizeof(Oid), true, TYPALIGN_INT));
+        values[1] = Int32GetDatum(i - start);
+        tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+        pfree(roles);
+    }
+
+    pfree(entries);
+    return (Datum) 0;
+}
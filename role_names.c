@@ -0,0 +1,280 @@
+/*
+ * role_names.c
+ *
+ * Detects passwords that contain the name of another role (pg_passwordguard.reject_rolenames).
+ *
+ * The skeletons of all role names from pg_authid (case-folded, with look-alike characters mapped to
+ * the letters they imitate; see skeleton.c) are compiled into an Aho-Corasick automaton, which is
+ * run over the skeleton of the password: one linear pass instead of one strstr() per role. The
+ * automaton is built lazily the first time a backend needs it and thrown away whenever pg_authid
+ * changes (syscache invalidation on AUTHOID); the next check rebuilds it.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres.h"
+
+#include <string.h>
+
+#include "access/genam.h"
+#include "access/htup_details.h"
+#include "access/table.h"
+#include "catalog/pg_authid.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+
+#include "passwordguard.h"
+
+/*
+ * Role names shorter than this are not matched; otherwise a role such as "dba" or "app" would make
+ * ordinary words unusable in every password.
+ */
+#define ROLE_NAME_MIN_MATCH 4
+
+/*
+ * One trie node. Children hang off a first-child/next-sibling list (role names use few distinct
+ * characters, so these lists are short); the root keeps a direct 256-entry table instead.
+ */
+typedef struct RoleNameNode
+{
+    int32       first_child;
+    int32       next_sibling;
+    int32       fail;           /* longest proper suffix that is also a trie node */
+    int32       dict;           /* nearest node on the fail chain that ends a name, or 0 */
+    int32       name;           /* index into role_names[] if a name ends here, else -1 */
+    unsigned char label;
+} RoleNameNode;
+
+static MemoryContext role_names_context = NULL;
+static bool role_names_valid = false;
+static bool role_names_callback_registered = false;
+static uint64 role_names_generation = 0;
+
+static RoleNameNode *role_nodes = NULL;
+static int32 role_nnodes = 0;
+static int32 role_root_next[256];
+static char **role_names = NULL;
+
+/* Syscache callback: any change to pg_authid discards the automaton. */
+static void
+role_names_invalidate(Datum arg, int cacheid, uint32 hashvalue)
+{
+    role_names_valid = false;
+    role_names_generation++;
+}
+
+static inline int32
+role_names_goto(int32 state, unsigned char c)
+{
+    int32       child;
+
+    if (state == 0)
+        return role_root_next[c];
+
+    for (child = role_nodes[state].first_child; child > 0; child = role_nodes[child].next_sibling)
+    {
+        if (role_nodes[child].label == c)
+            return child;
+    }
+    return -1;
+}
+
+static int32
+role_names_new_node(int32 *capacity, unsigned char label)
+{
+    RoleNameNode *node;
+
+    if (role_nnodes >= *capacity)
+    {
+        *capacity *= 2;
+        role_nodes = repalloc(role_nodes, sizeof(RoleNameNode) * *capacity);
+    }
+
+    node = &role_nodes[role_nnodes];
+    node->first_child = 0;
+    node->next_sibling = 0;
+    node->fail = 0;
+    node->dict = 0;
+    node->name = -1;
+    node->label = label;
+
+    return role_nnodes++;
+}
+
+/* Build the trie and its failure links from the current contents of pg_authid. */
+static void
+role_names_build(void)
+{
+    MemoryContext oldcontext;
+    Relation    rel;
+    SysScanDesc scan;
+    HeapTuple   tuple;
+    int32       capacity = 1024;
+    int         names_capacity = 64;
+    int         nnames = 0;
+    int32      *queue;
+    int32       head;
+    int32       tail;
+    uint64      generation;
+    int         i;
+
+    if (role_names_context == NULL)
+        role_names_context = AllocSetContextCreate(CacheMemoryContext,
+                                                   "pg_passwordguard role names",
+                                                   ALLOCSET_DEFAULT_SIZES);
+    else
+        MemoryContextReset(role_names_context);
+
+    if (!role_names_callback_registered)
+    {
+        CacheRegisterSyscacheCallback(AUTHOID, role_names_invalidate, (Datum) 0);
+        role_names_callback_registered = true;
+    }
+
+    /* An invalidation arriving while we scan must force another rebuild next time. */
+    generation = role_names_generation;
+
+    oldcontext = MemoryContextSwitchTo(role_names_context);
+
+    role_nodes = palloc(sizeof(RoleNameNode) * capacity);
+    role_nnodes = 0;
+    role_names = palloc(sizeof(char *) * names_capacity);
+    memset(role_root_next, -1, sizeof(role_root_next));
+    (void) role_names_new_node(&capacity, 0);
+
+    /* Insert the skeleton of every role name into the trie. */
+    rel = table_open(AuthIdRelationId, AccessShareLock);
+    scan = systable_beginscan(rel, InvalidOid, false, NULL, 0, NULL);
+
+    while (HeapTupleIsValid(tuple = systable_getnext(scan)))
+    {
+        Form_pg_authid authform = (Form_pg_authid) GETSTRUCT(tuple);
+        const char *rolname = NameStr(authform->rolname);
+        char       *skeleton;
+        int32       state = 0;
+        int         len;
+
+        skeleton = pgg_skeleton(rolname, strlen(rolname), &len);
+        if (len < ROLE_NAME_MIN_MATCH)
+        {
+            pfree(skeleton);
+            continue;
+        }
+
+        for (i = 0; i < len; i++)
+        {
+            unsigned char c = (unsigned char) skeleton[i];
+            int32       next;
+
+            next = role_names_goto(state, c);
+            if (next < 0)
+            {
+                next = role_names_new_node(&capacity, c);
+                if (state == 0)
+                    role_root_next[c] = next;
+                else
+                {
+                    role_nodes[next].next_sibling = role_nodes[state].first_child;
+                    role_nodes[state].first_child = next;
+                }
+            }
+            state = next;
+        }
+
+        if (role_nodes[state].name < 0)
+        {
+            if (nnames >= names_capacity)
+            {
+                names_capacity *= 2;
+                role_names = repalloc(role_names, sizeof(char *) * names_capacity);
+            }
+            role_names[nnames] = skeleton;
+            role_nodes[state].name = nnames++;
+        }
+        else
+            pfree(skeleton);
+    }
+
+    systable_endscan(scan);
+    table_close(rel, AccessShareLock);
+
+    /* Breadth-first pass to fill in failure and dictionary-suffix links. */
+    queue = palloc(sizeof(int32) * role_nnodes);
+    head = tail = 0;
+
+    for (i = 0; i < 256; i++)
+    {
+        if (role_root_next[i] > 0)
+            queue[tail++] = role_root_next[i];
+        else
+            role_root_next[i] = 0;
+    }
+
+    while (head < tail)
+    {
+        int32       parent = queue[head++];
+        int32       child;
+
+        for (child = role_nodes[parent].first_child; child > 0; child = role_nodes[child].next_sibling)
+        {
+            int32       f = role_nodes[parent].fail;
+            int32       target;
+
+            while (f != 0 && role_names_goto(f, role_nodes[child].label) < 0)
+                f = role_nodes[f].fail;
+            target = role_names_goto(f, role_nodes[child].label);
+
+            role_nodes[child].fail = (target > 0 && target != child) ? target : 0;
+            role_nodes[child].dict = role_nodes[role_nodes[child].fail].name >= 0 ?
+                role_nodes[child].fail : role_nodes[role_nodes[child].fail].dict;
+
+            queue[tail++] = child;
+        }
+    }
+
+    pfree(queue);
+    MemoryContextSwitchTo(oldcontext);
+
+    role_names_valid = (generation == role_names_generation);
+}
+
+/*
+ * pgg_contains_other_role_name
+ *
+ * Returns true if the password, given as its skeleton (see skeleton.c), contains the skeleton of the
+ * name of any role other than the one whose skeleton is user_skeleton. The username itself is left
+ * to pg_passwordguard.reject_username.
+ */
+bool
+pgg_contains_other_role_name(const char *skeleton, size_t len, const char *user_skeleton)
+{
+    int32       state = 0;
+    size_t      i;
+
+    if (!role_names_valid)
+        role_names_build();
+
+    if (user_skeleton == NULL)
+        user_skeleton = "";
+
+    for (i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char) skeleton[i];
+        int32       next = 0;
+        int32       match;
+
+        while (state != 0 && (next = role_names_goto(state, c)) < 0)
+            state = role_nodes[state].fail;
+        state = (state == 0) ? role_root_next[c] : next;
+
+        match = role_nodes[state].name >= 0 ? state : role_nodes[state].dict;
+        for (; match > 0; match = role_nodes[match].dict)
+        {
+            if (strcmp(role_names[role_nodes[match].name], user_skeleton) != 0)
+                return true;
+        }
+    }
+
+    return false;
+}
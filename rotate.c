@@ -0,0 +1,398 @@
+/*
+ * rotate.c
+ *
+ * pg_passwordguard_rotate(roles): gives every role a new random password that satisfies the
+ * enforced policy, and returns the new passwords.
+ *
+ * Nearly all of the cost is the SCRAM-SHA-256 secret of each password (PBKDF2 with thousands of
+ * iterations), so that step is spread over dynamic background workers. The calling backend generates
+ * the passwords into a dynamic shared memory segment, starts up to pg_passwordguard.rotate_workers
+ * workers and hashes alongside them, each process taking the next unhashed password from a shared
+ * counter. It then sets all the secrets with ALTER ROLE, in the caller's transaction, so either every
+ * role is rotated or none is. If no worker could be started, or one failed, the backend hashes what
+ * is left itself. The caller's privileges on the roles are checked before any of this work, and on
+ * error the workers are stopped rather than left hashing.
+ *
+ * The plaintext passwords exist only in the segment, which is wiped before it is detached, and in the
+ * function result; they are never stored or logged.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres.h"
+
+#include "catalog/pg_authid.h"
+#include "catalog/pg_type.h"
+#include "executor/spi.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "libpq/scram.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "storage/dsm.h"
+#include "tcop/tcopprot.h"
+#include "utils/acl.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+#include "utils/syscache.h"
+
+#include "passwordguard.h"
+
+/* Fewer roles than this per worker aren't worth a worker's startup time. */
+#define ROTATE_ROLES_PER_WORKER     8
+
+/* Room for "SCRAM-SHA-256$<iterations>:<salt>$<StoredKey>:<ServerKey>". */
+#define ROTATE_SECRET_SIZE          256
+
+/* Header of the shared segment; count password slots and count secret slots follow. */
+typedef struct RotateShared
+{
+    pg_atomic_uint32 next;          /* next password to hash */
+    int         count;
+    int         password_size;      /* bytes per password slot */
+    int         iterations;         /* SCRAM iteration count of the calling session */
+} RotateShared;
+
+#define ROTATE_HEADER_SIZE          MAXALIGN(sizeof(RotateShared))
+
+PG_FUNCTION_INFO_V1(pg_passwordguard_rotate);
+
+PGDLLEXPORT void pgg_rotate_worker_main(Datum main_arg);
+
+static inline char *
+rotate_password(RotateShared *shared, int i)
+{
+    return (char *) shared + ROTATE_HEADER_SIZE + (Size) i * shared->password_size;
+}
+
+static inline char *
+rotate_secret(RotateShared *shared, int i)
+{
+    return (char *) shared + ROTATE_HEADER_SIZE + (Size) shared->count * shared->password_size +
+        (Size) i * ROTATE_SECRET_SIZE;
+}
+
+/* Builds the SCRAM secret of password i into its slot. */
+static void
+rotate_hash_one(RotateShared *shared, int i)
+{
+    char       *secret = pg_be_scram_build_secret(rotate_password(shared, i));
+
+    if (strlen(secret) >= ROTATE_SECRET_SIZE)
+        elog(ERROR, "SCRAM secret too long");
+    strcpy(rotate_secret(shared, i), secret);
+    pfree(secret);
+}
+
+/* Hashes passwords until there are none left; run by the backend and by every worker. */
+static void
+rotate_hash_all(RotateShared *shared, MemoryContext context)
+{
+    MemoryContext oldcontext = MemoryContextSwitchTo(context);
+
+    for (;;)
+    {
+        uint32      i = pg_atomic_fetch_add_u32(&shared->next, 1);
+
+        if (i >= (uint32) shared->count)
+            break;
+
+        CHECK_FOR_INTERRUPTS();
+        rotate_hash_one(shared, (int) i);
+        MemoryContextReset(context);
+    }
+
+    MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * pgg_rotate_worker_main
+ *
+ * Entry point of the hashing workers; main_arg is the handle of the shared segment.
+ */
+void
+pgg_rotate_worker_main(Datum main_arg)
+{
+    dsm_segment *seg;
+    RotateShared *shared;
+
+    pqsignal(SIGTERM, die);
+    BackgroundWorkerUnblockSignals();
+
+    CurrentResourceOwner = ResourceOwnerCreate(NULL, "pg_passwordguard rotate worker");
+
+    seg = dsm_attach(DatumGetUInt32(main_arg));
+    if (seg == NULL)
+        ereport(ERROR,
+                (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                 errmsg("could not map dynamic shared memory segment")));
+    shared = dsm_segment_address(seg);
+
+#if PG_VERSION_NUM >= 160000
+    /* Hash with the iteration count of the session that asked for the rotation. */
+    SetConfigOption("scram_iterations", psprintf("%d", shared->iterations),
+                    PGC_SUSET, PGC_S_OVERRIDE);
+#endif
+
+    rotate_hash_all(shared, AllocSetContextCreate(TopMemoryContext, "pg_passwordguard rotate",
+                                                  ALLOCSET_DEFAULT_SIZES));
+
+    dsm_detach(seg);
+    proc_exit(0);
+}
+
+/* Starts up to nworkers hashing workers; returns how many could be registered. */
+static int
+rotate_launch_workers(dsm_segment *seg, int nworkers, BackgroundWorkerHandle **handles)
+{
+    BackgroundWorker worker;
+    int         launched = 0;
+
+    memset(&worker, 0, sizeof(worker));
+    worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+    worker.bgw_start_time = BgWorkerStart_ConsistentState;
+    worker.bgw_restart_time = BGW_NEVER_RESTART;
+    snprintf(worker.bgw_library_name, sizeof(worker.bgw_library_name), "pg_passwordguard");
+    snprintf(worker.bgw_function_name, sizeof(worker.bgw_function_name), "pgg_rotate_worker_main");
+    snprintf(worker.bgw_name, sizeof(worker.bgw_name), "pg_passwordguard rotate worker");
+    snprintf(worker.bgw_type, sizeof(worker.bgw_type), "pg_passwordguard rotate worker");
+    worker.bgw_main_arg = UInt32GetDatum(dsm_segment_handle(seg));
+    worker.bgw_notify_pid = MyProcPid;
+
+    while (launched < nworkers &&
+           RegisterDynamicBackgroundWorker(&worker, &handles[launched]))
+        launched++;
+
+    return launched;
+}
+
+/* The role OIDs of the array; every role must exist and appear once. */
+static Oid *
+rotate_roles(ArrayType *array, int *count)
+{
+    Datum      *elems;
+    bool       *nulls;
+    Oid        *roles;
+    Oid        *sorted;
+    int         n;
+    int         i;
+
+    if (ARR_NDIM(array) > 1)
+        ereport(ERROR,
+                (errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR),
+                 errmsg("roles must be a one-dimensional array")));
+
+    deconstruct_array(array, REGROLEOID, sizeof(Oid), true, TYPALIGN_INT, &elems, &nulls, &n);
+
+    roles = palloc(Max(n, 1) * sizeof(Oid));
+    for (i = 0; i < n; i++)
+    {
+        if (nulls[i])
+            ereport(ERROR,
+                    (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+                     errmsg("roles must not contain nulls")));
+        roles[i] = DatumGetObjectId(elems[i]);
+    }
+
+    /* Rotating a role twice would return a password that is no longer valid. */
+    sorted = palloc(Max(n, 1) * sizeof(Oid));
+    memcpy(sorted, roles, n * sizeof(Oid));
+    qsort(sorted, n, sizeof(Oid), oid_cmp);
+    for (i = 1; i < n; i++)
+    {
+        if (sorted[i] == sorted[i - 1])
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                     errmsg("role \"%s\" appears more than once", GetUserNameFromId(sorted[i], false))));
+    }
+    pfree(sorted);
+
+    *count = n;
+    return roles;
+}
+
+/*
+ * Fails before any password is generated or hashed if the caller may not set the password of one of
+ * the roles; otherwise that would only show at ALTER ROLE, after all the hashing. Follows the rules of
+ * ALTER ROLE ... PASSWORD, which checks them again.
+ */
+static void
+rotate_check_privileges(const Oid *roles, int count)
+{
+    Oid         userid = GetUserId();
+    int         i;
+
+    if (superuser())
+        return;
+
+    for (i = 0; i < count; i++)
+    {
+        HeapTuple   tuple;
+        Form_pg_authid authform;
+        bool        allowed;
+
+        tuple = SearchSysCache1(AUTHOID, ObjectIdGetDatum(roles[i]));
+        if (!HeapTupleIsValid(tuple))
+            elog(ERROR, "cache lookup failed for role %u", roles[i]);
+        authform = (Form_pg_authid) GETSTRUCT(tuple);
+
+#if PG_VERSION_NUM >= 160000
+        /* Superusers only by superusers; others by themselves or by CREATEROLE with ADMIN OPTION. */
+        allowed = !authform->rolsuper &&
+            (roles[i] == userid ||
+             (has_createrole_privilege(userid) && is_admin_of_role(userid, roles[i])));
+#else
+        /* Superusers and replication roles only by superusers; others by themselves or CREATEROLE. */
+        allowed = !authform->rolsuper && !authform->rolreplication &&
+            (roles[i] == userid || has_createrole_privilege(userid));
+#endif
+        ReleaseSysCache(tuple);
+
+        if (!allowed)
+            ereport(ERROR,
+                    (errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+                     errmsg("permission denied to set the password of role \"%s\"",
+                            GetUserNameFromId(roles[i], false))));
+    }
+}
+
+/* Sets the secrets with ALTER ROLE, which checks the caller's privileges on every role again. */
+static void
+rotate_apply(RotateShared *shared, const Oid *roles)
+{
+    int         i;
+    int         ret;
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+
+    for (i = 0; i < shared->count; i++)
+    {
+        char       *sql;
+
+        sql = psprintf("ALTER ROLE %s PASSWORD %s",
+                       quote_identifier(GetUserNameFromId(roles[i], false)),
+                       quote_literal_cstr(rotate_secret(shared, i)));
+        /* The check hook doesn't see pre-hashed passwords; these were generated to the policy. */
+        pgg_history_remember(pgg_enforced_policy(), true);
+        ret = SPI_execute(sql, false, 0);
+        if (ret != SPI_OK_UTILITY)
+            elog(ERROR, "SPI_execute failed: %s", SPI_result_code_string(ret));
+        pfree(sql);
+    }
+
+    SPI_finish();
+}
+
+/*
+ * pg_passwordguard_rotate(roles regrole[], OUT role regrole, OUT password text)
+ */
+Datum
+pg_passwordguard_rotate(PG_FUNCTION_ARGS)
+{
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    PggGenerator gen;
+    Oid        *roles;
+    int         count;
+    dsm_segment *seg;
+    RotateShared *shared;
+    BackgroundWorkerHandle **handles;
+    int         nworkers;
+    int         launched;
+    int         i;
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    roles = rotate_roles(PG_GETARG_ARRAYTYPE_P(0), &count);
+    if (count == 0)
+        return (Datum) 0;
+    rotate_check_privileges(roles, count);
+
+    pgg_generator_init(&gen, pgg_enforced_policy(), 0);
+
+    seg = dsm_create(ROTATE_HEADER_SIZE + (Size) count * (gen.len + 1 + ROTATE_SECRET_SIZE), 0);
+    shared = dsm_segment_address(seg);
+    pg_atomic_init_u32(&shared->next, 0);
+    shared->count = count;
+    shared->password_size = gen.len + 1;
+#if PG_VERSION_NUM >= 160000
+    shared->iterations = scram_sha_256_iterations;
+#else
+    shared->iterations = 0;
+#endif
+
+    nworkers = Min(pgg_rotate_workers, (count - 1) / ROTATE_ROLES_PER_WORKER);
+    handles = palloc0(Max(nworkers, 1) * sizeof(BackgroundWorkerHandle *));
+
+    /*
+     * The segment holds every new password and secret until the end: wipe it on the way out, error
+     * or not, before it is detached.
+     */
+    PG_TRY();
+    {
+        PG_TRY();
+        {
+            for (i = 0; i < count; i++)
+            {
+                pgg_generate_password(&gen, rotate_password(shared, i));
+                rotate_secret(shared, i)[0] = '\0';
+            }
+        }
+        PG_FINALLY();
+        {
+            pgg_generator_end();
+        }
+        PG_END_TRY();
+
+        launched = rotate_launch_workers(seg, nworkers, handles);
+
+        rotate_hash_all(shared, AllocSetContextCreate(CurrentMemoryContext, "pg_passwordguard rotate",
+                                                      ALLOCSET_DEFAULT_SIZES));
+
+        for (i = 0; i < launched; i++)
+            WaitForBackgroundWorkerShutdown(handles[i]);
+
+        /* Whatever a failed worker claimed but didn't finish. */
+        for (i = 0; i < count; i++)
+        {
+            if (rotate_secret(shared, i)[0] == '\0')
+                rotate_hash_one(shared, i);
+        }
+
+        rotate_apply(shared, roles);
+
+        for (i = 0; i < count; i++)
+        {
+            Datum       values[2];
+            bool        nulls[2] = {false, false};
+
+            values[0] = ObjectIdGetDatum(roles[i]);
+            values[1] = CStringGetTextDatum(rotate_password(shared, i));
+            tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+            pfree(DatumGetPointer(values[1]));
+        }
+    }
+    PG_FINALLY();
+    {
+        /*
+         * After an error the workers would go on hashing until the counter runs out, with the segment
+         * still mapped: leave them nothing to take and stop them. Both are no-ops once they're done.
+         */
+        pg_atomic_write_u32(&shared->next, shared->count);
+        for (i = 0; i < nworkers; i++)
+        {
+            if (handles[i] != NULL)
+                TerminateBackgroundWorker(handles[i]);
+        }
+
+        explicit_bzero(shared, dsm_segment_map_length(seg));
+        dsm_detach(seg);
+    }
+    PG_END_TRY();
+
+    return (Datum) 0;
+}
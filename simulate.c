@@ -0,0 +1,418 @@
+/*
+ * simulate.c
+ *
+ * pg_passwordguard_simulate(): evaluates several candidate policies over a table of sample passwords
+ * and reports, per policy and rule, how many of them would be rejected.
+ *
+ * The work is done by the aggregate pg_passwordguard_simulate_agg(password, policies). Each password
+ * is analysed once (PggCheck) and every policy is then evaluated against that shared analysis, so
+ * K policies cost little more than one. The aggregate state is just the counters, with combine,
+ * serialize and deserialize functions, so the scan can run in parallel. The SQL wrapper runs the
+ * aggregate over the candidate table and expands its result with pg_passwordguard_simulate_rows().
+ *
+ * A policy is a jsonb object with any of the rule settings (same names as the GUCs, without the
+ * prefix); settings it does not mention keep the value of the currently enforced policy, e.g.
+ * '{"min_length": 14, "min_markov_bits": 30}'.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres.h"
+
+#include "catalog/pg_type.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/jsonb.h"
+#include "utils/numeric.h"
+
+#include "passwordguard.h"
+
+/* Counters per policy: checks with any violation, then one per rule. */
+#define SIM_COUNTERS_PER_POLICY     (1 + PGG_NUM_RULES)
+#define SIM_FAILED(state, k)        ((state)->counts[1 + (k) * SIM_COUNTERS_PER_POLICY])
+#define SIM_VIOLATIONS(state, k, r) ((state)->counts[1 + (k) * SIM_COUNTERS_PER_POLICY + 1 + (r)])
+
+typedef struct SimulateState
+{
+    int         npolicies;
+    PggPolicy  *policies;       /* only in states that received rows, not serialized */
+    int64      *counts;         /* counts[0] is the number of passwords checked */
+} SimulateState;
+
+#define SIM_NCOUNTS(npolicies)      (1 + (npolicies) * SIM_COUNTERS_PER_POLICY)
+
+PG_FUNCTION_INFO_V1(pg_passwordguard_simulate_trans);
+PG_FUNCTION_INFO_V1(pg_passwordguard_simulate_combine);
+PG_FUNCTION_INFO_V1(pg_passwordguard_simulate_serialize);
+PG_FUNCTION_INFO_V1(pg_passwordguard_simulate_deserialize);
+PG_FUNCTION_INFO_V1(pg_passwordguard_simulate_rows);
+
+static SimulateState *
+simulate_state_alloc(MemoryContext context, int npolicies)
+{
+    SimulateState *state = MemoryContextAllocZero(context, sizeof(SimulateState));
+
+    state->npolicies = npolicies;
+    state->counts = MemoryContextAllocZero(context, SIM_NCOUNTS(npolicies) * sizeof(int64));
+    return state;
+}
+
+/* Text form of a jsonb scalar, to be parsed like a GUC value. */
+static char *
+jsonb_scalar_to_cstring(const JsonbValue *v, int policyno, const char *key)
+{
+    switch (v->type)
+    {
+        case jbvString:
+            return pnstrdup(v->val.string.val, v->val.string.len);
+        case jbvNumeric:
+            return DatumGetCString(DirectFunctionCall1(numeric_out, NumericGetDatum(v->val.numeric)));
+        case jbvBool:
+            return pstrdup(v->val.boolean ? "true" : "false");
+        default:
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                     errmsg("invalid value for \"%s\" in policy %d", key, policyno),
+                     errdetail("Policy settings must be strings, numbers or booleans.")));
+    }
+    return NULL;                /* keep compiler quiet */
+}
+
+static void
+policy_set(PggPolicy *policy, int policyno, const char *key, const char *value)
+{
+    const PggPolicySetting *s = NULL;
+    char       *field;
+    bool        ok = false;
+    int         i;
+
+    for (i = 0; i < pgg_num_policy_settings; i++)
+    {
+        if (strcmp(pgg_policy_settings[i].name, key) == 0)
+        {
+            s = &pgg_policy_settings[i];
+            break;
+        }
+    }
+    if (s == NULL)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("unrecognized setting \"%s\" in policy %d", key, policyno)));
+
+    field = (char *) policy + s->offset;
+    switch (s->type)
+    {
+        case PGG_SETTING_BOOL:
+            ok = parse_bool(value, (bool *) field);
+            break;
+        case PGG_SETTING_INT:
+            ok = parse_int(value, (int *) field, 0, NULL) &&
+                *(int *) field >= s->min_value && *(int *) field <= s->max_value;
+            break;
+        case PGG_SETTING_REAL:
+            ok = parse_real(value, (double *) field, 0, NULL) &&
+                *(double *) field >= s->min_value && *(double *) field <= s->max_value;
+            break;
+        case PGG_SETTING_ENUM:
+            {
+                const struct config_enum_entry *e;
+
+                for (e = s->options; e->name; e++)
+                {
+                    if (pg_strcasecmp(e->name, value) == 0)
+                    {
+                        *(int *) field = e->val;
+                        ok = true;
+                        break;
+                    }
+                }
+            }
+            break;
+    }
+
+    if (!ok)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("invalid value for \"%s\" in policy %d: \"%s\"", key, policyno, value)));
+}
+
+/*
+ * Reads policy number policyno (1-based, for messages) from a jsonb object, on top of the currently
+ * enforced policy.
+ */
+static void
+policy_from_jsonb(PggPolicy *policy, int policyno, Jsonb *jb)
+{
+    JsonbIterator *it;
+    JsonbIteratorToken tok;
+    JsonbValue  v;
+    char       *key = NULL;
+
+    *policy = *pgg_enforced_policy();
+
+    if (!JB_ROOT_IS_OBJECT(jb))
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("policy %d must be a JSON object", policyno)));
+
+    it = JsonbIteratorInit(&jb->root);
+    while ((tok = JsonbIteratorNext(&it, &v, true)) != WJB_DONE)
+    {
+        if (tok == WJB_KEY)
+            key = pnstrdup(v.val.string.val, v.val.string.len);
+        else if (tok == WJB_VALUE)
+            policy_set(policy, policyno, key, jsonb_scalar_to_cstring(&v, policyno, key));
+    }
+}
+
+/* Makes sure every model a policy uses is configured, so rows don't each log a warning. */
+static void
+policy_check_models(const PggPolicy *policy, int policyno, const PggCheck *settings)
+{
+    const char *missing = pgg_policy_missing_model(policy, settings);
+
+    if (missing)
+        ereport(ERROR,
+                (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                 errmsg("policy %d needs %s, which is not set", policyno, missing)));
+}
+
+static SimulateState *
+simulate_state_create(MemoryContext aggcontext, ArrayType *array)
+{
+    SimulateState *state;
+    Datum      *elems;
+    bool       *nulls;
+    int         nelems;
+    PggCheck    settings;
+    int         k;
+
+    if (ARR_NDIM(array) > 1)
+        ereport(ERROR,
+                (errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR),
+                 errmsg("policies must be a one-dimensional array")));
+
+    deconstruct_array(array, JSONBOID, -1, false, TYPALIGN_INT, &elems, &nulls, &nelems);
+    if (nelems == 0)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("at least one policy is required")));
+
+    /* The server-wide settings the checks will run with. */
+    pgg_check_init(&settings, "", 0, NULL);
+
+    state = simulate_state_alloc(aggcontext, nelems);
+    state->policies = MemoryContextAlloc(aggcontext, nelems * sizeof(PggPolicy));
+    for (k = 0; k < nelems; k++)
+    {
+        if (nulls[k])
+            ereport(ERROR,
+                    (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+                     errmsg("policy %d is null", k + 1)));
+        policy_from_jsonb(&state->policies[k], k + 1, DatumGetJsonbP(elems[k]));
+        policy_check_models(&state->policies[k], k + 1, &settings);
+    }
+
+    return state;
+}
+
+/*
+ * pg_passwordguard_simulate_trans(state internal, password text, policies jsonb[])
+ */
+Datum
+pg_passwordguard_simulate_trans(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggcontext;
+    SimulateState *state;
+
+    if (!AggCheckCallContext(fcinfo, &aggcontext))
+        elog(ERROR, "pg_passwordguard_simulate_trans called in non-aggregate context");
+
+    state = PG_ARGISNULL(0) ? NULL : (SimulateState *) PG_GETARG_POINTER(0);
+    if (state == NULL)
+    {
+        if (PG_ARGISNULL(2))
+            ereport(ERROR,
+                    (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+                     errmsg("policies must not be null")));
+        state = simulate_state_create(aggcontext, PG_GETARG_ARRAYTYPE_P(2));
+    }
+
+    if (!PG_ARGISNULL(1))
+    {
+        char       *password = text_to_cstring(PG_GETARG_TEXT_PP(1));
+        PggCheck    check;
+        PggVerdict  verdict;
+        int         k;
+        int         r;
+
+        /* No username, and no time limits: every rule is evaluated for every sample. */
+        pgg_check_init(&check, password, strlen(password), NULL);
+        check.max_check_time_ms = 0;
+        check.neural_time_budget = 0;
+
+        state->counts[0]++;
+        for (k = 0; k < state->npolicies; k++)
+        {
+            pgg_policy_evaluate(&state->policies[k], &check, false, &verdict);
+            if (verdict.violated == 0)
+                continue;
+
+            SIM_FAILED(state, k)++;
+            for (r = 0; r < PGG_NUM_RULES; r++)
+            {
+                if (verdict.violated & PGG_RULE_BIT(r))
+                    SIM_VIOLATIONS(state, k, r)++;
+            }
+        }
+
+        pgg_check_end(&check);
+        pfree(password);
+    }
+
+    PG_RETURN_POINTER(state);
+}
+
+/*
+ * pg_passwordguard_simulate_combine(state1 internal, state2 internal)
+ */
+Datum
+pg_passwordguard_simulate_combine(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggcontext;
+    SimulateState *state1;
+    SimulateState *state2;
+    int         i;
+
+    if (!AggCheckCallContext(fcinfo, &aggcontext))
+        elog(ERROR, "pg_passwordguard_simulate_combine called in non-aggregate context");
+
+    state1 = PG_ARGISNULL(0) ? NULL : (SimulateState *) PG_GETARG_POINTER(0);
+    state2 = PG_ARGISNULL(1) ? NULL : (SimulateState *) PG_GETARG_POINTER(1);
+
+    if (state2 == NULL)
+        PG_RETURN_POINTER(state1);
+
+    if (state1 == NULL)
+    {
+        state1 = simulate_state_alloc(aggcontext, state2->npolicies);
+        memcpy(state1->counts, state2->counts, SIM_NCOUNTS(state2->npolicies) * sizeof(int64));
+        PG_RETURN_POINTER(state1);
+    }
+
+    Assert(state1->npolicies == state2->npolicies);
+    for (i = 0; i < SIM_NCOUNTS(state1->npolicies); i++)
+        state1->counts[i] += state2->counts[i];
+
+    PG_RETURN_POINTER(state1);
+}
+
+/*
+ * pg_passwordguard_simulate_serialize(state internal) returns bytea
+ *
+ * Also the aggregate's final function: the counters, as int32 npolicies followed by the int64 counts.
+ * Workers run on the same machine, so native byte order is fine.
+ */
+Datum
+pg_passwordguard_simulate_serialize(PG_FUNCTION_ARGS)
+{
+    SimulateState *state = (SimulateState *) PG_GETARG_POINTER(0);
+    Size        ncounts = SIM_NCOUNTS(state->npolicies);
+    Size        size = VARHDRSZ + sizeof(int32) + ncounts * sizeof(int64);
+    bytea      *result = palloc(size);
+    int32       npolicies = state->npolicies;
+
+    SET_VARSIZE(result, size);
+    memcpy(VARDATA(result), &npolicies, sizeof(int32));
+    memcpy(VARDATA(result) + sizeof(int32), state->counts, ncounts * sizeof(int64));
+
+    PG_RETURN_BYTEA_P(result);
+}
+
+/* Inverse of pg_passwordguard_simulate_serialize, into a state allocated in context. */
+static SimulateState *
+simulate_state_read(MemoryContext context, bytea *data)
+{
+    SimulateState *state;
+    int32       npolicies;
+
+    if (VARSIZE_ANY_EXHDR(data) < sizeof(int32))
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("invalid pg_passwordguard simulation state")));
+
+    memcpy(&npolicies, VARDATA_ANY(data), sizeof(int32));
+    if (npolicies <= 0 ||
+        VARSIZE_ANY_EXHDR(data) != sizeof(int32) + SIM_NCOUNTS((Size) npolicies) * sizeof(int64))
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("invalid pg_passwordguard simulation state")));
+
+    state = simulate_state_alloc(context, npolicies);
+    memcpy(state->counts, VARDATA_ANY(data) + sizeof(int32), SIM_NCOUNTS(npolicies) * sizeof(int64));
+    return state;
+}
+
+/*
+ * pg_passwordguard_simulate_deserialize(data bytea, internal) returns internal
+ */
+Datum
+pg_passwordguard_simulate_deserialize(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggcontext;
+
+    if (!AggCheckCallContext(fcinfo, &aggcontext))
+        elog(ERROR, "pg_passwordguard_simulate_deserialize called in non-aggregate context");
+
+    PG_RETURN_POINTER(simulate_state_read(aggcontext, PG_GETARG_BYTEA_PP(0)));
+}
+
+/*
+ * pg_passwordguard_simulate_rows(state bytea)
+ *
+ * Expands the aggregate's result into rows (policy, rule, checked, rejected, rejection_rate): first
+ * one with a null rule for the policy as a whole, then one per rule.
+ */
+Datum
+pg_passwordguard_simulate_rows(PG_FUNCTION_ARGS)
+{
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    SimulateState *state;
+    int64       checked;
+    int         k;
+    int         r;
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    state = simulate_state_read(CurrentMemoryContext, PG_GETARG_BYTEA_PP(0));
+    checked = state->counts[0];
+
+    for (k = 0; k < state->npolicies; k++)
+    {
+        for (r = -1; r < PGG_NUM_RULES; r++)
+        {
+            Datum       values[5];
+            bool        nulls[5] = {false, false, false, false, false};
+            int64       rejected = (r < 0) ? SIM_FAILED(state, k) : SIM_VIOLATIONS(state, k, r);
+
+            values[0] = Int32GetDatum(k + 1);
+            if (r < 0)
+                nulls[1] = true;
+            else
+                values[1] = CStringGetTextDatum(pgg_rule_names[r]);
+            values[2] = Int64GetDatum(checked);
+            values[3] = Int64GetDatum(rejected);
+            if (checked > 0)
+                values[4] = Float8GetDatum((double) rejected / checked);
+            else
+                nulls[4] = true;
+
+            tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+        }
+    }
+
+    return (Datum) 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * skeleton.c
+ *
+ * Skeletons of names and passwords, so that pg_passwordguard.reject_username and reject_rolenames
+ * can't be sidestepped with characters that only look like the name: "ａｌｉｃｅ" (full-width),
+ * "аlice" (Cyrillic а), "𝐚𝐥𝐢𝐜𝐞" (mathematical bold).
+ *
+ * The skeleton of a string is, after the Unicode TR39 "skeleton" idea:
+ *   1. its NFKC normalization, which folds compatibility forms such as full-width and mathematical
+ *      letters, ligatures and superscripts into the plain characters;
+ *   2. lowercased, ASCII as pgg_fold_char() does;
+ *   3. with every letter that is confusable with an ASCII letter (from the Greek, Cyrillic and
+ *      Armenian scripts, mostly) replaced by that letter.
+ * Two strings that look alike have the same skeleton, so the name rules compare skeletons.
+ *
+ * The confusables are a small sorted table of the characters from TR39's confusables.txt that
+ * imitate a single ASCII letter, looked up by binary search. The skeleton of an all-ASCII string, by
+ * far the usual case, is the string lowercased; a check takes it from the folded view of the analysis
+ * (or folds the username into a buffer) and only calls pgg_skeleton() for other strings.
+ *
+ * Only UTF-8 strings are normalized; in a database with another encoding the skeleton is just the
+ * string lowercased. The client library expects UTF-8.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#include "common/unicode_norm.h"
+#include "mb/pg_wchar.h"
+
+#include "passwordguard.h"
+
+/* A character confusable with a lowercase ASCII letter. */
+typedef struct Confusable
+{
+    uint16      codepoint;
+    char        letter;
+} Confusable;
+
+/* Sorted by code point. */
+static const Confusable confusables[] = {
+    {0x0131, 'i'},              /* LATIN SMALL LETTER DOTLESS I */
+    {0x01C0, 'l'},              /* LATIN LETTER DENTAL CLICK */
+    {0x0237, 'j'},              /* LATIN SMALL LETTER DOTLESS J */
+    {0x0251, 'a'},              /* LATIN SMALL LETTER ALPHA */
+    {0x0261, 'g'},              /* LATIN SMALL LETTER SCRIPT G */
+    {0x0269, 'i'},              /* LATIN SMALL LETTER IOTA */
+    {0x026A, 'i'},              /* LATIN LETTER SMALL CAPITAL I */
+    {0x0391, 'a'},              /* GREEK CAPITAL LETTER ALPHA */
+    {0x0392, 'b'},              /* GREEK CAPITAL LETTER BETA */
+    {0x0395, 'e'},              /* GREEK CAPITAL LETTER EPSILON */
+    {0x0396, 'z'},              /* GREEK CAPITAL LETTER ZETA */
+    {0x0397, 'h'},              /* GREEK CAPITAL LETTER ETA */
+    {0x0399, 'i'},              /* GREEK CAPITAL LETTER IOTA */
+    {0x039A, 'k'},              /* GREEK CAPITAL LETTER KAPPA */
+    {0x039C, 'm'},              /* GREEK CAPITAL LETTER MU */
+    {0x039D, 'n'},              /* GREEK CAPITAL LETTER NU */
+    {0x039F, 'o'},              /* GREEK CAPITAL LETTER OMICRON */
+    {0x03A1, 'p'},              /* GREEK CAPITAL LETTER RHO */
+    {0x03A4, 't'},              /* GREEK CAPITAL LETTER TAU */
+    {0x03A5, 'y'},              /* GREEK CAPITAL LETTER UPSILON */
+    {0x03A7, 'x'},              /* GREEK CAPITAL LETTER CHI */
+    {0x03B1, 'a'},              /* GREEK SMALL LETTER ALPHA */
+    {0x03B3, 'y'},              /* GREEK SMALL LETTER GAMMA */
+    {0x03B9, 'i'},              /* GREEK SMALL LETTER IOTA */
+    {0x03BA, 'k'},              /* GREEK SMALL LETTER KAPPA */
+    {0x03BD, 'v'},              /* GREEK SMALL LETTER NU */
+    {0x03BF, 'o'},              /* GREEK SMALL LETTER OMICRON */
+    {0x03C1, 'p'},              /* GREEK SMALL LETTER RHO */
+    {0x03C5, 'u'},              /* GREEK SMALL LETTER UPSILON */
+    {0x03C7, 'x'},              /* GREEK SMALL LETTER CHI */
+    {0x03F2, 'c'},              /* GREEK LUNATE SIGMA SYMBOL */
+    {0x03F3, 'j'},              /* GREEK LETTER YOT */
+    {0x03F9, 'c'},              /* GREEK CAPITAL LUNATE SIGMA SYMBOL */
+    {0x0405, 's'},              /* CYRILLIC CAPITAL LETTER DZE */
+    {0x0406, 'i'},              /* CYRILLIC CAPITAL LETTER BYELORUSSIAN-UKRAINIAN I */
+    {0x0408, 'j'},              /* CYRILLIC CAPITAL LETTER JE */
+    {0x0410, 'a'},              /* CYRILLIC CAPITAL LETTER A */
+    {0x0412, 'b'},              /* CYRILLIC CAPITAL LETTER VE */
+    {0x0415, 'e'},              /* CYRILLIC CAPITAL LETTER IE */
+    {0x041A, 'k'},              /* CYRILLIC CAPITAL LETTER KA */
+    {0x041C, 'm'},              /* CYRILLIC CAPITAL LETTER EM */
+    {0x041D, 'h'},              /* CYRILLIC CAPITAL LETTER EN */
+    {0x041E, 'o'},              /* CYRILLIC CAPITAL LETTER O */
+    {0x0420, 'p'},              /* CYRILLIC CAPITAL LETTER ER */
+    {0x0421, 'c'},              /* CYRILLIC CAPITAL LETTER ES */
+    {0x0422, 't'},              /* CYRILLIC CAPITAL LETTER TE */
+    {0x0423, 'y'},              /* CYRILLIC CAPITAL LETTER U */
+    {0x0425, 'x'},              /* CYRILLIC CAPITAL LETTER HA */
+    {0x0430, 'a'},              /* CYRILLIC SMALL LETTER A */
+    {0x0435, 'e'},              /* CYRILLIC SMALL LETTER IE */
+    {0x043E, 'o'},              /* CYRILLIC SMALL LETTER O */
+    {0x0440, 'p'},              /* CYRILLIC SMALL LETTER ER */
+    {0x0441, 'c'},              /* CYRILLIC SMALL LETTER ES */
+    {0x0443, 'y'},              /* CYRILLIC SMALL LETTER U */
+    {0x0445, 'x'},              /* CYRILLIC SMALL LETTER HA */
+    {0x0455, 's'},              /* CYRILLIC SMALL LETTER DZE */
+    {0x0456, 'i'},              /* CYRILLIC SMALL LETTER BYELORUSSIAN-UKRAINIAN I */
+    {0x0458, 'j'},              /* CYRILLIC SMALL LETTER JE */
+    {0x04BA, 'h'},              /* CYRILLIC CAPITAL LETTER SHHA */
+    {0x04BB, 'h'},              /* CYRILLIC SMALL LETTER SHHA */
+    {0x04C0, 'l'},              /* CYRILLIC LETTER PALOCHKA */
+    {0x04CF, 'l'},              /* CYRILLIC SMALL LETTER PALOCHKA */
+    {0x0501, 'd'},              /* CYRILLIC SMALL LETTER KOMI DE */
+    {0x051A, 'q'},              /* CYRILLIC CAPITAL LETTER QA */
+    {0x051B, 'q'},              /* CYRILLIC SMALL LETTER QA */
+    {0x051C, 'w'},              /* CYRILLIC CAPITAL LETTER WE */
+    {0x051D, 'w'},              /* CYRILLIC SMALL LETTER WE */
+    {0x0570, 'h'},              /* ARMENIAN SMALL LETTER HO */
+    {0x0578, 'n'},              /* ARMENIAN SMALL LETTER VO */
+    {0x057D, 'u'},              /* ARMENIAN SMALL LETTER SEH */
+    {0x0585, 'o'},              /* ARMENIAN SMALL LETTER OH */
+};
+
+/* The ASCII letter c is confusable with, or 0. */
+static char
+confusable_letter(pg_wchar c)
+{
+    int         lo = 0;
+    int         hi = lengthof(confusables) - 1;
+
+    if (c < confusables[0].codepoint || c > confusables[hi].codepoint)
+        return 0;
+
+    while (lo <= hi)
+    {
+        int         mid = (lo + hi) / 2;
+
+        if (confusables[mid].codepoint == c)
+            return confusables[mid].letter;
+        if (confusables[mid].codepoint < c)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return 0;
+}
+
+/* The string lowercased byte by byte, for ASCII, non-UTF-8 or invalid UTF-8 input. */
+static char *
+fold_bytes(const char *str, int len, int *skeleton_len)
+{
+    char       *result = palloc(len + 1);
+    int         i;
+
+    for (i = 0; i < len; i++)
+        result[i] = (char) pgg_fold_char((unsigned char) str[i]);
+    result[len] = '\0';
+    *skeleton_len = len;
+    return result;
+}
+
+/*
+ * pgg_skeleton
+ *
+ * Returns the skeleton of str (len bytes), palloc'd and NUL-terminated, and sets *skeleton_len.
+ */
+char *
+pgg_skeleton(const char *str, int len, int *skeleton_len)
+{
+    const unsigned char *p = (const unsigned char *) str;
+    pg_wchar   *chars;
+    pg_wchar   *normalized;
+    char       *result;
+    int         nchars = 0;
+    int         i;
+    int         n;
+
+    /* ASCII needs no normalization, and its only confusables are its own case. */
+    for (i = 0; i < len && p[i] < 0x80; i++)
+        ;
+    if (i == len)
+        return fold_bytes(str, len, skeleton_len);
+
+#ifndef FRONTEND
+    if (GetDatabaseEncoding() != PG_UTF8)
+        return fold_bytes(str, len, skeleton_len);
+#endif
+
+    /* Decode; a string that isn't valid UTF-8 is only lowercased. */
+    chars = palloc((len + 1) * sizeof(pg_wchar));
+    for (i = 0; i < len; i += n)
+    {
+        n = pg_utf_mblen(p + i);
+        if (i + n > len || !pg_utf8_islegal(p + i, n))
+        {
+            pfree(chars);
+            return fold_bytes(str, len, skeleton_len);
+        }
+        chars[nchars++] = utf8_to_unicode(p + i);
+    }
+    chars[nchars] = 0;
+
+    /* (Only the frontend version returns NULL, when out of memory.) */
+    normalized = unicode_normalize(UNICODE_NFKC, chars);
+    explicit_bzero(chars, nchars * sizeof(pg_wchar));
+    pfree(chars);
+    if (normalized == NULL)
+        ereport(ERROR,
+                (errcode(ERRCODE_OUT_OF_MEMORY),
+                 errmsg("out of memory")));
+
+    /* Fold and map; NFKC may lengthen the string, so size the result from it. */
+    for (nchars = 0; normalized[nchars] != 0; nchars++)
+        ;
+    result = palloc(nchars * MAX_MULTIBYTE_CHAR_LEN + 1);
+    n = 0;
+    for (i = 0; i < nchars; i++)
+    {
+        pg_wchar    c = normalized[i];
+        char        letter;
+
+        if (c < 0x80)
+            result[n++] = (char) pgg_fold_char((unsigned char) c);
+        else if ((letter = confusable_letter(c)) != 0)
+            result[n++] = letter;
+        else
+        {
+            unicode_to_utf8(c, (unsigned char *) result + n);
+            n += pg_utf_mblen((unsigned char *) result + n);
+        }
+    }
+    result[n] = '\0';
+
+    explicit_bzero(normalized, nchars * sizeof(pg_wchar));
+    pfree(normalized);
+
+    *skeleton_len = n;
+    return result;
+}
@@ -13,6 +13,7 @@ SET pg_passwordguard.require_lower = on;
 SET pg_passwordguard.require_digit = on;
 SET pg_passwordguard.require_special = on;
 SET pg_passwordguard.reject_username = on;
+SET pg_passwordguard.reject_common = on;
 SET pg_passwordguard.log_only = off;
 
 --
@@ -46,6 +47,165 @@ CREATE ROLE sp_nospecial LOGIN PASSWORD 'Abcdefg1';
 CREATE ROLE spuser LOGIN PASSWORD 'Spuser1!';
 
 --
--- 7) Valid password that satisfies all rules
+-- 7) Common password from the built-in list (case-insensitive)
+--
+CREATE ROLE sp_common LOGIN PASSWORD 'Password1!';
+
+--
+-- 8) Password contains another role's name (case-insensitive)
+--
+SET pg_passwordguard.reject_rolenames = on;
+CREATE ROLE sp_billing NOLOGIN;
+CREATE ROLE sp_reports LOGIN PASSWORD 'Sp_Billing#42';
+SET pg_passwordguard.reject_rolenames = off;
+DROP ROLE sp_billing;
+
+--
+-- 9) Dates and years: rejected outright, or discounted toward min_length
+--
+SET pg_passwordguard.date_patterns = reject;
+CREATE ROLE sp_season LOGIN PASSWORD 'Summer2024!x';
+SET pg_passwordguard.date_patterns = discount;
+CREATE ROLE sp_birthday LOGIN PASSWORD 'Ab!12.03.1999';
+SET pg_passwordguard.date_patterns = off;
+
+--
+-- 10) A stricter shadow policy is evaluated but never enforced
+--
+SET pg_passwordguard.shadow_policy = on;
+SET pg_passwordguard.shadow_min_length = 20;
+CREATE ROLE sp_shadow LOGIN PASSWORD 'Abc12345!y';
+SET pg_passwordguard.shadow_policy = off;
+DROP ROLE sp_shadow;
+
+--
+-- 11) Simulating candidate policies over a table of sample passwords
+--
+CREATE TABLE sp_candidates (password text);
+INSERT INTO sp_candidates VALUES ('Aa1!'), ('abc12345!'), ('Password1!'), ('Abc12345!'), ('Abcdefgh12345!');
+SELECT policy, rule, checked, rejected
+  FROM pg_passwordguard_simulate('sp_candidates',
+                                 ARRAY['{"min_length": 8}', '{"min_length": 12, "require_special": false}']::jsonb[])
+ WHERE rule IS NULL OR rejected > 0
+ ORDER BY policy, rule NULLS FIRST;
+DROP TABLE sp_candidates;
+
+--
+-- 12) Generated passwords satisfy the policy
+--
+SET pg_passwordguard.min_length = 14;
+SELECT count(*) AS passwords, min(length(p)) AS min_len, max(length(p)) AS max_len
+  FROM pg_passwordguard_generate(100) p;
+CREATE ROLE sp_generated LOGIN;
+DO $$
+DECLARE
+    p text;
+BEGIN
+    FOR p IN SELECT * FROM pg_passwordguard_generate(50, 14) LOOP
+        EXECUTE format('ALTER ROLE sp_generated PASSWORD %L', p);
+    END LOOP;
+END
+$$;
+DROP ROLE sp_generated;
+SELECT * FROM pg_passwordguard_generate(1, 10);
+SET pg_passwordguard.min_length = 8;
+
+--
+-- 13) Rotating role passwords
+--
+CREATE ROLE sp_rot1 LOGIN;
+CREATE ROLE sp_rot2 LOGIN;
+SELECT role, length(password) AS len
+  FROM pg_passwordguard_rotate(ARRAY['sp_rot1', 'sp_rot2']::regrole[])
+ ORDER BY role::text;
+SELECT rolname, rolpassword LIKE 'SCRAM-SHA-256$%' AS scram
+  FROM pg_authid WHERE rolname LIKE 'sp_rot%' ORDER BY rolname;
+SELECT * FROM pg_passwordguard_rotate(ARRAY['sp_rot1', 'sp_rot1']::regrole[]);
+DROP ROLE sp_rot1, sp_rot2;
+
+--
+-- 14) Password changes are recorded with the policy version
+--
+SET pg_passwordguard.track_policy_versions = on;
+CREATE ROLE sp_tracked LOGIN PASSWORD 'Abc12345!';
+SELECT role FROM pg_passwordguard_rotate(ARRAY['sp_tracked']::regrole[]);
+SELECT count(*) AS changes, bool_and(compliant) AS compliant,
+       bool_and(policy_version = pg_passwordguard_policy_version()) AS current
+  FROM pg_passwordguard_password_changes WHERE roleid = 'sp_tracked'::regrole;
+SET pg_passwordguard.min_length = 10;
+SELECT role, policy_version = pg_passwordguard_policy_version() AS current
+  FROM pg_passwordguard_role_passwords WHERE role = 'sp_tracked'::regrole;
+SET pg_passwordguard.min_length = 8;
+ALTER ROLE sp_tracked PASSWORD 'SCRAM-SHA-256$4096:AAECAwQFBgcICQoLDA0ODw==$WpmVRRRv3aAjwn0xIkUC5qfzY+oRyOapQDwDUUgs4xk=:8V3zlOO75el0tTFgnmhMxSXR2PpgVfXox7geC6wmj/A=';
+SELECT role, policy_version IS NULL AND compliant IS NULL AS unchecked
+  FROM pg_passwordguard_role_passwords WHERE role = 'sp_tracked'::regrole;
+SET pg_passwordguard.track_policy_versions = off;
+DROP ROLE sp_tracked;
+SELECT count(*) FROM pg_passwordguard_password_changes;
+
+--
+-- 15) Exporting the policy for the client library
+--
+SELECT substr(pg_passwordguard_policy_export(), 1, 8) = 'PGGPOLCY'::bytea AS header,
+       position('\x0a6d696e5f6c656e677468'::bytea IN pg_passwordguard_policy_export()) > 0 AS has_min_length;
+CREATE TEMP TABLE sp_export AS SELECT pg_passwordguard_policy_export() AS e;
+SET pg_passwordguard.min_length = 10;
+SELECT e = pg_passwordguard_policy_export() AS unchanged FROM sp_export;
+SET pg_passwordguard.min_length = 8;
+SELECT e = pg_passwordguard_policy_export() AS unchanged FROM sp_export;
+DROP TABLE sp_export;
+
+--
+-- 16) Password reuse needs fingerprints, which are only kept when preloaded
+--
+SET pg_passwordguard.reject_reuse = on;
+CREATE ROLE sp_reuse LOGIN PASSWORD 'Abc12345!';
+SET pg_passwordguard.reject_reuse = off;
+DROP ROLE sp_reuse;
+SELECT * FROM pg_passwordguard_password_reuse();
+
+--
+-- 17) Look-alike characters (full-width, Cyrillic) don't hide a name
+--
+CREATE ROLE spuser LOGIN PASSWORD 'Xy1!ｓｐｕｓｅｒ';
+CREATE ROLE spuser LOGIN PASSWORD 'Xy1!ѕрusеr';
+SET pg_passwordguard.reject_rolenames = on;
+CREATE ROLE sp_billing NOLOGIN;
+CREATE ROLE sp_reports LOGIN PASSWORD 'Xy1!ѕр_Віllіng';
+SET pg_passwordguard.reject_rolenames = off;
+DROP ROLE sp_billing;
+
+--
+-- 18) Passwords built around a common password need the common-password index
+--
+SET pg_passwordguard.max_common_fraction = 0.5;
+CREATE ROLE sp_common LOGIN PASSWORD 'Abc12345!';
+SET pg_passwordguard.max_common_fraction = 1;
+DROP ROLE sp_common;
+
+--
+-- 19) Dictionary words need the dictionary file
+--
+SET pg_passwordguard.reject_dictionary = on;
+CREATE ROLE sp_dictionary LOGIN PASSWORD 'Abc12345!';
+SET pg_passwordguard.reject_dictionary = off;
+DROP ROLE sp_dictionary;
+
+--
+-- 20) cracklib dictionary words need the cracklib dictionary
+--
+SET pg_passwordguard.reject_cracklib = on;
+CREATE ROLE sp_cracklib LOGIN PASSWORD 'Abc12345!';
+SET pg_passwordguard.reject_cracklib = off;
+DROP ROLE sp_cracklib;
+
+--
+-- 21) Statistics need shared memory, which is only there when preloaded (see t/002_stats.pl)
+--
+SELECT * FROM pg_passwordguard_stats;
+SELECT pg_passwordguard_stats_reset();
+
+--
+-- 22) Valid password that satisfies all rules
 --
 CREATE ROLE sp_ok LOGIN PASSWORD 'Abc12345!';
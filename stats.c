@@ -0,0 +1,250 @@
+/*
+ * stats.c
+ *
+ * Shared-memory counters for pg_passwordguard, exposed through the pg_passwordguard_stats and
+ * pg_passwordguard_policy_stats views.
+ *
+ * For the enforced and the shadow policy we count the checks and the checks with at least one
+ * violation, and for every rule how often it was violated and how often it was skipped because the
+ * check ran out of time (pg_passwordguard.max_check_time_ms). Counters are plain atomics in a
+ * small fixed-size struct, so updating them never takes a lock.
+ *
+ * The counters need shared memory, which is only available when the library is loaded through
+ * shared_preload_libraries. Otherwise counting is a no-op and reading the view raises an error.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+
+#include "passwordguard.h"
+
+typedef struct PggPolicyCounters
+{
+    pg_atomic_uint64 checks;
+    pg_atomic_uint64 failed;
+    pg_atomic_uint64 violations[PGG_NUM_RULES];
+    pg_atomic_uint64 skipped[PGG_NUM_RULES];
+} PggPolicyCounters;
+
+typedef struct PggStatsShared
+{
+    PggPolicyCounters policy[PGG_NUM_POLICY_KINDS];
+} PggStatsShared;
+
+static const char *const policy_kind_names[PGG_NUM_POLICY_KINDS] = {"enforced", "shadow"};
+
+static PggStatsShared *pgg_stats = NULL;
+
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+PG_FUNCTION_INFO_V1(pg_passwordguard_stats);
+PG_FUNCTION_INFO_V1(pg_passwordguard_policy_stats);
+PG_FUNCTION_INFO_V1(pg_passwordguard_stats_reset);
+
+static void
+stats_shmem_request(void)
+{
+    if (prev_shmem_request_hook)
+        prev_shmem_request_hook();
+
+    RequestAddinShmemSpace(MAXALIGN(sizeof(PggStatsShared)));
+}
+
+static void
+reset_counters(PggPolicyCounters *c, bool init)
+{
+    int         i;
+
+    if (init)
+    {
+        pg_atomic_init_u64(&c->checks, 0);
+        pg_atomic_init_u64(&c->failed, 0);
+        for (i = 0; i < PGG_NUM_RULES; i++)
+        {
+            pg_atomic_init_u64(&c->violations[i], 0);
+            pg_atomic_init_u64(&c->skipped[i], 0);
+        }
+    }
+    else
+    {
+        pg_atomic_write_u64(&c->checks, 0);
+        pg_atomic_write_u64(&c->failed, 0);
+        for (i = 0; i < PGG_NUM_RULES; i++)
+        {
+            pg_atomic_write_u64(&c->violations[i], 0);
+            pg_atomic_write_u64(&c->skipped[i], 0);
+        }
+    }
+}
+
+static void
+stats_shmem_startup(void)
+{
+    bool        found;
+    int         k;
+
+    if (prev_shmem_startup_hook)
+        prev_shmem_startup_hook();
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+    pgg_stats = ShmemInitStruct("pg_passwordguard stats", sizeof(PggStatsShared), &found);
+    if (!found)
+    {
+        for (k = 0; k < PGG_NUM_POLICY_KINDS; k++)
+            reset_counters(&pgg_stats->policy[k], true);
+    }
+
+    LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * pgg_stats_init
+ *
+ * Called from _PG_init. Only reserves shared memory when loaded at server start.
+ */
+void
+pgg_stats_init(void)
+{
+    if (!process_shared_preload_libraries_in_progress)
+        return;
+
+    prev_shmem_request_hook = shmem_request_hook;
+    shmem_request_hook = stats_shmem_request;
+    prev_shmem_startup_hook = shmem_startup_hook;
+    shmem_startup_hook = stats_shmem_startup;
+}
+
+/*
+ * pgg_stats_count
+ *
+ * Adds the outcome of one check under a policy.
+ */
+void
+pgg_stats_count(PggPolicyKind kind, const PggVerdict *verdict)
+{
+    PggPolicyCounters *c;
+    int         i;
+
+    if (pgg_stats == NULL)
+        return;
+
+    c = &pgg_stats->policy[kind];
+    pg_atomic_fetch_add_u64(&c->checks, 1);
+    if (verdict->violated != 0)
+        pg_atomic_fetch_add_u64(&c->failed, 1);
+
+    for (i = 0; i < PGG_NUM_RULES; i++)
+    {
+        if (verdict->violated & PGG_RULE_BIT(i))
+            pg_atomic_fetch_add_u64(&c->violations[i], 1);
+        if (verdict->skipped & PGG_RULE_BIT(i))
+            pg_atomic_fetch_add_u64(&c->skipped[i], 1);
+    }
+}
+
+static void
+stats_check_available(void)
+{
+    if (pgg_stats == NULL)
+        ereport(ERROR,
+                (errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+                 errmsg("pg_passwordguard must be loaded via shared_preload_libraries")));
+}
+
+/*
+ * pg_passwordguard_stats
+ *
+ * Returns one row per policy and rule: policy, rule name, violations, skipped.
+ */
+Datum
+pg_passwordguard_stats(PG_FUNCTION_ARGS)
+{
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    int         k;
+    int         i;
+
+    stats_check_available();
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    for (k = 0; k < PGG_NUM_POLICY_KINDS; k++)
+    {
+        PggPolicyCounters *c = &pgg_stats->policy[k];
+
+        for (i = 0; i < PGG_NUM_RULES; i++)
+        {
+            Datum       values[4];
+            bool        nulls[4] = {false, false, false, false};
+
+            values[0] = CStringGetTextDatum(policy_kind_names[k]);
+            values[1] = CStringGetTextDatum(pgg_rule_names[i]);
+            values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&c->violations[i]));
+            values[3] = Int64GetDatum((int64) pg_atomic_read_u64(&c->skipped[i]));
+
+            tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+        }
+    }
+
+    return (Datum) 0;
+}
+
+/*
+ * pg_passwordguard_policy_stats
+ *
+ * Returns one row per policy: policy, checks, failed (checks with at least one violation).
+ */
+Datum
+pg_passwordguard_policy_stats(PG_FUNCTION_ARGS)
+{
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    int         k;
+
+    stats_check_available();
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    for (k = 0; k < PGG_NUM_POLICY_KINDS; k++)
+    {
+        PggPolicyCounters *c = &pgg_stats->policy[k];
+        Datum       values[3];
+        bool        nulls[3] = {false, false, false};
+
+        values[0] = CStringGetTextDatum(policy_kind_names[k]);
+        values[1] = Int64GetDatum((int64) pg_atomic_read_u64(&c->checks));
+        values[2] = Int64GetDatum((int64) pg_atomic_read_u64(&c->failed));
+
+        tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+    }
+
+    return (Datum) 0;
+}
+
+/*
+ * pg_passwordguard_stats_reset
+ *
+ * Zeroes all counters.
+ */
+Datum
+pg_passwordguard_stats_reset(PG_FUNCTION_ARGS)
+{
+    int         k;
+
+    stats_check_available();
+
+    for (k = 0; k < PGG_NUM_POLICY_KINDS; k++)
+        reset_counters(&pgg_stats->policy[k], false);
+
+    PG_RETURN_VOID();
+}
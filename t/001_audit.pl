@@ -0,0 +1,115 @@
+#
+# t/001_audit.pl
+#
+# pg_passwordguard_audit against policies exported by a server: verdicts in input order whatever the
+# number of threads, the summary, usernames, exit statuses, and the rules it can't check.
+#
+# Developed by: Kothari Nishchay
+#
+
+use strict;
+use warnings;
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node = PostgreSQL::Test::Cluster->new('main');
+$node->init;
+$node->start;
+$node->safe_psql('postgres', 'CREATE EXTENSION pg_passwordguard');
+
+my $tempdir = PostgreSQL::Test::Utils::tempdir;
+
+# Exports the policy with the given settings into a file, as psql prints the bytea.
+sub export_policy
+{
+	my ($name, $settings) = @_;
+	my $file = "$tempdir/$name.hex";
+
+	my $hex = $node->safe_psql('postgres',
+		"$settings SELECT pg_passwordguard_policy_export();");
+	PostgreSQL::Test::Utils::append_to_file($file, "$hex\n");
+	return $file;
+}
+
+sub input_file
+{
+	my ($name, @lines) = @_;
+	my $file = "$tempdir/$name.txt";
+
+	PostgreSQL::Test::Utils::append_to_file($file, join('', map { "$_\n" } @lines));
+	return $file;
+}
+
+my $policy = export_policy('default', 'SET pg_passwordguard.min_length = 8;');
+my $passwords = input_file('passwords',
+	'Tr0ub4dor&3', 'abc', 'password', 'Correct-Horse-9', 'Summer2024');
+
+foreach my $jobs (1, 3)
+{
+	command_checks_all(
+		[
+			'pg_passwordguard_audit', "--policy=$policy", "--jobs=$jobs",
+			$passwords
+		],
+		2,
+		[
+			qr/\Aok\nmin_length\nrequire_upper,require_digit,require_special,reject_common\nok\nrequire_special,reject_common\n\z/
+		],
+		[qr/\A\z/],
+		"one verdict per line in input order, exit status 2, $jobs job(s)");
+}
+
+command_checks_all(
+	[ 'pg_passwordguard_audit', "--policy=$policy", '--summary', $passwords ],
+	2,
+	[
+		qr/^passwords: 5\npassed: 2\nfailed: 3\nerrors: 0\n  min_length: 1\n  require_upper: 1\n  require_digit: 1\n  require_special: 2\n  reject_common: 2\n\z/m
+	],
+	[qr/\A\z/],
+	'summary counts the passwords and each rule');
+
+command_checks_all(
+	[
+		'pg_passwordguard_audit', "--policy=$policy", '--usernames',
+		input_file('usernames', 'alice:Alice2024!x', 'bob:Tr0ub4dor&3')
+	],
+	2,
+	[qr/\Areject_username\nok\n\z/],
+	[qr/\A\z/],
+	'usernames are checked with --usernames');
+
+command_ok(
+	[
+		'pg_passwordguard_audit', "--policy=$policy",
+		input_file('strong', 'Tr0ub4dor&3', 'Correct-Horse-9')
+	],
+	'exit status 0 when every password passes');
+
+# Rules the tool can't check must not pass every password silently.
+my $rolenames = export_policy('rolenames',
+	'SET pg_passwordguard.min_length = 8; SET pg_passwordguard.reject_rolenames = on;');
+command_fails_like(
+	[ 'pg_passwordguard_audit', "--policy=$rolenames", $passwords ],
+	qr/rules that can't be checked here: reject_rolenames/,
+	'refuses a policy with reject_rolenames');
+command_checks_all(
+	[
+		'pg_passwordguard_audit', "--policy=$rolenames", '--allow-unchecked',
+		'--summary', $passwords
+	],
+	2,
+	[qr/^errors: 0\nunchecked: reject_rolenames\n/m],
+	[qr/not checking rules: reject_rolenames/],
+	'--allow-unchecked checks the other rules and lists the unchecked ones in the summary');
+
+my $markov = export_policy('markov',
+	'SET pg_passwordguard.min_length = 8; SET pg_passwordguard.min_markov_bits = 30;');
+command_fails_like(
+	[ 'pg_passwordguard_audit', "--policy=$markov", $passwords ],
+	qr/rules that can't be checked here: min_markov_bits/,
+	'refuses a model rule without its model file');
+
+$node->stop;
+
+done_testing();
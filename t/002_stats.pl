@@ -0,0 +1,79 @@
+#
+# t/002_stats.pl
+#
+# The pg_passwordguard_stats and pg_passwordguard_policy_stats counters, which need the library in
+# shared_preload_libraries: what rejected passwords add to them, and pg_passwordguard_stats_reset().
+#
+# Developed by: Kothari Nishchay
+#
+
+use strict;
+use warnings;
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node = PostgreSQL::Test::Cluster->new('stats');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', q{
+shared_preload_libraries = 'pg_passwordguard'
+pg_passwordguard.min_length = 8
+pg_passwordguard.shadow_policy = on
+pg_passwordguard.shadow_min_length = 12
+});
+$node->start;
+$node->safe_psql('postgres', 'CREATE EXTENSION pg_passwordguard');
+
+my $rules = q{SELECT policy, rule, violations, skipped FROM pg_passwordguard_stats
+	WHERE violations > 0 OR skipped > 0 ORDER BY policy, rule};
+my $policies =
+  q{SELECT policy, checks, failed FROM pg_passwordguard_policy_stats ORDER BY policy};
+
+is($node->safe_psql('postgres', $rules), '', 'no violations counted yet');
+
+# One rule of the enforced policy each; the shadow policy rejects all of them for their length.
+my $n = 0;
+foreach my $password ('Ab1!', 'zebrafig1!', 'Zebrafig!')
+{
+	$n++;
+	my ($ret, $stdout, $stderr) =
+	  $node->psql('postgres', "CREATE ROLE st_rejected$n LOGIN PASSWORD '$password'");
+	like(
+		$stderr,
+		qr/password does not meet complexity requirements/,
+		"password $n is rejected");
+}
+$node->safe_psql('postgres', "CREATE ROLE st_accepted LOGIN PASSWORD 'Tr0ub4dor&3'");
+
+is( $node->safe_psql('postgres', $rules),
+	"enforced|min_length|1|0\n"
+	  . "enforced|require_digit|1|0\n"
+	  . "enforced|require_upper|1|0\n"
+	  . "shadow|min_length|4|0",
+	'violations are counted per policy and rule');
+is( $node->safe_psql('postgres', $policies),
+	"enforced|4|3\nshadow|4|4",
+	'checks and failed checks are counted per policy');
+
+# Resetting needs a superuser.
+$node->safe_psql('postgres', 'CREATE ROLE st_plain LOGIN');
+my ($ret, $stdout, $stderr) = $node->psql('postgres',
+	'SET ROLE st_plain; SELECT pg_passwordguard_stats_reset()');
+like($stderr, qr/permission denied for function pg_passwordguard_stats_reset/,
+	'resetting is refused to other roles');
+
+$node->safe_psql('postgres', 'SELECT pg_passwordguard_stats_reset()');
+is($node->safe_psql('postgres', $rules), '', 'reset zeroes the rule counters');
+is( $node->safe_psql('postgres', $policies),
+	"enforced|0|0\nshadow|0|0",
+	'reset zeroes the policy counters');
+
+$node->psql('postgres', "ALTER ROLE st_accepted PASSWORD 'abc'");
+is( $node->safe_psql('postgres', $policies),
+	"enforced|1|1\nshadow|1|1",
+	'counting goes on after a reset');
+
+$node->stop;
+
+done_testing();
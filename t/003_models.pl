@@ -0,0 +1,174 @@
+#
+# t/003_models.pl
+#
+# The rules that need model files, with the small models in t/data: passwords on either side of each
+# threshold, checked by the server and by pg_passwordguard_audit with the same files.
+#
+# The models were built with the tools from common_passwords.txt (without its comment lines):
+#
+#   grep -v '^#' common_passwords.txt |
+#     perl tools/train_markov.pl --order 2 --cost-bytes 1 -o t/data/markov.bin -
+#   perl tools/build_guess_table.pl --samples 1000 --seed 1 -o t/data/guess.bin t/data/markov.bin
+#   grep -v '^#' common_passwords.txt | perl tools/train_pcfg.pl -o t/data/pcfg.bin -
+#   grep -v '^#' common_passwords.txt | perl tools/build_common_index.pl -o t/data/common.idx -
+#   perl tools/build_dictionary.pl -o t/data/dictionary.bin t/data/words.txt
+#
+# t/data/pw_dict.* are the words of t/data/cracklib_words.txt in cracklib's packed format, as
+#
+#   cracklib-packer t/data/pw_dict < t/data/cracklib_words.txt
+#
+# writes them.
+#
+# The neural model has hand-set weights (t/data/neural.json): one filter each for lowercase letters,
+# digits and other characters, and a dense layer that scores lowercase letters as weak, digits as
+# slightly stronger and other characters as much stronger. It is exported with:
+#
+#   perl tools/export_neural_model.pl -o t/data/neural.bin t/data/neural.json
+#
+# Developed by: Kothari Nishchay
+#
+
+use strict;
+use warnings;
+use Cwd;
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+# The model files are in native byte order, and those in t/data were built little-endian.
+plan skip_all => 'the models in t/data are little-endian' if pack('L', 1) ne pack('V', 1);
+
+# The tests run from the source directory.
+my $data = Cwd::abs_path('t/data');
+my %models = (
+	markov_model        => "$data/markov.bin",
+	guess_table         => "$data/guess.bin",
+	pcfg_model          => "$data/pcfg.bin",
+	neural_model        => "$data/neural.bin",
+	common_index        => "$data/common.idx",
+	dictionary          => "$data/dictionary.bin",
+	cracklib_dictionary => "$data/pw_dict");
+
+my $node = PostgreSQL::Test::Cluster->new('models');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', q{
+shared_preload_libraries = 'pg_passwordguard'
+pg_passwordguard.min_length = 1
+pg_passwordguard.require_upper = off
+pg_passwordguard.require_lower = off
+pg_passwordguard.require_digit = off
+pg_passwordguard.require_special = off
+pg_passwordguard.reject_common = off
+});
+$node->append_conf('postgresql.conf',
+	join('', map { "pg_passwordguard.$_ = '$models{$_}'\n" } sort keys %models));
+$node->start;
+$node->safe_psql('postgres', 'CREATE EXTENSION pg_passwordguard');
+$node->safe_psql('postgres', 'CREATE ROLE model_user LOGIN');
+
+my $tempdir = PostgreSQL::Test::Utils::tempdir;
+my $files   = 0;
+
+# Checks that the server and the audit tool both accept the passwords in $accepted and reject those
+# in $rejected under the settings (e.g. "min_markov_bits = 30", or several separated by "; "), the
+# first of which names the rule; the server must give $detail.
+sub check_threshold
+{
+	my ($setting, $detail, $accepted, $rejected) = @_;
+	my ($rule) = $setting =~ /^(\w+)/;
+	my $set = join(' ', map { "SET pg_passwordguard.$_;" } split(/; /, $setting));
+
+	foreach my $password (@$accepted)
+	{
+		my ($ret, $stdout, $stderr) = $node->psql('postgres',
+			"$set ALTER ROLE model_user PASSWORD '$password'");
+		is($ret, 0, "$setting: the server accepts $password");
+	}
+	foreach my $password (@$rejected)
+	{
+		my ($ret, $stdout, $stderr) = $node->psql('postgres',
+			"$set ALTER ROLE model_user PASSWORD '$password'");
+		like($stderr, qr/DETAIL:  \Q$detail\E/, "$setting: the server rejects $password");
+	}
+
+	$files++;
+	my $policy = "$tempdir/policy$files.hex";
+	my $input  = "$tempdir/passwords$files.txt";
+	PostgreSQL::Test::Utils::append_to_file($policy,
+		$node->safe_psql('postgres',
+			"$set SELECT pg_passwordguard_policy_export();")
+		  . "\n");
+	PostgreSQL::Test::Utils::append_to_file($input,
+		join('', map { "$_\n" } @$accepted, @$rejected));
+
+	my $verdicts = join('', map { "ok\n" } @$accepted) . join('', map { "$rule\n" } @$rejected);
+	command_checks_all(
+		[
+			'pg_passwordguard_audit', "--policy=$policy",
+			(map { "--model=$_=$models{$_}" } sort keys %models), $input
+		],
+		@$rejected ? 2 : 0,
+		[qr/\A\Q$verdicts\E\z/],
+		[qr/\A\z/],
+		"$setting: the audit tool agrees");
+	return;
+}
+
+# "password" scores about 22 bits, "iloveyou" 36 and "Tr0ub4dor&3" 110.
+check_threshold('min_markov_bits = 30', 'Password is too predictable.',
+	[ 'iloveyou', 'Tr0ub4dor&3' ], ['password']);
+check_threshold('min_markov_bits = 40', 'Password is too predictable.',
+	['Tr0ub4dor&3'], [ 'password', 'iloveyou' ]);
+
+# About 10^5.3 guesses for "password", 10^9.2 for "iloveyou" and 10^30 for "Tr0ub4dor&3".
+check_threshold('min_guesses_log10 = 8',
+	'Password would be guessed in fewer than 10^8 attempts.',
+	[ 'iloveyou', 'Tr0ub4dor&3' ], ['password']);
+check_threshold('min_guesses_log10 = 10',
+	'Password would be guessed in fewer than 10^10 attempts.',
+	['Tr0ub4dor&3'], [ 'password', 'iloveyou' ]);
+
+# "password" scores about 5 bits, "iloveyou" 8 and "Tr0ub4dor&3" 60.
+check_threshold('min_pcfg_bits = 7',
+	'Password follows a common structure and is too easy to guess.',
+	[ 'iloveyou', 'Tr0ub4dor&3' ], ['password']);
+check_threshold('min_pcfg_bits = 10',
+	'Password follows a common structure and is too easy to guess.',
+	['Tr0ub4dor&3'], [ 'password', 'iloveyou' ]);
+
+# "password" scores 0.924, "monkey12" 0.818 and "Tr0ub4dor&3" 0.076.
+check_threshold('max_neural_score = 0.9', 'Password resembles known weak passwords.',
+	[ 'monkey12', 'Tr0ub4dor&3' ], ['password']);
+check_threshold('max_neural_score = 0.5', 'Password resembles known weak passwords.',
+	['Tr0ub4dor&3'], [ 'password', 'monkey12' ]);
+
+# "password123" covers 11 of the 15 characters of "xXpassword123Xx", "dragon" 6 of 13 of
+# "mydragon2024!"; "Tr0ub4dor&3" contains no common password.
+check_threshold('max_common_fraction = 0.5',
+	'Password must not be built around a commonly used password.',
+	[ 'mydragon2024!', 'Tr0ub4dor&3' ], ['xXpassword123Xx']);
+check_threshold('max_common_fraction = 0.4',
+	'Password must not be built around a commonly used password.',
+	['Tr0ub4dor&3'], [ 'xXpassword123Xx', 'mydragon2024!' ]);
+
+# Without the digits and symbols at their ends, "Dragon$2024" is "dragon", "!Passw0rd" is one edit
+# from "password" and "Pa55word!" two.
+my $dictionary = 'Password must not be a dictionary word or a slight variation of one.';
+check_threshold('reject_dictionary = on; dictionary_edits = 0', $dictionary,
+	[ '!Passw0rd', 'Pa55word!', 'Tr0ub4dor&3' ], ['Dragon$2024']);
+check_threshold('reject_dictionary = on; dictionary_edits = 1', $dictionary,
+	[ 'Pa55word!', 'Tr0ub4dor&3' ], [ 'Dragon$2024', '!Passw0rd' ]);
+check_threshold('reject_dictionary = on; dictionary_edits = 2', $dictionary,
+	['Tr0ub4dor&3'], [ 'Dragon$2024', '!Passw0rd', 'Pa55word!' ]);
+
+# A cracklib word, the word reversed, and the word with a l33t substitution and a suffix.
+my @cracklib = ('Sunshine', 'enihsnus', 'monk3y', 'Sunshine!7');
+check_threshold('reject_cracklib = off', 'Password must not be based on a dictionary word.',
+	[ @cracklib, 'Tr0ub4dor&3' ], []);
+check_threshold('reject_cracklib = on', 'Password must not be based on a dictionary word.',
+	[ 'Tr0ub4dor&3', 'xK#9vQ!2mZ' ], [@cracklib]);
+
+$node->stop;
+
+done_testing();
@@ -0,0 +1,155 @@
+#!/usr/bin/perl
+#
+# build_common_index.pl
+#
+# Builds the common-password index used by pg_passwordguard.max_common_fraction from a list of
+# common passwords (one per line, most common first or in any order), in the format read by
+# common_index.c: an FM-index, i.e. the Burrows-Wheeler transform of the lowercased passwords stored
+# as a wavelet matrix with rank directories.
+#
+# The passwords are lowercased (ASCII letters only, as the extension folds them), deduplicated and
+# sorted, and joined into the cyclic text "p1$p2$...pn$". Each $ is a distinct separator smaller than
+# any byte, ordered by the password that follows it, so that sorting the rotations of the text only
+# ever compares one password's suffix: the rotation starting at offset o of password k sorts by the
+# key suffix . "\0" . rank of the separator after it. For a million passwords this takes a few minutes
+# and a few GB of memory.
+#
+# Usage:
+#   perl tools/build_common_index.pl [--min-length N] [--max-entries N] -o common.idx passwords.txt ...
+#
+#   --min-length N     skip passwords shorter than N bytes (default 4)
+#   --max-entries N    read only the first N passwords (default: all)
+#
+# Developed by: Kothari Nishchay
+#
+
+use strict;
+use warnings;
+use Getopt::Long;
+
+my $min_length  = 4;
+my $max_entries = 0;
+my $output;
+
+GetOptions(
+	'min-length=i'  => \$min_length,
+	'max-entries=i' => \$max_entries,
+	'o|output=s'    => \$output) or die "invalid arguments\n";
+
+die "usage: $0 [options] -o common.idx passwords.txt ...\n" unless defined $output;
+
+# Must match common_index.c.
+my $LEVELS = 8;
+my $BLOCK  = 4;    # 64-bit words per rank directory entry
+
+my %seen;
+my $read = 0;
+while (my $line = <>)
+{
+	$line =~ s/\r?\n\z//;
+	next if length($line) < $min_length || $line =~ /\0/;
+	last if $max_entries && $read >= $max_entries;
+	$read++;
+	$line =~ tr/A-Z/a-z/;
+	$seen{$line} = 1;
+}
+
+my @entries = sort keys %seen;
+undef %seen;
+my $nentries = scalar @entries;
+die "no passwords\n" unless $nentries;
+
+my $max_entry_len = 0;
+foreach my $e (@entries)
+{
+	$max_entry_len = length($e) if length($e) > $max_entry_len;
+}
+
+# Sort the rotations. The separator after password k ranks as password k + 1 (the one it precedes),
+# the last one as the first; sorting the passwords first keeps the separators in the order of the
+# rotations that follow them, as the LF mapping requires.
+my @keys;
+for (my $k = 0; $k < $nentries; $k++)
+{
+	my $rank = pack('N', ($k + 1) % $nentries);
+	my $e    = $entries[$k];
+	push @keys, substr($e, $_) . "\0" . $rank . pack('N', $k) for 0 .. length($e);
+}
+@keys = sort @keys;
+
+# The BWT: the byte before each rotation, the separator (NUL) before a password's first byte.
+my $bwt = '';
+foreach my $key (@keys)
+{
+	my $k      = unpack('N', substr($key, -4));
+	my $offset = length($entries[$k]) - (length($key) - 9);
+	$bwt .= $offset > 0 ? substr($entries[$k], $offset - 1, 1) : "\0";
+}
+undef @keys;
+
+my $nsymbols = length($bwt);
+my @counts   = (0) x 256;
+{
+	my @freq = (0) x 256;
+	$freq[$_]++ foreach unpack('C*', $bwt);
+	for (my $c = 1; $c < 256; $c++)
+	{
+		$counts[$c] = $counts[ $c - 1 ] + $freq[ $c - 1 ];
+	}
+}
+
+# Wavelet matrix: level l holds bit 7 - l of every symbol, in the order left by the levels above,
+# each of which moves the symbols with a zero bit (stably) ahead of those with a one.
+my $nwords = int($nsymbols / (64 * $BLOCK) + 1) * $BLOCK;
+my $little_endian = pack('L', 1) eq pack('V', 1);
+my (@zeros, $bits, $ranks);
+my @symbols = unpack('C*', $bwt);
+undef $bwt;
+
+for (my $level = 0; $level < $LEVELS; $level++)
+{
+	my $mask = 0x80 >> $level;
+	my $level_bits = '';
+	my (@zero, @one);
+
+	for (my $i = 0; $i < $nsymbols; $i++)
+	{
+		if ($symbols[$i] & $mask)
+		{
+			vec($level_bits, $i, 1) = 1;
+			push @one, $symbols[$i];
+		}
+		else
+		{
+			push @zero, $symbols[$i];
+		}
+	}
+	push @zeros, scalar @zero;
+	@symbols = (@zero, @one);
+
+	# vec() numbers the bits of each byte from the least significant, so the bytes of a word are
+	# already in little-endian order.
+	$level_bits .= "\0" x ($nwords * 8 - length($level_bits));
+	$level_bits = join('', map { scalar reverse $_ } unpack('(a8)*', $level_bits))
+	  unless $little_endian;
+	$bits .= $level_bits;
+
+	my $ones = 0;
+	for (my $block = 0; $block < $nwords / $BLOCK; $block++)
+	{
+		$ranks .= pack('L', $ones);
+		$ones += unpack('%32b*', substr($level_bits, $block * $BLOCK * 8, $BLOCK * 8));
+	}
+}
+
+open(my $out, '>:raw', $output) or die "could not open $output: $!\n";
+print $out pack('a8 L L L L L L', 'PGGFMIX1', 0x01020304, $nentries, $nsymbols,
+	$max_entry_len, $nwords, 0);
+print $out pack('L256', @counts);
+print $out pack("L$LEVELS", @zeros);
+print $out $bits;
+print $out $ranks;
+close($out) or die "could not write $output: $!\n";
+
+printf STDERR "%s: %d common passwords, %d symbols, %d bytes\n",
+  $output, $nentries, $nsymbols, -s $output;
@@ -0,0 +1,148 @@
+#!/usr/bin/perl
+#
+# build_dictionary.pl
+#
+# Builds the dictionary used by pg_passwordguard.reject_dictionary from word lists (one word per
+# line) and writes it in the format read by dictionary.c: a minimal acyclic automaton (DAWG) of the
+# lowercased words.
+#
+# The words are sorted and added one at a time, and the states of the previous word that the new
+# one no longer shares are minimized right away (Daciuk et al., "Incremental construction of minimal
+# acyclic finite-state automata"): a state equal to one already registered, i.e. with the same
+# finality and the same arcs, is replaced by it. Memory use is proportional to the automaton, not to
+# the word list.
+#
+# Usage:
+#   perl tools/build_dictionary.pl [--min-length N] -o dictionary.bin words.txt ...
+#
+#   --min-length N     skip words shorter than N bytes (default 4)
+#
+# Developed by: Kothari Nishchay
+#
+
+use strict;
+use warnings;
+use Getopt::Long;
+
+my $min_length = 4;
+my $output;
+
+GetOptions(
+	'min-length=i' => \$min_length,
+	'o|output=s'   => \$output) or die "invalid arguments\n";
+
+die "usage: $0 [options] -o dictionary.bin words.txt ...\n" unless defined $output;
+
+my %seen;
+while (my $line = <>)
+{
+	$line =~ s/\r?\n\z//;
+	next if length($line) < $min_length;
+	$line =~ tr/A-Z/a-z/;
+	$seen{$line} = 1;
+}
+my @words = sort keys %seen;
+undef %seen;
+die "no words\n" unless @words;
+
+# States: finality and arcs ([label, target] pairs, in label order since the words are sorted).
+my (@final, @arcs);
+my %register;
+
+sub new_state
+{
+	push @final, 0;
+	push @arcs,  [];
+	return $#final;
+}
+
+sub signature
+{
+	my ($state) = @_;
+	return join(',', $final[$state], map { "$_->[0]:$_->[1]" } @{ $arcs[$state] });
+}
+
+# Replaces the states of path below depth by registered equivalents, deepest first.
+sub minimize
+{
+	my ($path, $depth) = @_;
+
+	for (my $i = $#$path; $i > $depth; $i--)
+	{
+		my $child = $path->[$i];
+		my $sig   = signature($child);
+
+		if (exists $register{$sig})
+		{
+			$arcs[ $path->[ $i - 1 ] ][-1][1] = $register{$sig};
+			$final[$child] = undef;
+			$arcs[$child]  = undef;
+		}
+		else
+		{
+			$register{$sig} = $child;
+		}
+	}
+	splice(@$path, $depth + 1);
+}
+
+my $root = new_state();
+my @path = ($root);
+my $previous = '';
+my $max_word_len = 0;
+
+foreach my $word (@words)
+{
+	my $prefix = 0;
+	$prefix++ while $prefix < length($word) && $prefix < length($previous) &&
+	  substr($word, $prefix, 1) eq substr($previous, $prefix, 1);
+
+	minimize(\@path, $prefix);
+
+	for (my $i = $prefix; $i < length($word); $i++)
+	{
+		my $state = new_state();
+		push @{ $arcs[ $path[-1] ] }, [ ord(substr($word, $i, 1)), $state ];
+		push @path, $state;
+	}
+	$final[ $path[-1] ] = 1;
+
+	$max_word_len = length($word) if length($word) > $max_word_len;
+	$previous = $word;
+}
+minimize(\@path, 0);
+undef %register;
+
+# Number the reachable states, the start state first, and lay out their arcs.
+my %number = ($root => 0);
+my @order  = ($root);
+for (my $i = 0; $i < @order; $i++)
+{
+	foreach my $arc (@{ $arcs[ $order[$i] ] })
+	{
+		next if exists $number{ $arc->[1] };
+		$number{ $arc->[1] } = scalar @order;
+		push @order, $arc->[1];
+	}
+}
+
+my ($states, $arc_data) = ('', '');
+my $narcs = 0;
+foreach my $state (@order)
+{
+	my $n = scalar @{ $arcs[$state] };
+	die "a state has more than 65535 arcs\n" if $n > 65535;
+	$states .= pack('L S C C', $narcs, $n, $final[$state], 0);
+	$arc_data .= pack('L C x3', $number{ $_->[1] }, $_->[0]) foreach @{ $arcs[$state] };
+	$narcs += $n;
+}
+
+open(my $out, '>:raw', $output) or die "could not open $output: $!\n";
+print $out pack('a8 L L L L L L', 'PGGDAWG1', 0x01020304, scalar @order, $narcs,
+	scalar @words, $max_word_len, 0);
+print $out $states;
+print $out $arc_data;
+close($out) or die "could not write $output: $!\n";
+
+printf STDERR "%s: %d words, %d states, %d arcs, %d bytes\n",
+  $output, scalar @words, scalar @order, $narcs, -s $output;
@@ -0,0 +1,117 @@
+#!/usr/bin/perl
+#
+# build_guess_table.pl
+#
+# Builds the guess-number table used by pg_passwordguard.min_guesses_log10 from a Markov model
+# written by train_markov.pl, using the Monte-Carlo method of Dell'Amico and Filippone:
+#
+#   1. sample n passwords from the model and score them exactly like markov.c does;
+#   2. sort the samples by decreasing probability p_i (ascending bits);
+#   3. store, for each sample j, the prefix sum of 1/(n * p_i) over i < j.
+#
+# At check time the server maps a password's score to a guess count with one binary search.
+# More samples give tighter estimates for strong passwords; 100k is a good default.
+#
+# Usage:
+#   perl tools/build_guess_table.pl [--samples N] [--max-length L] [--seed S] -o table.bin model.bin
+#
+# Developed by: Kothari Nishchay
+#
+
+use strict;
+use warnings;
+use Getopt::Long;
+
+my $samples    = 100000;
+my $max_length = 64;
+my $seed;
+my $output;
+
+GetOptions(
+	'samples=i'    => \$samples,
+	'max-length=i' => \$max_length,
+	'seed=i'       => \$seed,
+	'o|output=s'   => \$output) or die "invalid arguments\n";
+
+my $model_path = shift @ARGV;
+die "usage: $0 [options] -o table.bin model.bin\n"
+  unless defined $output && defined $model_path;
+die "--samples must be positive\n" if $samples <= 0;
+srand($seed) if defined $seed;
+
+open(my $in, '<:raw', $model_path) or die "could not open $model_path: $!\n";
+my $model = do { local $/; <$in> };
+close($in);
+
+my ($magic, $bom, $order, $nsymbols, $cost_bytes, $scale) =
+  unpack('a8 L L L L L', $model);
+die "$model_path is not a Markov model file\n" unless $magic eq 'PGGMKV01';
+die "$model_path was built for a different byte order\n" unless $bom == 0x01020304;
+
+my $header_size = 8 + 6 * 4 + 256;
+my $contexts    = $nsymbols**($order - 1);
+my @costs = unpack(($cost_bytes == 1 ? 'C' : 'S') . '*', substr($model, $header_size));
+die "$model_path is truncated\n" unless @costs == $contexts * $nsymbols;
+
+# Per-context cumulative sampling distributions, built on demand.
+my %cdf;
+
+sub sample_symbol
+{
+	my ($ctx) = @_;
+	my $dist = $cdf{$ctx} //= do {
+		my ($sum, @c) = (0);
+		for my $sym (0 .. $nsymbols - 1)
+		{
+			$sum += 2**(-$costs[ $ctx * $nsymbols + $sym ] / $scale);
+			push @c, $sum;
+		}
+		[ map { $_ / $sum } @c ];
+	};
+
+	my $r = rand();
+	my ($lo, $hi) = (0, $nsymbols - 1);
+	while ($lo < $hi)
+	{
+		my $mid = int(($lo + $hi) / 2);
+		if ($dist->[$mid] < $r) { $lo = $mid + 1; }
+		else                    { $hi = $mid; }
+	}
+	return $lo;
+}
+
+# Draw samples, scoring them with the same quantized costs the server uses.
+my @bits;
+for (1 .. $samples)
+{
+	my ($ctx, $total, $length) = (0, 0, 0);
+	while (1)
+	{
+		# Force the end of the password once it reaches max_length.
+		my $sym = $length < $max_length ? sample_symbol($ctx) : 0;
+		my $idx = $ctx * $nsymbols + $sym;
+		$total += $costs[$idx];
+		last if $sym == 0;
+		$ctx = $idx % $contexts;
+		$length++;
+	}
+	push @bits, $total / $scale;
+}
+
+@bits = sort { $a <=> $b } @bits;
+
+my @guesses;
+my $sum = 0;
+foreach my $score (@bits)
+{
+	push @guesses, $sum;
+	$sum += 2**$score / $samples;
+}
+
+open(my $out, '>:raw', $output) or die "could not open $output: $!\n";
+print $out pack('a8 L L Q', 'PGGGNT01', 0x01020304, $samples, length($model));
+print $out pack('d*', @bits, @guesses, $sum);
+close($out) or die "could not write $output: $!\n";
+
+printf STDERR "%s: %d samples, scores %.1f-%.1f bits, up to 10^%.1f guesses\n",
+  $output, $samples, $bits[0], $bits[-1], log($sum) / log(10);
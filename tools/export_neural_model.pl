@@ -0,0 +1,123 @@
+#!/usr/bin/perl
+#
+# export_neural_model.pl
+#
+# Quantizes a trained character CNN to int8 and writes it in the format read by neural.c, for
+# pg_passwordguard.max_neural_score. Training is done elsewhere (any framework); the weights are
+# passed in as JSON:
+#
+#   {
+#     "alphabet":   "abc...",          characters with their own symbol; others share one
+#     "embedding":  [[D floats] x (2 + length(alphabet))],
+#                                      row 0 = padding, row 1 = any other byte, then the alphabet
+#     "conv":       [[[D floats] x K] x F],
+#     "conv_bias":  [F floats],
+#     "dense":      [F floats],
+#     "dense_bias": float
+#   }
+#
+# The network must be: embedding -> conv1d (valid, over the password padded with K-1 padding
+# symbols on each side) -> ReLU -> global max-pool -> dense -> sigmoid (probability of "weak").
+# Embeddings are quantized with one scale, convolution filters with one scale each.
+#
+# Usage:
+#   perl tools/export_neural_model.pl -o neural.bin weights.json
+#
+# Developed by: Kothari Nishchay
+#
+
+use strict;
+use warnings;
+use Getopt::Long;
+use JSON::PP;
+use List::Util qw(max);
+
+my $output;
+
+GetOptions('o|output=s' => \$output) or die "invalid arguments\n";
+
+my $input = shift @ARGV;
+die "usage: $0 -o neural.bin weights.json\n" unless defined $output && defined $input;
+
+# Same limits as neural.c.
+my $MAX_DIM     = 64;
+my $MAX_KERNEL  = 9;
+my $MAX_FILTERS = 256;
+my $ROW_ALIGN   = 32;
+
+open(my $in, '<:raw', $input) or die "could not open $input: $!\n";
+my $w = decode_json(do { local $/; <$in> });
+close($in);
+
+my $alphabet = $w->{alphabet};
+my $nsymbols = 2 + length($alphabet);
+my $embed    = $w->{embedding};
+my $conv     = $w->{conv};
+my $dim      = scalar @{ $embed->[0] };
+my $filters  = scalar @$conv;
+my $kernel   = scalar @{ $conv->[0] };
+
+die "embedding must have $nsymbols rows\n" unless @$embed == $nsymbols;
+die "alphabet is too long\n" if $nsymbols > 256;
+die "embedding dimension must be 1..$MAX_DIM\n" if $dim < 1 || $dim > $MAX_DIM;
+die "kernel width must be 1..$MAX_KERNEL\n" if $kernel < 1 || $kernel > $MAX_KERNEL;
+die "filter count must be 1..$MAX_FILTERS\n" if $filters > $MAX_FILTERS;
+die "conv_bias and dense must have $filters entries\n"
+  unless @{ $w->{conv_bias} } == $filters && @{ $w->{dense} } == $filters;
+
+my @symbol_map = (1) x 256;
+$symbol_map[0] = 0;
+my %seen;
+foreach my $i (0 .. length($alphabet) - 1)
+{
+	my $c = ord(substr($alphabet, $i, 1));
+	die "alphabet must be single-byte characters\n" if $c > 255 || $c == 0;
+	die "alphabet contains a duplicate character\n" if $seen{$c}++;
+	$symbol_map[$c] = 2 + $i;
+}
+
+sub quantize
+{
+	my ($scale, @values) = @_;
+	return map { my $q = int($_ / $scale + ($_ < 0 ? -0.5 : 0.5)); $q > 127 ? 127 : $q < -127 ? -127 : $q }
+	  @values;
+}
+
+sub pad16
+{
+	my ($buf) = @_;
+	return $buf . ("\0" x ((16 - length($buf) % 16) % 16));
+}
+
+# Embeddings: one symmetric scale for the whole table.
+my @flat_embed = map { die "embedding rows must have $dim columns\n" unless @$_ == $dim; @$_ } @$embed;
+my $embed_scale = max(map { abs } @flat_embed) / 127 || 1;
+my $embed_bytes = pack('c*', quantize($embed_scale, @flat_embed));
+
+# Convolution: one scale per filter, rows zero-padded to a multiple of ROW_ALIGN.
+my $row_len = int(($kernel * $dim + $ROW_ALIGN - 1) / $ROW_ALIGN) * $ROW_ALIGN;
+my ($conv_bytes, @conv_scale) = ('');
+foreach my $filter (@$conv)
+{
+	die "all filters must have width $kernel\n" unless @$filter == $kernel;
+	my @row = map { die "filter taps must have $dim weights\n" unless @$_ == $dim; @$_ } @$filter;
+	my $scale = max(map { abs } @row) / 127 || 1;
+	$conv_bytes .= pack('c*', quantize($scale, @row), (0) x ($row_len - @row));
+	push @conv_scale, $embed_scale * $scale;
+}
+
+my $data = pack('a8 L L L L L L L4 C256', 'PGGNN001', 0x01020304, $nsymbols, $dim, $kernel,
+	$filters, $row_len, 0, 0, 0, 0, @symbol_map);
+$data .= pad16($embed_bytes);
+$data .= pad16($conv_bytes);
+$data .= pad16(pack('f*', @conv_scale));
+$data .= pad16(pack('f*', @{ $w->{conv_bias} }));
+$data .= pad16(pack('f*', @{ $w->{dense} }));
+$data .= pack('f', $w->{dense_bias});
+
+open(my $out, '>:raw', $output) or die "could not open $output: $!\n";
+print $out $data;
+close($out) or die "could not write $output: $!\n";
+
+printf STDERR "%s: %d symbols, dim %d, %d filters of width %d, %d bytes\n",
+  $output, $nsymbols, $dim, $filters, $kernel, length($data);
@@ -0,0 +1,114 @@
+#!/usr/bin/perl
+#
+# train_markov.pl
+#
+# Trains the character n-gram model used by pg_passwordguard.min_markov_bits from a password
+# corpus (one password per line) and writes it in the format read by markov.c.
+#
+# Usage:
+#   perl tools/train_markov.pl [--order N] [--fold-case] [--smoothing K]
+#                              [--cost-bytes 1|2] [--scale S] -o model.bin corpus.txt ...
+#
+#   --order N        n-gram order, 2..6 (default 3). The table has nsymbols^N entries:
+#                    97^3 (about 1 MB) by default, 71^4 (about 25 MB per cost byte) with --fold-case.
+#   --fold-case      map A-Z onto a-z (smaller table, case is then ignored by the model)
+#   --smoothing K    additive smoothing constant (default 0.01)
+#   --cost-bytes B   1 for uint8 costs, 2 for uint16 costs (default 2)
+#   --scale S        cost units per bit (default 16 for uint16, 8 for uint8)
+#
+# Developed by: Kothari Nishchay
+#
+
+use strict;
+use warnings;
+use Getopt::Long;
+
+my $order      = 3;
+my $fold_case  = 0;
+my $smoothing  = 0.01;
+my $cost_bytes = 2;
+my $scale;
+my $output;
+
+GetOptions(
+	'order=i'      => \$order,
+	'fold-case'    => \$fold_case,
+	'smoothing=f'  => \$smoothing,
+	'cost-bytes=i' => \$cost_bytes,
+	'scale=i'      => \$scale,
+	'o|output=s'   => \$output) or die "invalid arguments\n";
+
+die "usage: $0 [options] -o model.bin corpus.txt ...\n" unless defined $output;
+die "--order must be between 2 and 6\n" if $order < 2 || $order > 6;
+die "--cost-bytes must be 1 or 2\n" if $cost_bytes != 1 && $cost_bytes != 2;
+die "--smoothing must be positive\n" if $smoothing <= 0;
+$scale //= $cost_bytes == 1 ? 8 : 16;
+
+# Symbol 0 is the start/end boundary, symbol 1 any byte outside the alphabet.
+my @symbol_map = (1) x 256;
+$symbol_map[0] = 0;
+my $nsymbols = 2;
+for my $c (0x20 .. 0x7e)
+{
+	next if $fold_case && $c >= ord('A') && $c <= ord('Z');
+	$symbol_map[$c] = $nsymbols++;
+}
+if ($fold_case)
+{
+	$symbol_map[$_] = $symbol_map[ $_ + 32 ] for (ord('A') .. ord('Z'));
+}
+
+my $entries  = $nsymbols**$order;
+my $contexts = $nsymbols**($order - 1);
+die "model would have $entries entries; use a lower --order or --fold-case\n"
+  if $entries > 2**31 - 1;
+
+# Count n-grams.
+my (%ngram, %context);
+my $passwords = 0;
+
+while (my $line = <>)
+{
+	$line =~ s/\r?\n\z//;
+	next if $line eq '';
+	$passwords++;
+
+	my $ctx = 0;
+	foreach my $sym ((map { $symbol_map[$_] } unpack('C*', $line)), 0)
+	{
+		my $idx = $ctx * $nsymbols + $sym;
+		$ngram{$idx}++;
+		$context{$ctx}++;
+		$ctx = $idx % $contexts;
+	}
+}
+
+die "corpus is empty\n" unless $passwords;
+
+# Quantize -log2 P(symbol | context) with additive smoothing.
+my $max_cost = $cost_bytes == 1 ? 255 : 65535;
+my $log2     = log(2);
+my @costs;
+$#costs = $entries - 1;
+
+for my $ctx (0 .. $contexts - 1)
+{
+	my $denom = ($context{$ctx} // 0) + $smoothing * $nsymbols;
+	for my $sym (0 .. $nsymbols - 1)
+	{
+		my $idx  = $ctx * $nsymbols + $sym;
+		my $p    = (($ngram{$idx} // 0) + $smoothing) / $denom;
+		my $cost = int(-log($p) / $log2 * $scale + 0.5);
+		$costs[$idx] = $cost > $max_cost ? $max_cost : $cost;
+	}
+}
+
+open(my $out, '>:raw', $output) or die "could not open $output: $!\n";
+print $out pack('a8 L L L L L L', 'PGGMKV01', 0x01020304, $order, $nsymbols,
+	$cost_bytes, $scale, 0);
+print $out pack('C256', @symbol_map);
+print $out pack(($cost_bytes == 1 ? 'C' : 'S') . '*', @costs);
+close($out) or die "could not write $output: $!\n";
+
+printf STDERR "%s: %d passwords, order %d, %d symbols, %d entries\n",
+  $output, $passwords, $order, $nsymbols, $entries;
@@ -0,0 +1,137 @@
+#!/usr/bin/perl
+#
+# train_pcfg.pl
+#
+# Trains the probabilistic context-free grammar used by pg_passwordguard.min_pcfg_bits from a
+# password corpus (one password per line) and writes it in the format read by pcfg.c.
+#
+# Each password is split into maximal runs of letters (L), digits (D) and other characters (S).
+# The model stores -log2 P(structure) for every structure (e.g. "L6D4S1") and
+# -log2 P(terminal | type, length) for every terminal (letters lowercased), quantized to 1/scale
+# bit units and keyed by hash only.
+#
+# Usage:
+#   perl tools/train_pcfg.pl [--min-count N] [--scale S] -o pcfg.bin corpus.txt ...
+#
+#   --min-count N    drop structures and terminals seen fewer than N times (default 1)
+#   --scale S        cost units per bit (default 16)
+#
+# Developed by: Kothari Nishchay
+#
+
+use strict;
+use warnings;
+use Getopt::Long;
+
+my $min_count = 1;
+my $scale     = 16;
+my $output;
+
+GetOptions(
+	'min-count=i' => \$min_count,
+	'scale=i'     => \$scale,
+	'o|output=s'  => \$output) or die "invalid arguments\n";
+
+die "usage: $0 [options] -o pcfg.bin corpus.txt ...\n" unless defined $output;
+
+# Must match the seeds in pcfg.c.
+my $SEED_SLOT  = 0x50434647;
+my $SEED_CHECK = 0x7063666b;
+
+# Same limits as pcfg.c; anything beyond them is scored as unseen there.
+my $MAX_SEGMENTS = 32;
+my $MAX_TERMINAL = 64;
+
+# 32-bit multiply without leaving integer range.
+sub mul32
+{
+	my ($a, $b) = @_;
+	my $lo = ($a * ($b & 0xffff)) & 0xffffffff;
+	my $hi = (($a * ($b >> 16)) & 0xffff) << 16;
+	return ($lo + $hi) & 0xffffffff;
+}
+
+# Must match pgg_hash32() in passwordguard.h.
+sub pgg_hash32
+{
+	my ($s, $seed) = @_;
+	my $h = 0x811c9dc5 ^ mul32($seed, 0x9e3779b9);
+
+	foreach my $c (unpack('C*', $s))
+	{
+		$h ^= $c;
+		$h = mul32($h, 0x01000193);
+	}
+	$h ^= $h >> 16;
+	$h = mul32($h, 0x85ebca6b);
+	$h ^= $h >> 13;
+	$h = mul32($h, 0xc2b2ae35);
+	$h ^= $h >> 16;
+	return $h;
+}
+
+my (%structures, %terminals, %type_length);
+my $passwords = 0;
+
+while (my $line = <>)
+{
+	$line =~ s/\r?\n\z//;
+	next if $line eq '';
+	$passwords++;
+
+	my @segments = $line =~ /([A-Za-z]+|[0-9]+|[^A-Za-z0-9]+)/g;
+	my $structure = '#';
+	foreach my $seg (@segments)
+	{
+		my $type = $seg =~ /^[A-Za-z]/ ? 'L' : $seg =~ /^[0-9]/ ? 'D' : 'S';
+		$structure .= $type . length($seg);
+		next if length($seg) > $MAX_TERMINAL;
+
+		$terminals{ $type . ($type eq 'L' ? lc $seg : $seg) }++;
+		$type_length{ $type . length($seg) }++;
+	}
+	$structures{$structure}++ if @segments <= $MAX_SEGMENTS;
+}
+
+die "corpus is empty\n" unless $passwords;
+
+my $log2 = log(2);
+sub cost { return int(-log($_[0]) / $log2 * $scale + 0.5); }
+
+my %entries;
+while (my ($key, $count) = each %structures)
+{
+	$entries{$key} = cost($count / $passwords) if $count >= $min_count;
+}
+while (my ($key, $count) = each %terminals)
+{
+	next if $count < $min_count;
+	my $type = substr($key, 0, 1);
+	$entries{$key} = cost($count / $type_length{ $type . (length($key) - 1) });
+}
+
+# Unseen items: a structure rarer than any seen one, terminals as uniformly random characters.
+my $unseen_structure = cost(0.5 / $passwords);
+my @unseen_char = (cost(1 / 26), cost(1 / 10), cost(1 / 33));
+
+# Open-addressing table, at most half full.
+my $nslots = 1;
+$nslots <<= 1 while $nslots < 2 * (scalar(keys %entries) + 1);
+
+my @slots = map { [ 0, 0, 0xffffffff ] } (1 .. $nslots);
+foreach my $key (sort keys %entries)
+{
+	my $slot_hash = pgg_hash32($key, $SEED_SLOT);
+	my $slot      = $slot_hash & ($nslots - 1);
+	$slot = ($slot + 1) & ($nslots - 1) while $slots[$slot][2] != 0xffffffff;
+	$slots[$slot] = [ $slot_hash, pgg_hash32($key, $SEED_CHECK), $entries{$key} ];
+}
+
+open(my $out, '>:raw', $output) or die "could not open $output: $!\n";
+print $out pack('a8 L L L L L L L L', 'PGGPCFG1', 0x01020304, $nslots, $scale,
+	$unseen_structure, @unseen_char, 0);
+print $out pack('L L L', @$_) foreach @slots;
+close($out) or die "could not write $output: $!\n";
+
+printf STDERR "%s: %d passwords, %d structures, %d terminals, %d slots\n",
+  $output, $passwords, scalar(keys %structures), scalar(keys %terminals), $nslots;
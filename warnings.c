@@ -0,0 +1,257 @@
+/*
+ * warnings.c
+ *
+ * Rate limiting of the log-only WARNINGs.
+ *
+ * With pg_passwordguard.log_only_max_warnings set, all backends share one token bucket holding that
+ * many tokens and refilled at that many per second; a violation is logged only if it gets a token.
+ * Suppressed violations are counted per role and rule in a small shared hash table, and the
+ * background worker (see eventlog.c) logs a summary of them every
+ * pg_passwordguard.log_only_summary_interval seconds, so nothing goes unreported and a bulk
+ * migration with log-only on produces a handful of lines instead of one per violation.
+ *
+ * Needs shared memory, so the library must be loaded through shared_preload_libraries; otherwise
+ * every violation is logged as before.
+ *
+ * Developed by: Kothari Nishchay
+ */
+
+#include "postgres.h"
+
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/hsearch.h"
+#include "utils/timestamp.h"
+
+#include "passwordguard.h"
+
+/* (role, rule) pairs counted per interval; suppressed warnings beyond that are only totalled. */
+#define WARNING_SUMMARY_ENTRIES     1024
+
+/* Pairs listed in one summary; the rest are only totalled. */
+#define WARNING_SUMMARY_DETAIL      20
+
+typedef struct WarningKey
+{
+    NameData    role;
+    int         rule;
+} WarningKey;
+
+typedef struct WarningEntry
+{
+    WarningKey  key;
+    int64       count;
+} WarningEntry;
+
+typedef struct PggWarningsShared
+{
+    slock_t     mutex;          /* protects the token bucket */
+    double      tokens;
+    TimestampTz refilled;
+
+    LWLock     *lock;           /* protects the rest, and the hash table */
+    TimestampTz summarized;
+    int64       suppressed;     /* in this interval, also those the hash table had no room for */
+} PggWarningsShared;
+
+static PggWarningsShared *pgg_warnings = NULL;
+static HTAB *pgg_warning_counts = NULL;
+
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void
+warnings_shmem_request(void)
+{
+    if (prev_shmem_request_hook)
+        prev_shmem_request_hook();
+
+    RequestAddinShmemSpace(add_size(MAXALIGN(sizeof(PggWarningsShared)),
+                                    hash_estimate_size(WARNING_SUMMARY_ENTRIES, sizeof(WarningEntry))));
+    RequestNamedLWLockTranche("pg_passwordguard warnings", 1);
+}
+
+static void
+warnings_shmem_startup(void)
+{
+    HASHCTL     info;
+    bool        found;
+
+    if (prev_shmem_startup_hook)
+        prev_shmem_startup_hook();
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+    pgg_warnings = ShmemInitStruct("pg_passwordguard warnings", sizeof(PggWarningsShared), &found);
+    if (!found)
+    {
+        SpinLockInit(&pgg_warnings->mutex);
+        pgg_warnings->tokens = pgg_log_only_max_warnings;
+        pgg_warnings->refilled = GetCurrentTimestamp();
+        pgg_warnings->lock = &(GetNamedLWLockTranche("pg_passwordguard warnings"))->lock;
+        pgg_warnings->summarized = pgg_warnings->refilled;
+        pgg_warnings->suppressed = 0;
+    }
+
+    info.keysize = sizeof(WarningKey);
+    info.entrysize = sizeof(WarningEntry);
+    pgg_warning_counts = ShmemInitHash("pg_passwordguard warning counts",
+                                       WARNING_SUMMARY_ENTRIES, WARNING_SUMMARY_ENTRIES,
+                                       &info, HASH_ELEM | HASH_BLOBS);
+
+    LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * pgg_warnings_init
+ *
+ * Called from _PG_init. Only reserves shared memory when loaded at server start.
+ */
+void
+pgg_warnings_init(void)
+{
+    if (!process_shared_preload_libraries_in_progress)
+        return;
+
+    prev_shmem_request_hook = shmem_request_hook;
+    shmem_request_hook = warnings_shmem_request;
+    prev_shmem_startup_hook = shmem_startup_hook;
+    shmem_startup_hook = warnings_shmem_startup;
+}
+
+/* Takes a token from the bucket, refilling it first; false if there is none. */
+static bool
+take_token(void)
+{
+    TimestampTz now = GetCurrentTimestamp();
+    double      rate = pgg_log_only_max_warnings;
+    bool        ok;
+
+    SpinLockAcquire(&pgg_warnings->mutex);
+    if (now > pgg_warnings->refilled)
+    {
+        pgg_warnings->tokens += rate * (now - pgg_warnings->refilled) / USECS_PER_SEC;
+        if (pgg_warnings->tokens > rate)
+            pgg_warnings->tokens = rate;
+        pgg_warnings->refilled = now;
+    }
+    ok = (pgg_warnings->tokens >= 1.0);
+    if (ok)
+        pgg_warnings->tokens -= 1.0;
+    SpinLockRelease(&pgg_warnings->mutex);
+
+    return ok;
+}
+
+/*
+ * pgg_warning_allowed
+ *
+ * Should the log-only WARNING for rule violated by role be logged? If not, it is counted for the
+ * next summary.
+ */
+bool
+pgg_warning_allowed(const char *role, PggRule rule)
+{
+    WarningKey  key;
+    WarningEntry *entry;
+    bool        found;
+
+    if (pgg_warnings == NULL || pgg_log_only_max_warnings <= 0)
+        return true;
+    if (take_token())
+        return true;
+
+    memset(&key, 0, sizeof(key));
+    namestrcpy(&key.role, role ? role : "");
+    key.rule = rule;
+
+    LWLockAcquire(pgg_warnings->lock, LW_EXCLUSIVE);
+    pgg_warnings->suppressed++;
+    entry = hash_search(pgg_warning_counts, &key, HASH_ENTER_NULL, &found);
+    if (entry != NULL)
+        entry->count = found ? entry->count + 1 : 1;
+    LWLockRelease(pgg_warnings->lock);
+
+    return false;
+}
+
+static int
+warning_entry_cmp(const void *a, const void *b)
+{
+    int64       ca = ((const WarningEntry *) a)->count;
+    int64       cb = ((const WarningEntry *) b)->count;
+
+    return (ca < cb) - (ca > cb);
+}
+
+/*
+ * pgg_warnings_summarize
+ *
+ * Called regularly by the background worker. Once log_only_summary_interval has passed, logs how many
+ * warnings were suppressed since the last summary, the most frequent (role, rule) pairs first, and
+ * starts counting anew.
+ */
+void
+pgg_warnings_summarize(void)
+{
+    TimestampTz now = GetCurrentTimestamp();
+    HASH_SEQ_STATUS status;
+    WarningEntry *entry;
+    WarningEntry *entries;
+    int         nentries = 0;
+    int64       suppressed;
+    int64       listed = 0;
+    long        secs;
+    StringInfoData detail;
+    int         i;
+
+    if (pgg_warnings == NULL ||
+        !TimestampDifferenceExceeds(pgg_warnings->summarized, now,
+                                    pgg_log_only_summary_interval * 1000))
+        return;
+
+    entries = palloc(WARNING_SUMMARY_ENTRIES * sizeof(WarningEntry));
+
+    LWLockAcquire(pgg_warnings->lock, LW_EXCLUSIVE);
+    secs = (long) ((now - pgg_warnings->summarized) / USECS_PER_SEC);
+    suppressed = pgg_warnings->suppressed;
+    pgg_warnings->summarized = now;
+    pgg_warnings->suppressed = 0;
+
+    hash_seq_init(&status, pgg_warning_counts);
+    while ((entry = hash_seq_search(&status)) != NULL)
+    {
+        entries[nentries++] = *entry;
+        hash_search(pgg_warning_counts, &entry->key, HASH_REMOVE, NULL);
+    }
+    LWLockRelease(pgg_warnings->lock);
+
+    if (suppressed > 0)
+    {
+        qsort(entries, nentries, sizeof(WarningEntry), warning_entry_cmp);
+
+        initStringInfo(&detail);
+        for (i = 0; i < nentries && i < WARNING_SUMMARY_DETAIL; i++)
+        {
+            appendStringInfo(&detail, "%srole \"%s\", %s: " INT64_FORMAT,
+                             i > 0 ? "; " : "", NameStr(entries[i].key.role),
+                             pgg_rule_names[entries[i].key.rule], entries[i].count);
+            listed += entries[i].count;
+        }
+        if (listed < suppressed)
+            appendStringInfo(&detail, "%sothers: " INT64_FORMAT,
+                             detail.len > 0 ? "; " : "", suppressed - listed);
+
+        ereport(LOG,
+                (errmsg("pg_passwordguard: " INT64_FORMAT " log-only warnings suppressed in the last %ld s",
+                        suppressed, secs),
+                 errdetail("%s", detail.data)));
+        pfree(detail.data);
+    }
+
+    pfree(entries);
+}